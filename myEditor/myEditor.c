@@ -39,19 +39,34 @@ the text color back to normal.
 #define _GNU_SOURCE
 
 #include <ctype.h>      // needed for iscntrl()
+#include <dlfcn.h>      // needed for dlopen(), dlsym(), dlclose(), RTLD_NOW
 #include <errno.h>      // needed for errno, EAGAIN
-#include <fcntl.h>      // needed for open(), O_RDWR, O_CREAT
+#include <fcntl.h>      // needed for open(), O_RDWR, O_CREAT, O_DIRECTORY
+#include <libgen.h>     // needed for dirname()
 #include <stdio.h>      // needed for perror(), printf(), sscanf(), snprintf(), FILE, fopen(), getline(), vsnprintf()
 #include <stdarg.h>     // needed for va_list, va_start(), and va_end()
 #include <stdlib.h>     // Needed for exit(), atexit(), realloc(), free(), malloc()
 #include <string.h>     // Needed for memcpy(), strlen(), strup(), memmove(), strerror(), strstr(), memset(), strchr(), strcmp(), strncmp()
+#include <poll.h>       // Needed for struct pollfd, poll(), POLLIN
+#include <pthread.h>    // Needed for pthread_t, pthread_create(), pthread_join()
+#include <signal.h>     // Needed for sigset_t, sigemptyset(), sigaddset(), SIGPIPE, struct sigaction, sigaction(), SIGBUS
+#include <sys/inotify.h>  // Needed for inotify_init1(), inotify_add_watch(), inotify_rm_watch(), IN_MODIFY, IN_CREATE, IN_MOVED_TO
 #include <sys/ioctl.h>  // Needed for struct winsize, ioctl(), TIOCGWINSZ 
+#include <sys/mman.h>   // Needed for mmap(), munmap(), PROT_READ, PROT_WRITE, MAP_PRIVATE, MAP_ANONYMOUS, MAP_FIXED
+#include <sys/resource.h>  // Needed for struct rusage, getrusage(), RUSAGE_SELF
+#include <sys/stat.h>   // Needed for struct stat, fstat()
+#include <sys/uio.h>    // Needed for struct iovec, writev()
 #include <sys/types.h>  // Needed for ssize_t
 #include <termios.h>    // Needed for struct termios, tcsetattr(), TCSAFLUSH, tcgetattr(), BRKINT, ICRNL, INPCK, ISTRIP, 
                         // IXON, OPOST, CS8, ECHO, ICANON, IEXTEN, ISIG, VMIN, VTIME
 #include <time.h>       // Needed for time_t, time()
 #include <unistd.h>     // Needed for read(), STDIN_FILENO, write(), STDOUT_FILENO, ftruncate(), close()
+#include <zlib.h>       // Needed for z_stream, deflateInit2(), deflate(), inflateInit2(), inflate() - for .gz files
 #include <stdbool.h>    // Needed for bool, true, and false
+#include <stdint.h>     // Needed for int64_t, INT64_MAX, uintptr_t
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>  // Needed for __m128i, __m256i, _mm_cmpeq_epi8(), _mm_movemask_epi8() and their 256-bit versions
+#endif
 
 /*** defines ***/
 
@@ -60,6 +75,8 @@ the text color back to normal.
 #define VERSION            "0.0.1"
 #define TAB_WIDTH           8
 #define TIMES_TO_QUIT         3
+#define FRAME_MS             16  // while keys come faster than they can be shown, the screen is drawn at most this often - about as
+                                 // often as a display shows a frame
 
 #define CTRL_KEY(k)        ((k) & 0x1F)  // unset the upper 3 bits of k
 
@@ -85,6 +102,7 @@ enum foregroundColors {  // ANSI foreground color codes
     MAGENTA,  // purple
     CYAN,     // sky blue
     WHITE,  // light gray
+    DEFAULT_COLOR = 39,  // whatever color the terminal draws text in
     GRAY = 90,  // dark grey
     BRIGHT_RED,  // dark red
     BRIGHT_GREEN,  // lime green
@@ -103,7 +121,8 @@ enum textColors {  // enum of highlight colors
   HL_TYPE              = BRIGHT_CYAN,
   HL_STRING            = BRIGHT_YELLOW,
   HL_NUMBER            = BRIGHT_BLUE,
-  HL_MATCH             = BRIGHT_GREEN
+  HL_MATCH             = BRIGHT_GREEN,
+  HL_CHANGED           = BRIGHT_RED  // a byte changed in the hex view and not saved yet
 };
 
 #define COLOR_NUMBERS        1   // For now, we define just the COLOR_NUMBERS flag bit.
@@ -124,26 +143,404 @@ typedef struct syntaxInfo {
 typedef unsigned char byte;
 
 typedef struct textRow {  // the typedef lets us refer to the type as "textRow" instead of "struct textRow"
-  int index,
-      length,  // the quantity of elements in the *characters array
-      displayLength;  // the quantity of elements in the *display array
-  char *characters,  // pointer to a dynamically allocated array that holds all the characters in a single row of text as read from a file
-       *display;  // pointer to a dynamically allocated array that holds all the characters in a single row of text as they are displayed on the screen
-  byte *textColor;  // "highlight" - an array to store the highlighting characteristics of each character
+  struct piece *owner;  // the piece of the piece table that currently holds this row - used to work out the row's position in the text
+  int64_t slot,  // index of the row in its piece table buffer - never changes once the row is created
+          length,  // the quantity of characters in the row (not counting the gap)
+          capacity,  // the quantity of bytes allocated for *characters - always room for length characters, the gap, and a null byte
+          gapStart,  // index into *characters where the gap begins - the characters after the gap are stored at the end of the array
+          lastTab,  // index into *characters of the last tab in the row, or -1 - an edit after it only shifts the display, it never re-expands tabs
+          displayLength,  // the quantity of elements in the *display array
+          displayCapacity,  // the quantity of bytes allocated for *display - 0 when display is not a copy but points at the characters
+          colorCapacity;  // the quantity of bytes allocated for *textColor
+  char *characters,  // gap buffer that holds all the characters in a single row of text as read from a file - the unused gap sits at the last edit, so typing and deleting there never has to move the rest of the row
+       *display;  // the characters of the row as they are displayed on the screen - a row without tabs displays exactly its characters, so display just points at them (with the gap moved out of the way)
+  byte *textColor;  // "highlight" - an array to store the highlighting characteristics of each character - NULL when there is no highlighting
   bool commentLeftOpen;  // variable type/name should be BOOLEAN hasUnclosedMultilineComment 
+  byte memory;  // which of the row's buffers are in the load arena - see enum rowMemory
 } textRow;  // stores a line of text as a pointer to the dynamically-allocated character data and a length
 
+enum rowMemory {  // bits of textRow.memory
+  ARENA_CHARACTERS = 1,  // characters were carved out of the load arena, so they can't be realloc()'d or free()'d
+  ARENA_DISPLAY = 2,  // so was display
+  ARENA_COLORS = 4,  // so was textColor
+  ARENA_ONLY = 8,  // a loaded row with no allocations of its own yet - it goes on the arena's ownedRows list when it gets one
+  MAPPED = 16  // characters point into a mapped file - ARENA_CHARACTERS is set too, so growing them makes a copy the same way
+};
+
+enum rowSources {  // the buffers a piece can take its rows from
+  ORIGINAL_BUFFER,  // rows read from the file by editorAppendRows() - only ever added to at the end, and never reordered
+  ADD_BUFFER        // rows created while editing, and lines added to a followed file - append-only, rows are never moved once added
+};
+
+typedef struct piece {  // a run of consecutive rows from one of the piece table buffers
+  struct piece *left,
+               *right,
+               *parent;  // lets a row walk up to the root to work out its own position in the text
+  int priority,  // random treap priority - a piece always has a higher priority than its children, which keeps the tree balanced
+      source;  // ORIGINAL_BUFFER or ADD_BUFFER
+  int64_t start,  // slot of the first row of the run in its buffer
+          count,  // the quantity of rows in the run
+          subtreeRows;  // the quantity of rows in this piece plus all the pieces below it in the tree
+} piece;
+
+#define OPEN_READ_SIZE  (1 << 20)  // editorOpen() reads a file a megabyte at a time
+#define CODEC_BUFFER_SIZE (1 << 20)  // a compressed file is read, and what is compressed or decompressed is written, a megabyte at a time
+#define ZSTD_LEVEL      3  // zstd's own default
+#define JOURNAL_SYNC_MS 100  // an edit reaches the journal on disk at most this long after it is made - one fdatasync() covers them all
+#define JOURNAL_MAGIC   "myEdJnl1"  // the first 8 bytes of a journal file, followed by the journalStamp of the file its edits are made to
+#define JOURNAL_HEADER_SIZE (8 + sizeof(journalStamp))
+#define JOURNAL_RECORD_SIZE 25  // an operation byte, then the row, column and length of the text after it as 8 byte integers
+#define RELOAD_CHUNK_LINES 1024  // a chunk of the text ends after a line whose hash is a multiple of this, so it is about this many lines long
+#define RELOAD_CHUNK_MIN  64  // the fewest lines a chunk ends after on a hash
+#define RELOAD_CHUNK_BYTES (1 << 20)  // and the most bytes it holds before it ends anyway
+#define RELOAD_CHECK_MS   500  // how often the file is looked at for a change made to it by something else, while nobody is typing
+#define TAIL_SAVE_SHARE 4  // a save rewrites just the end of the file from the first edit on, if that is at most a quarter of it
+#define SAVE_IOVECS     1024  // editorSave() hands the kernel this many pieces of the text per writev() - the usual IOV_MAX
+#define ADD_BLOCK_ROWS  512  // rows per block of the add buffer - blocks are never reallocated, so row pointers stay valid
+#define PIECE_MAX_ROWS  512  // the most rows a piece may hold - cutting a piece in two never has to repoint more than half this many rows
+#define ROW_MAX_GAP     (16 << 20)  // the most room rowReserve() adds to a row in one go
+
+typedef struct pieceTable {  // the text as a balanced tree of pieces, so finding, inserting and deleting a row are all O(log n)
+  textRow *original,  // the original buffer - one row for each line of the file
+          **addBlocks;  // the add buffer - fixed size blocks of rows created by editorInsertRow()
+  int64_t originalRows,  // the quantity of rows in the original buffer
+          originalCapacity,  // the quantity of rows the original buffer has room for
+          addRows;  // the quantity of rows in the add buffer
+  piece *root;  // the pieces in text order - an in-order walk of the tree visits every row of the text from top to bottom
+} pieceTable;
+
+#define ARENA_BLOCK_SIZE  (64 << 20)  // loaded rows are carved out of 64 MB blocks, so a file takes a handful of allocations instead of several per line
+
+typedef struct rowArena {  // the memory the rows of a file are carved out of while it is loaded - a row only gets allocations of its own once it is edited
+  char **blocks;  // the blocks handed out so far - a block is never reallocated, so pointers into it stay valid
+  int blockCount;  // the quantity of blocks
+  int64_t *ownedRows,  // original buffer slots of the loaded rows that have allocations of their own - closing the file frees just these rows, not every row
+          ownedCount,  // the quantity of slots in *ownedRows
+          ownedCapacity;  // the quantity of slots *ownedRows has room for
+  size_t used,  // bytes handed out from the last block
+         size;  // the size of the last block
+  bool open;  // true while editorOpen() is loading a file - new row buffers come from the arena instead of malloc()
+} rowArena;
+
+#ifndef MAP_OPEN_SIZE  // build with -DMAP_OPEN_SIZE=1 to map every file that isn't empty
+#define MAP_OPEN_SIZE  (32 << 20)  // files at least this big are mapped instead of read, and a row is only made when something looks at it
+#endif
+#define INDEX_STEP     (16 << 20)  // the quantity of bytes of a mapped file searched for line ends at a time
+#define INDEX_THREAD_SIZE  (4 << 20)  // text at least this long is split into chunks that are searched for newlines on several threads
+#define INDEX_MAX_THREADS  16  // the most threads that search for newlines at once
+
+typedef struct newlineIndex {  // the offsets of the newlines found in some text, in order
+  int64_t *offsets,
+          count,  // the quantity of newlines found
+          capacity;  // the quantity of offsets *offsets has room for
+} newlineIndex;
+
+typedef struct mappedFile {  // a file opened with mmap() - only the starts of its lines are found when it is opened
+  char *base;  // the mapping - private, so an edit in place copies the page instead of changing the file. One byte longer than the file,
+               // and that byte is 0, so there is always a byte after the last line
+  size_t size,  // the size of the file
+         indexed;  // the quantity of bytes searched for line ends so far - the rest of the file is searched between keypresses
+  int64_t *lineStart,  // the offset of the start of each line found so far - lineStart[originalRows] is where the next line starts
+          lineCapacity,  // the quantity of entries *lineStart has room for
+          blockCount,  // the quantity of entries in *rowBlocks
+          device,  // the file that is mapped - if it is changed in place, the lines that were never made into rows change with it
+          inode;
+  volatile sig_atomic_t cutShort;  // a page of it was gone when it was read - the file was truncated, and editorMappingFault() put
+                                   // zeros where the page was
+  textRow **rowBlocks;  // the rows made so far, ADD_BLOCK_ROWS to a block - a block is only allocated once one of its rows is made, and
+                        // a row whose characters are NULL hasn't been made
+} mappedFile;
+
+typedef struct pieceRun {  // a piece, copied out of the piece table
+  int source;
+  int64_t start, count;
+} pieceRun;
+
+typedef struct saveState {  // a save running on a thread of its own (see editorSave())
+  pthread_mutex_t lock;  // held by the main thread except while it waits for a key, and by the save thread while it looks at the rows
+  pthread_t thread;
+  bool running,  // a save has been started and not finished with yet - only the main thread changes this
+       threaded,  // the save has a thread of its own that has to be joined
+       done,  // the save thread has finished - the rest of these are set under the lock
+       ok;  // and whether the file was saved
+  int error;  // errno, if it wasn't
+  char *filename;  // the file being written
+  int compression;  // Text.compression when the save started
+  bool atomic,  // written by editorSaveAtomic() rather than editorSaveInPlace()
+       tailAllowed,  // may be written by editorSaveTail() instead, if the file is as it was last saved
+       fileKnown;  // file holds what the file looked like once it was saved
+  pieceRun *runs;  // the text as it was when the save started - the rows these name are never changed or freed until the save is over
+  int64_t runCount,
+          originalRows,  // the slots of the original buffer the snapshot can see - a row in one of these is copied before it is edited
+          addRows,  // the same for the add buffer
+          rowCount,  // the quantity of rows in the snapshot
+          rowsDone,  // the quantity of them written so far
+          version,  // Text.version when the snapshot was taken
+          dirtyFrom;  // Text.dirtyFrom when the snapshot was taken
+  size_t written;  // the quantity of bytes in the file, once done
+  int64_t tailFrom;  // the offset editorSaveTail() started rewriting at, or -1 if the whole file was written
+  struct stat file;  // the file as it was last opened or saved, then as this save left it
+  textRow **retired;  // rows taken out of the text while the save ran - freed once it is over
+  int64_t retiredCount,
+          retiredCapacity;
+} saveState;
+
+enum journalOperations {  // the kinds of record in the journal - each is an edit made by one of the functions that change the text
+  JOURNAL_INSERT_ROW = 1,  // editorInsertRow() - row, then the characters
+  JOURNAL_DELETE_ROW,  // editorDelRow() - row
+  JOURNAL_INSERT_CHAR,  // editorRowInsertChar() - row, column, then the character
+  JOURNAL_DELETE_CHAR,  // editorRowDelChar() - row, column
+  JOURNAL_APPEND_STRING,  // editorRowAppendString() - row, then the characters
+  JOURNAL_TRUNCATE_ROW,  // editorRowTruncate() - row, and the length it was cut to in column
+  JOURNAL_SNAPSHOT,  // a save took its snapshot of the text here
+  JOURNAL_SAVED,  // that save finished - followed by the journalStamp of the file it left
+  JOURNAL_FOLLOWED  // lines written to a followed file were added to the end of the text - followed by the file's new journalStamp
+};
+
+typedef struct journalStamp {  // enough of a file's struct stat to tell whether it is still the file that was saved
+  int64_t device,
+          inode,
+          size,
+          seconds,  // the time it was last modified
+          nanoseconds;
+} journalStamp;
+
+typedef struct journal {  // the edits made since the file was last saved, kept in a file next to it so they outlive a crash
+  pthread_mutex_t lock;  // guards busy and the batch being written
+  pthread_cond_t change;  // signalled when a batch is handed to the journal thread, and when it has been written
+  pthread_t thread;  // writes each batch and syncs it to the disk, so the main thread never waits for the disk
+  bool on,  // edits are journaled at all - off with --no-journal
+       started,  // the thread is running
+       busy,  // the thread has a batch to write
+       replaying;  // the edits being made come from the journal, so they aren't added to it again
+  int fd,  // the journal file, or -1 if there isn't one open
+      error;  // errno from the last write that failed, or 0
+  char *path,  // the name of the journal file - .name.journal next to the file
+       *pending,  // the records made since the last batch was handed over - only the main thread looks at these
+       *writing;  // the batch the thread is writing
+  size_t pendingLength,
+         pendingCapacity,
+         writingLength,
+         writingCapacity;
+  double lastCommit;  // when the last batch was handed over, in seconds
+} journal;
+
+typedef struct followState {  // the file being followed with --follow, the way tail -F follows a log
+  bool wanted,  // --follow was given - the file is read rather than mapped, as a mapping would fault past the end of a truncated file
+       on,
+       changed,  // inotify has reported something that hasn't been looked at yet
+       partial,  // the last row is a line the file hasn't finished yet - it is read again once the rest of it turns up
+       touched,  // an edit has reached that row since it was read - it is left as the user made it, and the rest of its line becomes a row of its own
+       diverged;  // the text stopped being the file plus the lines added to it (it was truncated or replaced, or a line was split as above)
+                  // since it was last saved - the journal can't follow the file any more, so it has to stay with the old one
+  int inotify,  // the inotify instance, watching the file and the directory it is in
+      fileWatch,  // the watch on the file itself
+      fd;  // the file being read - kept open, so the lines written to it just before it is rotated are still read
+  int64_t offset,  // where the next read starts - the start of the unfinished line, if there is one
+          end;  // how much of the file has been read
+} followState;
+
+typedef struct streamState {  // text piped into the editor with "myEditor -", read as it comes
+  bool on;  // there is more of it to come
+  int fd;  // the pipe - standard input is the terminal again, so keys can still be read from it
+  char *buffer;  // the start of a line whose end hasn't come yet
+  size_t length,
+         capacity;
+} streamState;
+
+enum compressions {  // how a file is compressed - found from its first bytes when it is opened, or from its name when it is first saved
+  COMPRESSION_NONE,
+  COMPRESSION_GZIP,  // with zlib
+  COMPRESSION_ZSTD  // with libzstd, which is only loaded once a file needs it (see zstdLoad())
+};
+
+typedef struct zstdBuffer {  // zstd.h's ZSTD_inBuffer and ZSTD_outBuffer, which are laid out just like this
+  void *data;
+  size_t size,
+         pos;  // how much of it has been used
+} zstdBuffer;
+
+typedef struct zstdLibrary {  // the functions of libzstd that are used - it is opened with dlopen(), so only a .zst file needs it
+  void *handle;
+  bool tried;  // dlopen() has been tried already, and handle is what it gave
+  void *(*createCStream)(void);
+  size_t (*initCStream)(void *stream, int level);
+  size_t (*compressStream2)(void *stream, zstdBuffer *output, zstdBuffer *input, int end);  // end is ZSTD_e_continue (0) or ZSTD_e_end (2)
+  size_t (*freeCStream)(void *stream);
+  void *(*createDStream)(void);
+  size_t (*initDStream)(void *stream);
+  size_t (*decompressStream)(void *stream, zstdBuffer *output, zstdBuffer *input);
+  size_t (*freeDStream)(void *stream);
+  unsigned (*isError)(size_t code);
+  const char *(*getErrorName)(size_t code);
+} zstdLibrary;
+
+typedef struct codec {  // a gzip or zstd stream being compressed or decompressed
+  int format;  // COMPRESSION_GZIP or COMPRESSION_ZSTD
+  bool compressing;
+  z_stream gzip;
+  void *zstd;  // the ZSTD_CStream or ZSTD_DStream
+  char *output;  // CODEC_BUFFER_SIZE bytes for what comes out of it, before it is written
+  const char *error;  // what went wrong, if something did
+} codec;
+
+typedef struct decompression {  // a compressed file being decompressed on a thread of its own, into a pipe editorOpen() reads the text from
+  codec stream;
+  pthread_t thread;
+  int file,  // the compressed file
+      pipe;  // the end of the pipe the text is written to - closed once it has all been written
+} decompression;
+
+typedef struct textChunk {  // a run of lines of a file, cut where the content says to so the same lines are cut the same way however
+  uint64_t hash;             // much comes before them (see chunkAddLine())
+  int64_t start,  // the position of its first line in the text
+          rows;
+} textChunk;
+
+typedef struct chunkList {  // the chunks a file was cut into as it was read
+  textChunk *chunks;
+  int64_t count,
+          capacity;
+  uint64_t hash;  // the chunk being added to - it is put on the list once a line ends it, or the file does
+  int64_t start,
+          rows,
+          bytes;
+} chunkList;
+
+typedef struct reloadState {  // what editorReload() needs to take only the changed parts of a file that was changed on the disk
+  chunkList loaded;  // the chunks of the file as it was opened or last reloaded
+  bool known;  // loaded has been filled in - a mapped file's chunks are only worked out once editorReload() needs them, from the mapping
+  int64_t changedFrom;  // the position of the first row that may differ from what was loaded - unlike dirtyFrom, saving doesn't reset it
+  journalStamp noticed;  // the change to the file the user was last told about, so it is only said once
+  double lastCheck;  // when the file was last looked at, in seconds
+} reloadState;
+
+#define PAGER_BUDGET     (64 << 20)  // --pager keeps at most this many bytes of rows in memory, unless --pager=MB says otherwise
+#define PAGER_CHECKPOINT_LINES 1024  // the pager's line index only records where every 1024th line starts - 8 bytes per 1024 lines
+#define PAGER_READ_SIZE  (64 << 10)  // the pager reads the file 64 KB at a time - a random jump only costs that much of a read
+#define PAGER_LINE_LIMIT (1 << 20)  // but a row shows as much as the first megabyte of its line
+#define PAGER_LOAD_ROWS  256  // rows are made this many at a time, running on from the one asked for in the direction the screen is moving
+#define PAGER_SLOTS      16384  // the most rows the pager's window holds, however short they are
+
+typedef struct pagerSlot {  // a row in the pager's window
+  textRow row;
+  int64_t line;  // the position of the row in the text, or -1 if the slot is free
+  size_t bytes;  // what the row took when it was made
+  int64_t load;  // the pagerLoad() that made it
+  int newer,  // the least recently used list - -1 at its ends
+      older,
+      next;  // the next slot in the same hash chain, or on the free list
+} pagerSlot;
+
+typedef struct pagerState {  // a file opened with --pager - read-only, and only a window of its rows is ever in memory
+  bool on;
+  int fd;
+  int64_t size,  // the size of the file when it was opened - anything written after that isn't seen
+          indexed,  // the quantity of bytes searched for line ends so far - the rest of the file is searched between keypresses
+          *checkpoints,  // checkpoints[k] is the offset of the start of line k * PAGER_CHECKPOINT_LINES
+          checkpointCapacity,
+          loads,  // the quantity of times pagerLoad() has read rows into the window
+          lastAsked,  // the row last asked for - the next one missing is loaded with the rows after it if it comes after it
+          *lineOffsets,  // the start of every line between two checkpoints, and the end of the last one - so reading the lines of
+                         // that stretch in any order, backwards too, never has to read on from the checkpoint again
+          offsetsBlock,  // which stretch - lineOffsets holds the lines from offsetsBlock * PAGER_CHECKPOINT_LINES on, or -1 for none
+          offsetsCount,  // the quantity of lines in it - fewer than PAGER_CHECKPOINT_LINES at the end of what was searched so far
+          bufferOffset,  // where in the file *buffer was read from
+          bufferLength;
+  char *buffer,  // what was last read from the file - PAGER_LINE_LIMIT bytes of room
+       *scan;  // as much again, for searching for line ends without losing what is in *buffer
+  pagerSlot *slots;
+  int *buckets,  // the hash chains, by line - PAGER_SLOTS of them
+      newest,
+      oldest,
+      free,
+      count;  // the quantity of rows in the window
+  size_t budget,  // the most bytes of rows the window may hold - it only goes over to keep a screenful
+         used;
+} pagerState;
+
+#define HEX_ROW_BYTES      16  // the hex view shows this many bytes of the file on each line of the screen
+#define HEX_DATA_COLUMN    14  // after the offset of the line's first byte, as 12 hex digits and two spaces
+#define HEX_PATCH_CAPACITY 1024  // the patch map starts with room for this many changed bytes, and doubles when it is half full
+#define HEX_WRITE_SIZE     (64 << 10)  // a save writes runs of changed bytes next to each other with one pwrite() of up to this many
+
+typedef struct hexPatch {  // a byte changed in the hex view
+  int64_t offset;  // where it is in the file, or -1 for a free entry of the patch map
+  byte value;
+} hexPatch;
+
+typedef struct hexView {  // a file opened with --hex - its bytes are shown straight from a mapping of it, and only the bytes on the
+  bool on,                // screen are ever read
+       writable,  // the file could be opened for writing, so a save can write the changes to it
+       lowNibble;  // the next hex digit typed goes into the low half of the byte under the cursor
+  int fd;
+  byte *base;  // the mapping - shared, so it shows what a save writes to the file
+  volatile sig_atomic_t cutShort;  // a page of it was gone when it was read, like mappedFile's
+  int64_t size,
+          cursor,  // the offset of the byte under the cursor
+          patchCount,
+          patchCapacity;
+  hexPatch *patches;  // the bytes changed since the last save, by offset - open addressing, so finding one is O(1)
+} hexView;
+
+#define ABUF_CAPACITY 256  // an append buffer starts with room for this many bytes, and doubles its room whenever it runs out
+
+struct abuf {  // an append buffer - what is added to it goes on the end, and its room is kept when it is emptied to be filled again
+  char *b;
+  size_t len,
+         capacity;
+};
+
+#define ABUF_INIT { NULL, 0, 0 }
+
+typedef struct screenLine {  // a line of the terminal as it was last drawn - its characters with the escape sequences that color them,
+  struct abuf drawn;          // so a change of color alone counts as a change
+  bool known;  // false if what the terminal shows there isn't known
+} screenLine;
+
+typedef struct screenFrame {  // what the terminal shows, so a refresh only sends the lines that differ from it
+  screenLine *lines;  // a line for each row of text, then the status bar and the message bar - NULL until the first refresh
+  struct abuf line,  // each line is drawn here to compare it with the one the terminal shows - they swap places if they differ
+              output;  // and what a refresh writes to the terminal goes here - both are kept from frame to frame, like the lines, so
+                       // drawing a frame needn't allocate anything
+  int rows,  // the size of the screen the lines were drawn for - a different size draws every line again
+      columns;
+  int64_t rowOffset,  // the rows and columns of the text they showed - rowOffset is -1 while none of the lines are known, as there
+          columnOffset;  // is nothing on the terminal worth scrolling
+  double lastDrawn;  // when the last frame was written to the terminal, in seconds
+} screenFrame;
+
 typedef struct textBuffer {  // global editor state
-  int cursorXPosition, 
-      cursorYPosition,  // cursorXPosition - horizontal index into the characters field of textRow (cursor location???)
-      displayXPosition,  //horizontal index into the display field of textRow - if there are no tab son the current line, displayXPosition will be the same as cursorXPosition 
-      rowOffset,  // row offset - keeps track of what row of the file the user is currently scrolled to
-      columnOffset,  // column offset - keeps track of what column of the file the user is currently scrolled to
-      screenRows,  // qty of rows on the screen - window size
-      screenColumns,  // qty of columns on the screen - window size
-      totalRows;  // the number of rows (lines) of text being displayed/stored by the editor
-  textRow *row;  // Hold a single row of test, both as read from a file, and as displayed on the screen
+  int64_t cursorXPosition, 
+          cursorYPosition,  // cursorXPosition - horizontal index into the characters field of textRow (cursor location???)
+          displayXPosition,  //horizontal index into the display field of textRow - if there are no tab son the current line, displayXPosition will be the same as cursorXPosition 
+          rowOffset,  // row offset - keeps track of what row of the file the user is currently scrolled to
+          columnOffset;  // column offset - keeps track of what column of the file the user is currently scrolled to
+  int screenRows,  // qty of rows on the screen - window size
+      screenColumns;  // qty of columns on the screen - window size
+  int64_t totalRows;  // the number of rows (lines) of text being displayed/stored by the editor
+  pieceTable rows;  // Holds every row of text, both as read from a file, and as displayed on the screen
+  rowArena arena;  // the memory the rows read from the file live in
+  mappedFile map;  // the file the original buffer's rows come from, when it was opened with mmap()
+  long pageSize;  // for editorMappingFault() - a signal handler can't ask sysconf()
+  bool atomicSave;  // --atomic - save by writing a new file next to the old one and renaming it over it, so a crash never leaves half a file behind
+  int compression;  // the file is compressed like this, and is saved the same way
+  int64_t version;  // goes up by one with every edit, so a save knows whether the text changed while it was being written
+  int64_t dirtyFrom;  // the position of the first row that may differ from the file - INT64_MAX if none do
+  struct stat savedFile;  // the file as it was when it was last opened or saved - only valid if savedKnown
+  bool savedKnown;  // false if the file hasn't been opened or saved, or a save of it failed part way through
+  bool carriageReturns;  // a line read from the file ended in \r\n, and its row doesn't keep the \r - so the rows' lengths don't add up
+                         // to where a row starts in the file, and editorSaveTail() can't be used until a save has written all of it
+  saveState save;  // the save running in the background, if there is one
+  journal journal;  // where every edit goes as it is made, for editorJournalRecover() to make again after a crash
+  followState follow;  // the lines added to the file while it is open, for editorFollowCheck() to add to the text
+  streamState stream;  // the text coming down a pipe, for editorStreamRead() to add to the text
+  reloadState reload;  // the file's chunks, for editorReload() to compare with the file after something else changed it
+  pagerState pager;  // the file opened with --pager, which takes the place of everything above that holds rows
+  hexView hex;  // the file opened with --hex, which does too
+  screenFrame frame;  // the screen as it was last drawn
   bool modified;  // modified flag - We call a text buffer “modified” if it has been modified since opening or saving the file - used to keep track of whether the text loaded in our editor differs from what’s in the file
+  bool prompting;  // editorPrompt() is waiting for an answer - the text isn't reloaded, followed or streamed into until it has one
   char *filename,  // Name of the file being edited
        statusMessage[80];  // holds an 80 character message to the user displayed on the status bar.
   time_t statusMessage_time;  // timestamp for the status message - current status message will only display for five seconds or until the next key is pressed since the screen in refreshed only when a key is pressed.
@@ -152,6 +549,7 @@ typedef struct textBuffer {  // global editor state
 } textBuffer;
 
 textBuffer Text;
+zstdLibrary Zstd;
 
 /*** filetypes ***/
 
@@ -192,6 +590,31 @@ syntaxInfo syntaxDatabase[] = {  // syntaxDatabase stands for “highlight datab
 void editorSetStatusMessage(const char *fmt, ...);
 void editorRefreshScreen();
 char *editorPrompt(char *prompt, void (*callback)(char *, int));
+void editorUpdateSyntax(textRow *row);
+void editorReserveColor(textRow *row, int64_t length);
+textRow *editorMakeRow(piece *p, int64_t slot, int64_t at);
+void editorLineSpan(int64_t slot, char **text, int64_t *length);
+bool editorLoading();
+void editorIndexMore(size_t bytes);
+textRow *pagerRowAt(int64_t at);
+textRow *pagerRowIfMade(int64_t at);
+void editorSaveProgress();
+void editorMarkDirty(int64_t at);
+void journalRecord(int operation, int64_t row, int64_t column, const char *text, size_t length);
+void journalCommit(bool now);
+void journalDiscard();
+bool editorFollowCheck();
+bool editorReloadCheck();
+bool editorMappingCheck();
+bool editorStreamRead();
+int compressionOf(const unsigned char *magic, size_t length);
+int compressionOfName(const char *filename, size_t *stem);
+bool codecStart(codec *stream, int format, bool compressing);
+bool codecCompress(codec *stream, int fd, const char *data, size_t length, bool end, size_t *written);
+void codecEnd(codec *stream);
+FILE *decompressStart(decompression *job, int fd, int format);
+const char *decompressFinish(decompression *job, FILE *input);
+void editorSaveWait();
 
 // 8888888888 888     888 888b    888  .d8888b. 88888888888 8888888 .d88888b.  888b    888  .d8888b.  
 // 888        888     888 8888b   888 d88P  Y88b    888       888  d88P" "Y88b 8888b   888 d88P  Y88b 
@@ -260,15 +683,52 @@ void enableRawMode()  // enable raw text input mode
   }
 }
 
+// -----------------------------------------------------------------------------
+// returns true if a keypress is waiting to be read, without waiting for one
+bool keyWaiting() {
+  struct pollfd input = { STDIN_FILENO, POLLIN, 0 };
+  return poll(&input, 1, 0) > 0;
+}
+
 // -----------------------------------------------------------------------------
 // waits for one keypress and returns it
 int editorReadKey() 
 {
   int nread;
   char keypress;
+  while (editorLoading() && !keyWaiting()) {  // search the rest of a mapped file for lines while nobody is typing
+    editorIndexMore(INDEX_STEP);
+    editorRefreshScreen();  // the line count on the status bar goes up
+  }
+  editorSaveProgress();  // a save that finished while keys kept coming is picked up here
+  journalCommit(false);  // the edits made since the last batch go to the disk, if it has been JOURNAL_SYNC_MS since then
+  if (!Text.prompting) {  // a prompt's callback may hold on to a row (see editorFindCallback()), so no rows come or go until it is answered
+    if (editorMappingCheck()) editorRefreshScreen();  // a mapped file something else truncated while keys kept coming
+    editorFollowCheck();  // the lines written to a followed file while keys kept coming
+    while (!keyWaiting() && editorStreamRead()) editorRefreshScreen();  // and the text piped in, for as long as nobody is typing
+  }
+
+  pthread_mutex_unlock(&Text.save.lock);  // while we wait, a save running in the background can look at the rows
   while ((nread = read(STDIN_FILENO, &keypress, 1)) != 1) {  // read 1 byte from standard input (keyboard) into c
     if (nread == ERROR && errno != EAGAIN) die("read");  // and exit program if there is an error
+    journalCommit(true);  // nobody is typing, so the last few edits go to the disk now
+    if (Text.follow.on && !Text.prompting) {  // and lines written to a followed file show up within a tenth of a second
+      pthread_mutex_lock(&Text.save.lock);
+      if (editorFollowCheck()) editorRefreshScreen();
+      pthread_mutex_unlock(&Text.save.lock);
+    }
+    pthread_mutex_lock(&Text.save.lock);  // and a file something else changed is reloaded, or the user is told about it
+    if (!Text.prompting && (editorMappingCheck() || editorReloadCheck())) editorRefreshScreen();
+    while (!Text.prompting && !keyWaiting() && editorStreamRead()) editorRefreshScreen();  // and the text piped in since the last tick shows up
+    pthread_mutex_unlock(&Text.save.lock);
+    if (Text.save.running) {  // read() gives up every tenth of a second (VTIME), so the save's progress is shown that often
+      pthread_mutex_lock(&Text.save.lock);
+      editorSaveProgress();
+      editorRefreshScreen();
+      pthread_mutex_unlock(&Text.save.lock);
+    }
   }
+  pthread_mutex_lock(&Text.save.lock);
 
   if (keypress == '\x1b') {  // if c is an escape charater
     char seq[3];
@@ -364,6 +824,321 @@ int getWindowSize(int *rows, int *cols)
   }
 }
 
+/*** piece table ***/
+// 8888888b.  8888888 8888888888  .d8888b.  8888888888       88888888888        d8888 888888b.   888      8888888888 
+// 888   Y88b   888   888        d88P  Y88b 888                  888           d88888 888  "88b  888      888        
+// 888    888   888   888        888    888 888                  888          d88P888 888  .88P  888      888        
+// 888   d88P   888   8888888    888        8888888              888         d88P 888 8888888K.  888      8888888    
+// 8888888P"    888   888        888        888                  888        d88P  888 888  "Y88b 888      888        
+// 888          888   888        888    888 888                  888       d88P   888 888    888 888      888        
+// 888          888   888        Y88b  d88P 888                  888      d8888888888 888   d88P 888      888        
+// 888        8888888 8888888888  "Y8888P"  8888888888           888     d88P     888 8888888P"  88888888 8888888888 
+
+// -----------------------------------------------------------------------------
+// returns a pointer to the row stored in the given slot of one of the piece table buffers - for a mapped file, the row may not have 
+// been made yet (see madeRow())
+textRow *bufferRow(int source, int64_t slot) {
+  if (source == ADD_BUFFER) return &Text.rows.addBlocks[slot / ADD_BLOCK_ROWS][slot % ADD_BLOCK_ROWS];
+  if (Text.map.base == NULL) return &Text.rows.original[slot];
+
+  textRow **block = &Text.map.rowBlocks[slot / ADD_BLOCK_ROWS];
+  if (*block == NULL) *block = calloc(ADD_BLOCK_ROWS, sizeof(textRow));  // zeroed, so none of its rows are made
+  return &(*block)[slot % ADD_BLOCK_ROWS];
+}
+
+// -----------------------------------------------------------------------------
+// returns the row stored in a slot, or NULL if it is a line of a mapped file that hasn't been made into a row yet
+textRow *madeRow(int source, int64_t slot) {
+  if (source == ORIGINAL_BUFFER && Text.map.base) {
+    textRow *block = Text.map.rowBlocks[slot / ADD_BLOCK_ROWS];
+    if (block == NULL || block[slot % ADD_BLOCK_ROWS].characters == NULL) return NULL;
+  }
+  return bufferRow(source, slot);
+}
+
+// -----------------------------------------------------------------------------
+// the quantity of rows in a subtree - an empty subtree (NULL) holds no rows
+int64_t pieceRows(piece *p) {
+  return p ? p->subtreeRows : 0;
+}
+
+// -----------------------------------------------------------------------------
+// points each row of a piece at the piece, so the row can find its own position in the text
+void pieceClaimRows(piece *p) {
+  for (int64_t j = 0; j < p->count; j++) {
+    textRow *row = madeRow(p->source, p->start + j);
+    if (row) row->owner = p;  // a row made later is pointed at its piece then
+  }
+}
+
+// -----------------------------------------------------------------------------
+// returns the next treap priority - xorshift on a state of its own rather than rand(), so making pieces never moves the rand()
+// sequence something else seeded with srand() is drawing from
+int pieceRandom() {
+  static uint32_t state = 2463534242u;
+  state ^= state << 13;
+  state ^= state >> 17;
+  state ^= state << 5;
+  return (int)(state >> 1);  // never negative
+}
+
+// -----------------------------------------------------------------------------
+// allocates a new piece holding count rows of a buffer starting at start
+piece *pieceNew(int source, int64_t start, int64_t count) {
+  piece *p = malloc(sizeof(piece));
+  p->left = p->right = p->parent = NULL;
+  p->priority = pieceRandom();
+  p->source = source;
+  p->start = start;
+  p->count = count;
+  p->subtreeRows = count;
+  return p;
+}
+
+// -----------------------------------------------------------------------------
+// recalculates subtreeRows after the children of a piece change, and points the children back at it
+void pieceUpdate(piece *p) {
+  p->subtreeRows = pieceRows(p->left) + p->count + pieceRows(p->right);
+  if (p->left) p->left->parent = p;
+  if (p->right) p->right->parent = p;
+}
+
+// -----------------------------------------------------------------------------
+// joins two trees into one - every row of a comes before every row of b
+piece *pieceMerge(piece *a, piece *b) {
+  if (a == NULL) return b;
+  if (b == NULL) return a;
+  if (a->priority > b->priority) {  // a stays on top, b is merged into its right subtree
+    a->right = pieceMerge(a->right, b);
+    pieceUpdate(a);
+    return a;
+  }
+  b->left = pieceMerge(a, b->left);  // b stays on top, a is merged into its left subtree
+  pieceUpdate(b);
+  return b;
+}
+
+// -----------------------------------------------------------------------------
+// splits a tree in two - *left gets the first at rows, *right gets the rest
+void pieceSplit(piece *p, int64_t at, piece **left, piece **right) {
+  if (p == NULL) {
+    *left = *right = NULL;
+    return;
+  }
+
+  int64_t leftRows = pieceRows(p->left);
+  if (at <= leftRows) {  // the split is somewhere in the left subtree
+    pieceSplit(p->left, at, left, &p->left);
+    pieceUpdate(p);
+    *right = p;
+  } else if (at >= leftRows + p->count) {  // the split is somewhere in the right subtree
+    pieceSplit(p->right, at - leftRows - p->count, &p->right, right);
+    pieceUpdate(p);
+    *left = p;
+  } else {  // the split falls inside this piece, so it has to be cut in two
+    int64_t k = at - leftRows;  // the quantity of rows that go to the left half
+    piece *q = pieceNew(p->source, p->start, k);
+    q->priority = p->priority;  // keep the same priority so both halves stay above their children
+    if (k <= p->count - k) {  // q takes the left half - only the smaller half of the rows (at most PIECE_MAX_ROWS / 2) has to be pointed at a new piece
+      q->left = p->left;
+      p->left = NULL;
+      p->start += k;
+      p->count -= k;
+      *left = q;
+      *right = p;
+    } else {  // q takes the right half
+      q->start = p->start + k;
+      q->count = p->count - k;
+      q->right = p->right;
+      p->right = NULL;
+      p->count = k;
+      *left = p;
+      *right = q;
+    }
+    pieceClaimRows(q);
+    pieceUpdate(q);
+    pieceUpdate(p);
+  }
+}
+
+// -----------------------------------------------------------------------------
+// splits the whole text at row at - the two halves get no parent so they can be used as roots
+void pieceTableSplit(int64_t at, piece **left, piece **right) {
+  pieceSplit(Text.rows.root, at, left, right);
+  if (*left) (*left)->parent = NULL;
+  if (*right) (*right)->parent = NULL;
+  Text.rows.root = NULL;
+}
+
+// -----------------------------------------------------------------------------
+// joins three trees back together and makes the result the text
+void pieceTableJoin(piece *left, piece *middle, piece *right) {
+  Text.rows.root = pieceMerge(pieceMerge(left, middle), right);
+  if (Text.rows.root) Text.rows.root->parent = NULL;
+}
+
+// -----------------------------------------------------------------------------
+// places the row in the given slot of a buffer at position at in the text
+void pieceTableInsert(int64_t at, int source, int64_t slot) {
+  piece *left, *right;
+  pieceTableSplit(at, &left, &right);
+
+  piece *last = left;  // the piece holding the row just before the insertion point
+  while (last && last->right) last = last->right;
+
+  if (last && last->source == source && last->start + last->count == slot &&  // the new row directly follows the last piece in its buffer and
+      last->count < PIECE_MAX_ROWS) {                                         // the piece still has room, so 
+    last->count++;                                                            // just make that piece one row longer instead of adding a new one
+    for (piece *p = last; p; p = p->parent) p->subtreeRows++;
+    bufferRow(source, slot)->owner = last;
+    pieceTableJoin(left, NULL, right);
+  } else {
+    piece *p = pieceNew(source, slot, 1);
+    bufferRow(source, slot)->owner = p;
+    pieceTableJoin(left, p, right);
+  }
+}
+
+// -----------------------------------------------------------------------------
+// takes the row at position at out of the text - the caller is responsible for the memory owned by the row
+void pieceTableRemove(int64_t at) {
+  piece *left, *middle, *right;
+  pieceTableSplit(at, &left, &right);
+  Text.rows.root = right;
+  pieceTableSplit(1, &middle, &right);  // middle is now a single piece holding just the removed row
+  free(middle);
+  pieceTableJoin(left, NULL, right);
+}
+
+// -----------------------------------------------------------------------------
+// returns the piece holding the row at position at in the text, and puts the row's slot in its buffer in *slot - O(log n) in the
+// quantity of pieces
+piece *pieceAt(int64_t at, int64_t *slot) {
+  piece *p = Text.rows.root;
+  while (p) {
+    int64_t leftRows = pieceRows(p->left);
+    if (at < leftRows) {
+      p = p->left;
+    } else if (at < leftRows + p->count) {
+      *slot = p->start + at - leftRows;
+      return p;
+    } else {
+      at -= leftRows + p->count;
+      p = p->right;
+    }
+  }
+  return NULL;
+}
+
+// -----------------------------------------------------------------------------
+// returns the row at position at in the text, making it first if it is a line of a mapped file nothing has looked at yet (or one of a
+// file opened with --pager that isn't in the window)
+textRow *editorRowAt(int64_t at) {
+  if (Text.pager.on) return pagerRowAt(at);
+  int64_t slot;
+  piece *p = pieceAt(at, &slot);
+  if (p == NULL) return NULL;
+  textRow *row = madeRow(p->source, slot);
+  return row ? row : editorMakeRow(p, slot, at);
+}
+
+// -----------------------------------------------------------------------------
+// returns the row at position at in the text, or NULL if it hasn't been made yet
+textRow *editorRowIfMade(int64_t at) {
+  if (Text.pager.on) return pagerRowIfMade(at);
+  int64_t slot;
+  piece *p = pieceAt(at, &slot);
+  return p ? madeRow(p->source, slot) : NULL;
+}
+
+// -----------------------------------------------------------------------------
+// returns the position of a row in the text - walks up from the row's piece to the root, adding up every row that comes before it
+int64_t editorRowIndex(textRow *row) {
+  piece *p = row->owner;
+  int64_t at = pieceRows(p->left) + (row->slot - p->start);
+  while (p->parent) {
+    if (p == p->parent->right) at += pieceRows(p->parent->left) + p->parent->count;
+    p = p->parent;
+  }
+  return at;
+}
+
+// -----------------------------------------------------------------------------
+// returns the first piece of the text, or NULL if there is no text
+piece *pieceFirst() {
+  piece *p = Text.rows.root;
+  while (p && p->left) p = p->left;
+  return p;
+}
+
+// -----------------------------------------------------------------------------
+// returns the piece that comes after p in the text, or NULL if p is the last one
+piece *pieceNext(piece *p) {
+  if (p->right) {
+    p = p->right;
+    while (p->left) p = p->left;
+    return p;
+  }
+  while (p->parent && p == p->parent->right) p = p->parent;
+  return p->parent;
+}
+
+// -----------------------------------------------------------------------------
+// adds count rows of a buffer starting at start to the end of the text, in pieces as long as they are allowed to be
+void pieceTableAppend(int source, int64_t start, int64_t count) {
+  while (count > 0) {
+    int64_t n = count < PIECE_MAX_ROWS ? count : PIECE_MAX_ROWS;
+    piece *p = pieceNew(source, start, n);
+    pieceClaimRows(p);
+    pieceTableJoin(Text.rows.root, p, NULL);
+    start += n;
+    count -= n;
+  }
+}
+
+// -----------------------------------------------------------------------------
+// frees a piece and every piece below it
+void pieceFreeAll(piece *p) {
+  if (p == NULL) return;
+  pieceFreeAll(p->left);
+  pieceFreeAll(p->right);
+  free(p);
+}
+
+// -----------------------------------------------------------------------------
+// adds an empty row to the end of the add buffer and returns its slot
+int64_t addBufferNewRow() {
+  if (Text.rows.addRows % ADD_BLOCK_ROWS == 0) {  // the last block is full (or there are no blocks yet), so allocate a new one
+    int64_t blocks = Text.rows.addRows / ADD_BLOCK_ROWS;
+    Text.rows.addBlocks = realloc(Text.rows.addBlocks, sizeof(textRow *) * (blocks + 1));
+    Text.rows.addBlocks[blocks] = malloc(sizeof(textRow) * ADD_BLOCK_ROWS);
+  }
+  int64_t slot = Text.rows.addRows++;
+  bufferRow(ADD_BUFFER, slot)->slot = slot;
+  return slot;
+}
+
+// -----------------------------------------------------------------------------
+// makes sure the original buffer has room for rows rows without being reallocated - used to size it up front from an estimate of 
+// how many lines a file has
+void originalBufferReserve(int64_t rows) {
+  if (rows <= Text.rows.originalCapacity) return;
+  Text.rows.originalCapacity = rows;
+  Text.rows.original = realloc(Text.rows.original, sizeof(textRow) * rows);
+}
+
+// -----------------------------------------------------------------------------
+// adds an empty row to the end of the original buffer and returns its slot - only used by editorAppendRows()
+int64_t originalBufferNewRow() {
+  if (Text.rows.originalRows == Text.rows.originalCapacity) {  // double the capacity whenever the buffer is full
+    Text.rows.originalCapacity = Text.rows.originalCapacity ? Text.rows.originalCapacity * 2 : 1024;
+    Text.rows.original = realloc(Text.rows.original, sizeof(textRow) * Text.rows.originalCapacity);
+  }
+  int64_t slot = Text.rows.originalRows++;
+  bufferRow(ORIGINAL_BUFFER, slot)->slot = slot;
+  return slot;
+}
+
 
 // 888    888 8888888 .d8888b.  888    888 888      8888888 .d8888b.  888    888 88888888888 
 // 888    888   888  d88P  Y88b 888    888 888        888  d88P  Y88b 888    888     888     
@@ -374,6 +1149,81 @@ int getWindowSize(int *rows, int *cols)
 // 888    888   888  Y88b  d88P 888    888 888        888  Y88b  d88P 888    888     888     
 // 888    888 8888888 "Y8888P88 888    888 88888888 8888888 "Y8888P88 888    888     888   
 
+/*** arena ***/
+//        d8888 8888888b.  8888888888 888b    888        d8888 
+//       d88888 888   Y88b 888        8888b   888       d88888 
+//      d88P888 888    888 888        88888b  888      d88P888 
+//     d88P 888 888   d88P 8888888    888Y88b 888     d88P 888 
+//    d88P  888 8888888P"  888        888 Y88b888    d88P  888 
+//   d88P   888 888 T88b   888        888  Y88888   d88P   888 
+//  d8888888888 888  T88b  888        888   Y8888  d8888888888 
+// d88P     888 888   T88b 8888888888 888    Y888 d88P     888 
+
+// -----------------------------------------------------------------------------
+// hands out size bytes from the load arena, starting a new block when the last one is full
+void *arenaAlloc(size_t size) {
+  if (Text.arena.blockCount == 0 || Text.arena.used + size > Text.arena.size) {
+    size_t blockSize = size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE;  // a line longer than a block gets a block of its own
+    Text.arena.blocks = realloc(Text.arena.blocks, sizeof(char *) * (Text.arena.blockCount + 1));
+    Text.arena.blocks[Text.arena.blockCount++] = malloc(blockSize);
+    Text.arena.used = 0;
+    Text.arena.size = blockSize;
+  }
+  void *memory = &Text.arena.blocks[Text.arena.blockCount - 1][Text.arena.used];
+  Text.arena.used += size;
+  return memory;
+}
+
+// -----------------------------------------------------------------------------
+// frees every block of the load arena at once
+void arenaFree() {
+  for (int j = 0; j < Text.arena.blockCount; j++) free(Text.arena.blocks[j]);
+  free(Text.arena.blocks);
+  free(Text.arena.ownedRows);
+  Text.arena.blocks = NULL;
+  Text.arena.blockCount = 0;
+  Text.arena.ownedRows = NULL;
+  Text.arena.ownedCount = 0;
+  Text.arena.ownedCapacity = 0;
+  Text.arena.used = 0;
+  Text.arena.size = 0;
+}
+
+// -----------------------------------------------------------------------------
+// realloc() for the buffers of a row - part is the buffer's ARENA_ bit. While a file is loading, new buffers come from the arena. 
+// A buffer that is in the arena is copied out to an allocation of its own the first time it has to grow.
+void *rowAllocate(textRow *row, int part, void *buffer, size_t oldSize, size_t size) {
+  if (buffer == NULL && Text.arena.open) {
+    row->memory |= part;
+    return arenaAlloc(size);
+  }
+
+  if (row->memory & ARENA_ONLY) {  // a loaded row is getting its first allocation - remember it so closing the file can free it
+    row->memory &= ~ARENA_ONLY;
+    if (Text.arena.ownedCount == Text.arena.ownedCapacity) {
+      Text.arena.ownedCapacity = Text.arena.ownedCapacity ? Text.arena.ownedCapacity * 2 : 64;
+      Text.arena.ownedRows = realloc(Text.arena.ownedRows, sizeof(int64_t) * Text.arena.ownedCapacity);
+    }
+    Text.arena.ownedRows[Text.arena.ownedCount++] = row->slot;
+  }
+
+  if (row->memory & part) {  // moving out of the arena (or the mapped file)
+    row->memory &= ~part;
+    if (part == ARENA_CHARACTERS) row->memory &= ~MAPPED;
+    void *own = malloc(size);
+    memcpy(own, buffer, oldSize < size ? oldSize : size);
+    return own;
+  }
+  return realloc(buffer, size);
+}
+
+// -----------------------------------------------------------------------------
+// free() for the buffers of a row - a buffer in the arena is simply forgotten, the arena frees it along with everything else
+void rowRelease(textRow *row, int part, void *buffer) {
+  if (!(row->memory & part)) free(buffer);
+  row->memory &= ~part;
+}
+
 /*** syntax highlighting ***/
 
 // -----------------------------------------------------------------------------
@@ -387,12 +1237,12 @@ int is_separator(int c) {  // this function should be type Boolean
 
 // -----------------------------------------------------------------------------
 // Might not need int prev_sep - maybe just use function? OR maybe keep track of what type of char the prev char was - not just separartor, but number, or other too???
-void editorUpdateSyntax(textRow *row) {
-  row->textColor = realloc(row->textColor, row->displayLength);  // First we realloc() the needed memory, since this might be a new row or the row might be bigger than the last time we highlighted it.
-  memset(row->textColor, HL_NORMAL, row->displayLength);  // use memset() to set all characters to HL_NORMAL by default
-
-  if (Text.syntax == NULL) return;
-
+// Highlights a row starting at display index i. Lexing can only restart at the beginning of the row or just after an HL_NORMAL 
+// character, because that is the only place the lexer state (not in a string, not in a comment) can be read back out of textColor.
+// Once the lexer is past editEnd (the first display index an edit did not change) and is back in that same state where the old 
+// highlighting was too, everything after is already highlighted correctly and the loop stops early. in_comment says whether the row 
+// starts inside a multi-line comment. Returns true when the row's commentLeftOpen changed, so the row after it needs highlighting too.
+bool editorHighlightRow(textRow *row, int64_t i, int64_t editEnd, bool in_comment) {
   char **keywords = Text.syntax->keywords;  // declare an array of strings (pointer to a pointer) and point it at the keywords array in the Text.syntax struct
 
   // If you don’t want single-line comment highlighting for a particular filetype, you should be able to set commentStart either to NULL or to the empty string ("")
@@ -408,12 +1258,18 @@ void editorUpdateSyntax(textRow *row) {
   int prev_sep = 1;  // previous_separator - keeps track of whether the previous character was a separator so it can be used to recognize and highlight numbers properly. 
                      // We initialize prev_sep to 1 (meaning true) because we consider the beginning of the line to be a separator.
   int in_string = 0;  // keep track of whether we are currently inside a string
-  bool in_comment = (row->index > 0 && Text.row[row->index - 1].commentLeftOpen);  // initialize in_comment to true if the previous row has an unclosed multi-line comment
+  if (i > 0) {  // restarting after an HL_NORMAL character - not in a string or a comment, and prev_sep depends only on that character
+    prev_sep = is_separator(row->display[i - 1]);
+    in_comment = false;
+  }
+  bool plain_step = false;  // true when the last pass through the loop consumed a single HL_NORMAL character
+  byte old_hl = HL_NORMAL;  // the highlighting that character had before this update
 
-  int i = 0;
-  while (i < row->length) {  // loop through the characters
+  while (i < row->displayLength) {  // loop through the characters
     char c = row->display[i];
     byte prev_hl = (i > 0) ? row->textColor[i - 1] : HL_NORMAL;  // set to the highlight type of the previous character if not the beginning of the line
+    if (plain_step && old_hl == HL_NORMAL && i - 1 >= editEnd) return false;  // caught up with the old highlighting - the rest of the row (and the next row) are unchanged
+    plain_step = false;
 
     if (scs_len && !in_string && !in_comment) {  // So we wrap our comment highlighting code in an if statement that checks scs_len and also makes sure we’re not in a string and not in a multiline comment, since we’re placing this code above the string highlighting code (order matters a lot in this function)
       if (!strncmp(&row->display[i], scs, scs_len)) {  //  use strncmp() to check if this character is the start of a single-line comment
@@ -502,16 +1358,96 @@ void editorUpdateSyntax(textRow *row) {
     }
 
     prev_sep = is_separator(c);  // current character is not a number - set prev_sep
+    old_hl = row->textColor[i];
+    row->textColor[i] = HL_NORMAL;
+    plain_step = true;
     i++;  // increment i since we didn't continue the loop
   }
 
   // end of row processing
-  int changed = (row->commentLeftOpen != in_comment);  // if the value of commentLeftOpen changed
+  bool changed = (row->commentLeftOpen != in_comment);  // if the value of commentLeftOpen changed
   row->commentLeftOpen = in_comment;  // set the value of the current row’s commentLeftOpen to whatever state in_comment got left in after processing the entire row - tells us whether the row ended as an unclosed multi-line comment or not.
-  if (changed && row->index + 1 < Text.totalRows)  // if the value of commentLeftOpen changed and this not the last line of the file/text
-    editorUpdateSyntax(&Text.row[row->index + 1]);  // recursive call to editorUpdateSyntax with next row as arguement - this will update the syntax of every row after this one until the end of the file if this line ended in an open line comment
+  return changed;
 }  // rework this without the continue and remove the second incrementation of i
 
+// -----------------------------------------------------------------------------
+// highlights a row starting at display index i (see editorHighlightRow()), then the rows after it for as long as a multi-line comment 
+// left open or closed by the row changes them - a row of a mapped file that hasn't been made yet picks the change up when it is made
+void editorUpdateSyntaxFrom(textRow *row, int64_t i, int64_t editEnd) {
+  int64_t at = editorRowIndex(row);  // the position of the row in the text - needed to find the rows before and after it
+  textRow *previous = (at > 0) ? editorRowIfMade(at - 1) : NULL;  // rows are made from the top when there are multi-line comments, so this is only NULL when it doesn't matter
+  bool in_comment = (previous && previous->commentLeftOpen);  // initialize in_comment to true if the previous row has an unclosed multi-line comment
+  textRow *next = (at + 1 < Text.totalRows) ? editorRowIfMade(at + 1) : NULL;
+  if (editorHighlightRow(row, i, editEnd, in_comment) && next)  // if commentLeftOpen changed and this not the last line of the text
+    editorUpdateSyntax(next);  // recursive call to editorUpdateSyntax with next row as arguement - this will update the syntax of every row after this one until the end of the file if this line ended in an open line comment
+}
+
+// -----------------------------------------------------------------------------
+// highlights a whole row from scratch
+void editorUpdateSyntax(textRow *row) {
+  if (Text.syntax == NULL) {  // every character would be HL_NORMAL, so there is nothing worth storing
+    rowRelease(row, ARENA_COLORS, row->textColor);
+    row->textColor = NULL;
+    row->colorCapacity = 0;
+    return;
+  }
+
+  editorReserveColor(row, row->displayLength);
+  memset(row->textColor, HL_NORMAL, row->displayLength);  // use memset() to set all characters to HL_NORMAL by default
+  editorUpdateSyntaxFrom(row, 0, row->displayLength);  // an edit end past the last character means the loop never stops early
+}
+
+// -----------------------------------------------------------------------------
+// highlights every row from position from to the end of the text in a single pass - the multi-line comment state is carried from one
+// row to the next instead of each row looking up the row above it and re-highlighting the row below it
+void editorHighlightRows(int64_t from) {
+  if (Text.syntax == NULL || from >= Text.totalRows) return;
+
+  bool in_comment = (from > 0 && editorRowAt(from - 1)->commentLeftOpen);
+  textRow *row = editorRowAt(from);
+  piece *run = row->owner;
+  for (int64_t k = row->slot - run->start; run; run = pieceNext(run), k = 0) {
+    for (; k < run->count; k++) {
+      row = madeRow(run->source, run->start + k);
+      if (row == NULL) continue;  // highlighted when it is made
+      editorReserveColor(row, row->displayLength);
+      memset(row->textColor, HL_NORMAL, row->displayLength);
+      editorHighlightRow(row, 0, row->displayLength, in_comment);
+      in_comment = row->commentLeftOpen;
+    }
+  }
+}
+
+// -----------------------------------------------------------------------------
+// the furthest past its current character the highlighter ever looks - an edit can change the highlighting of characters up to 
+// this many places before it (typing a * after a / turns the / into the start of a comment, for example)
+int syntaxLookahead() {
+  int lookahead = 2;  // a backslash in a string highlights the character after it
+  char *delimiters[] = { Text.syntax->commentStart, Text.syntax->blockCommentStart, Text.syntax->blockCommentEnd };
+  for (int j = 0; j < 3; j++) {
+    int len = delimiters[j] ? strlen(delimiters[j]) : 0;
+    if (len > lookahead) lookahead = len;
+  }
+  for (int j = 0; Text.syntax->keywords[j]; j++) {
+    int klen = strlen(Text.syntax->keywords[j]) + 1;  // keywords also look at the separator after them (a type keyword's | stands in for it)
+    if (klen > lookahead) lookahead = klen;
+  }
+  return lookahead;
+}
+
+// -----------------------------------------------------------------------------
+// re-highlights a row after the display characters from editStart up to editEnd changed, restarting the lexer at the last safe place 
+// before the edit instead of at the beginning of the row
+void editorUpdateSyntaxAround(textRow *row, int64_t editStart, int64_t editEnd) {
+  if (Text.syntax == NULL) return;
+
+  int64_t i = editStart - syntaxLookahead() + 1;  // anything before this cannot have looked as far as the edit
+  if (i > editStart) i = editStart;
+  if (i < 0) i = 0;
+  while (i > 0 && row->textColor[i - 1] != HL_NORMAL) i--;  // back up to just after an HL_NORMAL character, or to the beginning of the row
+  editorUpdateSyntaxFrom(row, i, editEnd);
+}
+
 
 // -----------------------------------------------------------------------------
 // we loop through each syntaxInfo struct in the syntaxDatabase array, and for each one of those, we loop through each pattern in its filematch 
@@ -522,7 +1458,10 @@ void editorSelectSyntaxHighlight() {
   Text.syntax = NULL;  // set Text.syntax to NULL, so that if nothing matches or if there is no filename, then there is no filetype
   if (Text.filename == NULL) return;
 
-  char *ext = strrchr(Text.filename, '.');  // ext = extension - strrchr() returns a pointer to the last occurrence of a character in a string (so we can look at just the file extention) - if there is no extension, then ext will be NULL
+  size_t stem;
+  compressionOfName(Text.filename, &stem);  // a compressed file is matched by the name it has without .gz or .zst
+  char *name = strndup(Text.filename, stem);
+  char *ext = strrchr(name, '.');  // ext = extension - strrchr() returns a pointer to the last occurrence of a character in a string (so we can look at just the file extention) - if there is no extension, then ext will be NULL
 
   for (unsigned int j = 0; j <DATABASE_ENTRIES; j++) {  // loop  through each syntaxInfo struct in the syntaxDatabase array
     syntaxInfo *s = &syntaxDatabase[j];
@@ -530,12 +1469,15 @@ void editorSelectSyntaxHighlight() {
     while (s->filematch[i]) {  // loop through each pattern in its filematch array
       int is_ext = (s->filematch[i][0] == '.');
       if ((is_ext && ext && !strcmp(ext, s->filematch[i])) ||   // strcmp() returns 0 if two given strings are equal
-          (!is_ext && strstr(Text.filename, s->filematch[i]))) { 
+          (!is_ext && strstr(name, s->filematch[i]))) { 
         Text.syntax = s;
+        free(name);
 
-        int filtextRow;
-        for (filtextRow = 0; filtextRow < Text.totalRows; filtextRow++) {
-          editorUpdateSyntax(&Text.row[filtextRow]);
+        for (piece *p = pieceFirst(); p; p = pieceNext(p)) {  // walk the pieces in text order rather than looking up each row
+          for (int64_t k = 0; k < p->count; k++) {
+            textRow *row = madeRow(p->source, p->start + k);
+            if (row) editorUpdateSyntax(row);  // rows not made yet are highlighted when they are
+          }
         }
 
         return;
@@ -543,6 +1485,7 @@ void editorSelectSyntaxHighlight() {
       i++;
     }
   }
+  free(name);
 }
 
 /*** row operations ***/
@@ -555,13 +1498,85 @@ void editorSelectSyntaxHighlight() {
 // 888  T88b  Y88b. .d88P 8888P   Y8888      Y88b. .d88P 888        888        888  T88b   d8888888888     888       888  Y88b. .d88P 888   Y8888 Y88b  d88P 
 // 888   T88b  "Y88888P"  888P     Y888       "Y88888P"  888        8888888888 888   T88b d88P     888     888     8888888 "Y88888P"  888    Y888  "Y8888P" 
 
+// -----------------------------------------------------------------------------
+// the quantity of unused bytes in the gap of a row's characters array
+int64_t rowGapLength(textRow *row) {
+  return row->capacity - 1 - row->length;  // one byte is always kept back for the null byte
+}
+
+// -----------------------------------------------------------------------------
+// returns the character at index at of a row, skipping over the gap
+char rowCharAt(textRow *row, int64_t at) {
+  return row->characters[at < row->gapStart ? at : at + rowGapLength(row)];
+}
+
+// -----------------------------------------------------------------------------
+// moves the gap so that it starts at index at - only the characters between the old and new gap positions are moved
+void rowMoveGap(textRow *row, int64_t at) {
+  int64_t gap = rowGapLength(row);
+  if (at < row->gapStart) {  // move the characters between at and the gap to the other side of the gap
+    memmove(&row->characters[at + gap], &row->characters[at], row->gapStart - at);
+  } else if (at > row->gapStart) {  // move the characters between the gap and at to the front of the gap
+    memmove(&row->characters[row->gapStart], &row->characters[row->gapStart + gap], at - row->gapStart);
+  }
+  row->gapStart = at;
+}
+
+// -----------------------------------------------------------------------------
+// makes sure the gap can hold at least extra more characters - the array at least doubles each time it grows, so a long run of typing 
+// only reallocates O(log n) times. A huge row grows by at most ROW_MAX_GAP at a time instead, so typing into a line of several
+// gigabytes doesn't double its memory.
+void rowReserve(textRow *row, int64_t extra) {
+  if (rowGapLength(row) >= extra) return;
+
+  int64_t oldCapacity = row->capacity;
+  int64_t tail = row->length - row->gapStart;  // the quantity of characters after the gap
+  int64_t capacity = oldCapacity + (oldCapacity < ROW_MAX_GAP ? oldCapacity : ROW_MAX_GAP);
+  if (capacity < row->length + extra + 1) capacity = row->length + extra + 1;
+  if (capacity < 16) capacity = 16;
+
+  row->characters = rowAllocate(row, ARENA_CHARACTERS, row->characters, oldCapacity, capacity);
+  memmove(&row->characters[capacity - 1 - tail], &row->characters[oldCapacity - 1 - tail], tail);  // keep the characters after the gap at the end of the array
+  row->characters[capacity - 1] = '\0';
+  row->capacity = capacity;
+}
+
+// -----------------------------------------------------------------------------
+// puts character c at index at of a row's characters - the gap moves to just after the new character, so the next character typed 
+// goes straight into the gap
+void rowGapInsert(textRow *row, int64_t at, int c) {
+  rowReserve(row, 1);  // make sure there is room in the gap for one more character
+  rowMoveGap(row, at);  // move the gap to at - when typing, the gap is already there, so nothing moves
+  row->characters[row->gapStart++] = c;  // put the character at the front of the gap
+  row->length++;
+}
+
+// -----------------------------------------------------------------------------
+// removes the character at index at of a row's characters by widening the gap over it
+void rowGapDelete(textRow *row, int64_t at) {
+  rowMoveGap(row, at + 1);  // move the gap to just after the character - backspacing where the gap already is moves nothing
+  row->gapStart--;
+  row->length--;
+}
+
+// -----------------------------------------------------------------------------
+// closes the gap by moving it to the end of the row and returns the characters as one null terminated string - use this whenever 
+// something needs all of a row's characters in one piece
+char *editorRowText(textRow *row) {
+  rowMoveGap(row, row->length);
+  char *end = &row->characters[row->length];
+  if (!(row->memory & MAPPED) || (*end != '\n' && *end != '\r' && *end != '\0'))  // a row still in a mapped file ends at its newline, which
+    *end = '\0';                                                                    // does just as well - writing there would copy the page
+  return row->characters;
+}
+
 // -----------------------------------------------------------------------------
 // converts a characters index into a display index
-int convertToDisplayIndex(textRow *row, int cursorXPosition) {
-  int displayXPosition = 0;
-  int j;
+int64_t convertToDisplayIndex(textRow *row, int64_t cursorXPosition) {
+  int64_t displayXPosition = 0;
+  int64_t j;
   for (j = 0; j < cursorXPosition; j++) {
-    if (row->characters[j] == '\t')
+    if (rowCharAt(row, j) == '\t')
       displayXPosition += (TAB_WIDTH - 1) - (displayXPosition % TAB_WIDTH);
     displayXPosition++;
   }
@@ -571,11 +1586,11 @@ int convertToDisplayIndex(textRow *row, int cursorXPosition) {
 // -----------------------------------------------------------------------------
 // converts a display index into a characters index
 // To convert an displayXPosition into a cursorXPosition, we do pretty much the same thing when converting the other way: loop through the characters string, calculating the current displayXPosition value (cur_displayXPosition) as we go. But instead of stopping when we hit a particular cursorXPosition value and returning cur_displayXPosition, we want to stop when cur_displayXPosition hits the given displayXPosition value and return cursorXPosition
-int convertToCharactersIndex(textRow *row, int displayXPosition) {
-  int cur_displayXPosition = 0;
-  int cursorXPosition;
+int64_t convertToCharactersIndex(textRow *row, int64_t displayXPosition) {
+  int64_t cur_displayXPosition = 0;
+  int64_t cursorXPosition;
   for (cursorXPosition = 0; cursorXPosition < row->length; cursorXPosition++) {
-    if (row->characters[cursorXPosition] == '\t')
+    if (rowCharAt(row, cursorXPosition) == '\t')
       cur_displayXPosition += (TAB_WIDTH - 1) - (cur_displayXPosition % TAB_WIDTH);
     cur_displayXPosition++;
 
@@ -584,114 +1599,568 @@ int convertToCharactersIndex(textRow *row, int displayXPosition) {
   return cursorXPosition;  // just in case the caller provided an displayXPosition that’s out of range, which shouldn’t happen
 }
 
+// -----------------------------------------------------------------------------
+// returns the capacity a buffer should grow to so it holds at least need bytes - buffers grow geometrically once a row is being 
+// edited, but a row that has only been loaded gets exactly the room it needs
+int64_t growCapacity(int64_t capacity, int64_t need) {
+  if (need <= capacity) return capacity;
+  capacity = capacity ? capacity * 2 : need;
+  if (capacity < need) capacity = need;
+  return capacity;
+}
+
+// -----------------------------------------------------------------------------
+// makes sure a row has a display of its own with room for length characters and a null byte
+void editorReserveDisplay(textRow *row, int64_t length) {
+  if (length + 1 <= row->displayCapacity) return;
+  char *own = row->displayCapacity ? row->display : NULL;  // a display that points at the characters is not ours to realloc()
+  row->displayCapacity = growCapacity(row->displayCapacity, length + 1);
+  row->display = rowAllocate(row, ARENA_DISPLAY, own, row->displayLength + 1, row->displayCapacity);
+}
+
+// -----------------------------------------------------------------------------
+// makes sure textColor has room for the colors of length characters
+void editorReserveColor(textRow *row, int64_t length) {
+  if (length + 1 <= row->colorCapacity) return;  // + 1 so a row with no characters still gets an array
+  int64_t oldCapacity = row->colorCapacity;
+  row->colorCapacity = growCapacity(row->colorCapacity, length + 1);
+  row->textColor = rowAllocate(row, ARENA_COLORS, row->textColor, oldCapacity, row->colorCapacity);
+}
+
+// -----------------------------------------------------------------------------
+// gives a row whose display points at its characters a copy of its own - needed before an edit moves the gap into the middle 
+// of the characters, since display has to stay one contiguous string
+void editorDetachDisplay(textRow *row) {
+  char *view = row->display;
+  editorReserveDisplay(row, row->displayLength);
+  memcpy(row->display, view, row->displayLength);
+  row->display[row->displayLength] = '\0';
+}
+
+// -----------------------------------------------------------------------------
+// splices character c into the display and textColor of a row just after it was put at index at of the characters - only used when
+// there is no tab at or after at, so every character after it simply moves one place to the right
+void editorDisplayInsertChar(textRow *row, int64_t at, int c) {
+  int64_t dx = at + (row->displayLength - (row->length - 1));  // all the tabs come before at, so display is ahead of characters by a fixed amount
+  if (row->displayCapacity == 0) {  // display points at the characters, which already hold c - the gap is still at the end of the row,
+    row->display = editorRowText(row);  // so this only puts back the null byte (and picks up the characters if they were moved by realloc())
+  } else {
+    editorReserveDisplay(row, row->displayLength + 1);
+    memmove(&row->display[dx + 1], &row->display[dx], row->displayLength - dx + 1);  // + 1 to move the null byte too
+    row->display[dx] = c;
+  }
+  row->displayLength++;
+  if (row->textColor) {
+    editorReserveColor(row, row->displayLength);
+    memmove(&row->textColor[dx + 1], &row->textColor[dx], row->displayLength - dx - 1);
+    row->textColor[dx] = HL_NORMAL;
+  }
+  editorUpdateSyntaxAround(row, dx, dx + 1);
+}
+
+// -----------------------------------------------------------------------------
+// splices the character that was at index at of the characters out of the display and textColor of a row - only used when the deleted 
+// character was not a tab and there is no tab after it
+void editorDisplayDelChar(textRow *row, int64_t at) {
+  int64_t dx = at + (row->displayLength - (row->length + 1));
+  if (row->displayCapacity == 0) row->display = editorRowText(row);  // display points at the characters, which no longer hold it
+  else memmove(&row->display[dx], &row->display[dx + 1], row->displayLength - dx);  // includes the null byte
+  row->displayLength--;
+  if (row->textColor) memmove(&row->textColor[dx], &row->textColor[dx + 1], row->displayLength - dx);
+  editorUpdateSyntaxAround(row, dx, dx);
+}
+
 // -----------------------------------------------------------------------------
 // uses the characters string of an textRow to fill in the contents of the display string - copy each character from characters to display
-void editorUpdateRow(textRow *row) {
-  int tabs = 0;
-  int j;
-  for (j = 0; j < row->length; j++)
-    if (row->characters[j] == '\t') tabs++;
-
-  free(row->display);
-  row->display = malloc(row->length + tabs*(TAB_WIDTH - 1) + 1);
-
-  int idx = 0;
-  for (j = 0; j < row->length; j++) {
-    if (row->characters[j] == '\t') {
-      row->display[idx++] = ' ';
-      while (idx % TAB_WIDTH != 0) row->display[idx++] = ' ';
-    } else {
-      row->display[idx++] = row->characters[j];
+void editorUpdateDisplay(textRow *row) {
+  char *span[2] = { row->characters, &row->characters[row->gapStart + rowGapLength(row)] };  // the characters before and after the gap
+  int64_t spanLength[2] = { row->gapStart, row->length - row->gapStart };
+  int64_t tabs = 0;
+  int64_t j;
+  int k;
+  row->lastTab = -1;
+  for (k = 0; k < 2; k++)
+    for (j = 0; j < spanLength[k]; j++)
+      if (span[k][j] == '\t') {
+        tabs++;
+        row->lastTab = (k == 0) ? j : row->gapStart + j;
+      }
+
+  if (tabs == 0) {  // nothing to expand - display can simply point at the characters
+    if (row->displayCapacity) rowRelease(row, ARENA_DISPLAY, row->display);
+    row->displayCapacity = 0;
+    row->display = editorRowText(row);
+    row->displayLength = row->length;
+    return;
+  }
+
+  editorReserveDisplay(row, row->length + tabs*(TAB_WIDTH - 1));
+
+  int64_t idx = 0;
+  for (k = 0; k < 2; k++) {
+    for (j = 0; j < spanLength[k]; j++) {
+      if (span[k][j] == '\t') {
+        row->display[idx++] = ' ';
+        while (idx % TAB_WIDTH != 0) row->display[idx++] = ' ';
+      } else {
+        row->display[idx++] = span[k][j];
+      }
     }
   }
   row->display[idx] = '\0';
   row->displayLength = idx;
+}
 
+// -----------------------------------------------------------------------------
+// brings the display and the highlighting of a row up to date with its characters
+void editorUpdateRow(textRow *row) {
+  editorUpdateDisplay(row);
   editorUpdateSyntax(row);
 }
 
 // -----------------------------------------------------------------------------
-// allocates memory space for a new textRow, make space at any position in the Text.row array, then copies the given string to it 
-void editorInsertRow(int at, char *s, size_t len) {
-  if (at < 0 || at > Text.totalRows) return;  // validate at index is within range
-
-  Text.row = realloc(Text.row, sizeof(textRow) * (Text.totalRows + 1));  // allocate memory for a new row
-  memmove(&Text.row[at + 1], &Text.row[at], sizeof(textRow) * (Text.totalRows - at)); // shift all rows after the index at down by one to make room for new row at at
-  for (int j = at + 1; j <= Text.totalRows; j++) Text.row[j].index++;  // update the idx of each row after the inserted row whenever a row is inserted into a file
-
-  Text.row[at].index = at;  // initialize idx to the row’s index in the file at the time it is inserted
+// fills in a row that has just been taken from one of the piece table buffers and given len characters, with a byte after them
+void editorSetupRow(textRow *row, char *characters, size_t len) {
+  row->characters = characters;
+  row->length = len;
+  row->capacity = len + 1;  // no gap to start with - most rows are never edited, so they should not carry any spare room
+  row->gapStart = len;
+  row->lastTab = -1;
+  row->displayLength = 0;
+  row->displayCapacity = 0;
+  row->colorCapacity = 0;
+  row->display = NULL;
+  row->textColor = NULL;
+  row->commentLeftOpen = false;  // should be false
+}
 
-  Text.row[at].length = len;
-  Text.row[at].characters = malloc(len + 1);
-  memcpy(Text.row[at].characters, s, len);
-  Text.row[at].characters[len] = '\0';
+// -----------------------------------------------------------------------------
+// copies the given string into a row that has just been taken from one of the piece table buffers
+void editorInitRow(textRow *row, char *s, size_t len) {
+  row->memory = Text.arena.open ? ARENA_ONLY : 0;
+  char *characters = rowAllocate(row, ARENA_CHARACTERS, NULL, 0, len + 1);
+  memcpy(characters, s, len);
+  characters[len] = '\0';
+  editorSetupRow(row, characters, len);
+}
 
-  Text.row[at].displayLength = 0;
-  Text.row[at].display = NULL;
-  Text.row[at].textColor = NULL;
-  Text.row[at].commentLeftOpen = false;  // should be false
-  editorUpdateRow(&Text.row[at]);
+// -----------------------------------------------------------------------------
+// makes the row for a line of a mapped file the first time something looks at it - p is the piece holding its slot and at is its 
+// position in the text. The row's characters point into the mapping, so nothing is copied unless the row is edited.
+textRow *editorMakeRow(piece *p, int64_t slot, int64_t at) {
+  if (Text.syntax && Text.syntax->blockCommentStart) {  // whether the row starts in a comment depends on the rows before it, so they 
+    int64_t k = at;                                      // are made first - the rows made always run from the top of the text
+    while (k > 0 && editorRowIfMade(k - 1) == NULL) k--;
+    for (; k < at; k++) editorRowAt(k);
+  }
 
-  Text.totalRows++;
-  Text.modified = true;  // why not just set it to true? - and then set to false when save file
+  char *text;
+  int64_t length;
+  editorLineSpan(slot, &text, &length);
+  textRow *row = bufferRow(ORIGINAL_BUFFER, slot);
+  row->owner = p;
+  row->slot = slot;
+  row->memory = ARENA_CHARACTERS | MAPPED;  // not ours to realloc() or free(), like a row in the arena
+  editorSetupRow(row, text, length);
+  editorUpdateDisplay(row);
+
+  if (Text.syntax) {
+    textRow *previous = (at > 0) ? editorRowIfMade(at - 1) : NULL;
+    editorReserveColor(row, row->displayLength);
+    memset(row->textColor, HL_NORMAL, row->displayLength);
+    editorHighlightRow(row, 0, row->displayLength, previous && previous->commentLeftOpen);  // the rows after it are made later, so there is nothing to update
+  }
+  return row;
 }
 
 // -----------------------------------------------------------------------------
-//  frees memory owned by a row
-void editorFreeRow(textRow *row) {
-  free(row->display);
-  free(row->characters);
-  free(row->textColor);
+// puts a new row holding a copy of the given string at position at, without counting that as an edit - editorInsertRow() does that
+void editorPlaceRow(int64_t at, char *s, size_t len) {
+  int64_t slot = addBufferNewRow();  // rows are never moved once created, so no other row has to be touched
+  textRow *row = bufferRow(ADD_BUFFER, slot);
+  editorInitRow(row, s, len);
+  pieceTableInsert(at, ADD_BUFFER, slot);
+  Text.totalRows++;  // counted first, so highlighting it can carry on into the row after it
+  editorUpdateRow(row);
 }
 
 // -----------------------------------------------------------------------------
-// editorDelRow() looks a lot like editorRowDelChar(), because in both cases we are deleting a single element from an array of elements by its index.
-void editorDelRow(int at) {
-  if (at < 0 || at >= Text.totalRows) return;  // validate at index
-  editorFreeRow(&Text.row[at]);  // free the memory owned by the row using editorFreeRow()
-  memmove(&Text.row[at], &Text.row[at + 1], sizeof(textRow) * (Text.totalRows - at - 1));  // use memmove() to overwrite the deleted row struct with the rest of the rows that come after it
-  for (int j = at; j <= Text.totalRows - 1; j++) Text.row[j].index--;  // update the index of each row after the deleted row whenever a row is deleted from a file
-  Text.totalRows--;  
+// allocates memory space for a new textRow at the end of the add buffer, places it at any position in the text, then copies the given string to it 
+void editorInsertRow(int64_t at, char *s, size_t len) {
+  if (at < 0 || at > Text.totalRows) return;  // validate at index is within range
+
+  editorPlaceRow(at, s, len);
   Text.modified = true;
+  Text.version++;  // why not just set it to true? - and then set to false when save file
+  editorMarkDirty(at);
+  journalRecord(JOURNAL_INSERT_ROW, at, 0, s, len);
 }
 
 // -----------------------------------------------------------------------------
-// textRow *row - pointer to an textRow struct
-// int at - the index at which we want to insert the character (index to insert 'at'???)
-// int c - new character to insert
-void editorRowInsertChar(textRow *row, int at, int c) {
-  if (at < 0 || at > row->length) at = row->length;  // validate at - Notice that at is allowed to go one character past the end of the string, in which case the character should be inserted at the end of the string.
-  row->characters = realloc(row->characters, row->length + 2);  // Then we allocate one more byte for the characters of the textRow (we add 2 because we also have to make room for the null byte)
-  memmove(&row->characters[at + 1], &row->characters[at], row->length - at + 1);  // use memmove() to make room for the new character. move everything from index at to the end of the string over one character leaving a "hole" at index at.  memmove() comes from <string.h>. It is like memcpy(), but is safe to use when the source and destination arrays overlap.
-  row->length++;  // increment the size of the characters array, 
-  row->characters[at] = c;  // assign the character to its position in the array
-  editorUpdateRow(row);  // call editorUpdateRow() so that the display and rsize fields get updated with the new row content.
-  Text.modified = true;  // why not just set it to true? - and then set to false when save file
+// makes room in an index for at least extra more newlines, doubling its room as many times as that takes
+void newlineReserve(newlineIndex *index, int64_t extra) {
+  if (index->count + extra <= index->capacity) return;
+  while (index->count + extra > index->capacity) index->capacity = index->capacity ? index->capacity * 2 : 1024;
+  index->offsets = realloc(index->offsets, sizeof(int64_t) * index->capacity);
 }
 
 // -----------------------------------------------------------------------------
-// appends a string to the end of a row
-void editorRowAppendString(textRow *row, char *s, size_t len) {
-  row->characters = realloc(row->characters, row->length + len + 1);  // The row’s new size is row->length + len + 1 (including the null byte), so first we allocate that much memory for row->characters
-  memcpy(&row->characters[row->length], s, len);
-  row->length += len;
-  row->characters[row->length] = '\0';
-  editorUpdateRow(row);
-  Text.modified = true;
+// adds a newline for each bit set in mask, the result of comparing the bytes starting at offset with '\n' - bit n is the byte at 
+// offset + n
+void newlineAddMask(newlineIndex *index, unsigned int mask, int64_t offset) {
+  if (mask == 0) return;  // most blocks of bytes have no newline in them
+  newlineReserve(index, 32);
+  int64_t *end = &index->offsets[index->count];
+  while (mask) {
+    *end++ = offset + __builtin_ctz(mask);
+    mask &= mask - 1;  // clear the lowest bit set
+  }
+  index->count = end - index->offsets;
 }
 
 // -----------------------------------------------------------------------------
-// textRow *row - pointer to an textRow struct
-// int at - the index at which we want to insert the character (index to insert 'at'???)
-void editorRowDelChar(textRow *row, int at) {
-  if (at < 0 || at >= row->length) return;
-  memmove(&row->characters[at], &row->characters[at + 1], row->length - at);
-  row->length--;
-  editorUpdateRow(row);
-  Text.modified = true;
+// adds the offset of every newline in text[from] to text[to - 1] to an index, one memchr() at a time - works everywhere
+void scanNewlinesScalar(const char *text, size_t from, size_t to, newlineIndex *index) {
+  const char *p = &text[from];
+  while ((p = memchr(p, '\n', &text[to] - p)) != NULL) {
+    newlineReserve(index, 1);
+    index->offsets[index->count++] = p - text;
+    p++;
+  }
 }
 
-/*** editor operations ***/  // This section will contain functions that we’ll call from editorProcessKeypress() when we’re mapping keypresses to various text editing operations
+#if defined(__x86_64__) || defined(__i386__)
+// -----------------------------------------------------------------------------
+// scanNewlinesScalar(), comparing 16 bytes at a time with SSE2 and turning the result into a bitmask with movemask
+__attribute__((target("sse2")))
+void scanNewlinesSSE2(const char *text, size_t from, size_t to, newlineIndex *index) {
+  __m128i newline = _mm_set1_epi8('\n');
+  size_t j = from;
+  for (; j + 16 <= to; j += 16) {
+    __m128i bytes = _mm_loadu_si128((const __m128i *)&text[j]);
+    newlineAddMask(index, _mm_movemask_epi8(_mm_cmpeq_epi8(bytes, newline)), j);
+  }
+  scanNewlinesScalar(text, j, to, index);  // the last few bytes
+}
+
+// -----------------------------------------------------------------------------
+// scanNewlinesScalar(), comparing 32 bytes at a time with AVX2 - only called when the CPU has it (see scanNewlines())
+__attribute__((target("avx2")))
+void scanNewlinesAVX2(const char *text, size_t from, size_t to, newlineIndex *index) {
+  __m256i newline = _mm256_set1_epi8('\n');
+  size_t j = from;
+  for (; j + 32 <= to; j += 32) {
+    __m256i bytes = _mm256_loadu_si256((const __m256i *)&text[j]);
+    newlineAddMask(index, (unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, newline)), j);
+  }
+  scanNewlinesScalar(text, j, to, index);
+}
+#endif
+
+// -----------------------------------------------------------------------------
+// adds the offset of every newline in text[from] to text[to - 1] to an index, with the widest compare the CPU has
+void scanNewlines(const char *text, size_t from, size_t to, newlineIndex *index) {
+#if defined(__x86_64__) || defined(__i386__)
+  if (__builtin_cpu_supports("avx2")) scanNewlinesAVX2(text, from, to, index);
+  else if (__builtin_cpu_supports("sse2")) scanNewlinesSSE2(text, from, to, index);
+  else scanNewlinesScalar(text, from, to, index);
+#else
+  scanNewlinesScalar(text, from, to, index);
+#endif
+}
+
+// -----------------------------------------------------------------------------
+// returns the quantity of threads indexNewlines() splits long text between
+int newlineThreads() {
+  long threads = sysconf(_SC_NPROCESSORS_ONLN);
+  if (threads < 1) return 1;
+  return threads < INDEX_MAX_THREADS ? (int)threads : INDEX_MAX_THREADS;
+}
+
+typedef struct newlineChunk {  // one thread's share of the text indexNewlines() searches
+  const char *text;
+  size_t from, to;
+  newlineIndex found;  // the newlines in the chunk - merged into the caller's index once every thread is done
+} newlineChunk;
+
+// -----------------------------------------------------------------------------
+// the function each of indexNewlines()'s threads runs
+void *newlineChunkScan(void *argument) {
+  newlineChunk *chunk = argument;
+  scanNewlines(chunk->text, chunk->from, chunk->to, &chunk->found);
+  return NULL;
+}
+
+// -----------------------------------------------------------------------------
+// adds the offset of every newline in text[from] to text[to - 1] to an index, in order. Long text is cut into one chunk per CPU and 
+// the chunks are searched at the same time, then their offsets are copied into the index one after another.
+void indexNewlines(const char *text, size_t from, size_t to, newlineIndex *index) {
+  int threads = newlineThreads();
+  if (to - from < INDEX_THREAD_SIZE || threads < 2) {
+    scanNewlines(text, from, to, index);
+    return;
+  }
+
+  newlineChunk chunks[INDEX_MAX_THREADS];
+  pthread_t workers[INDEX_MAX_THREADS];
+  bool started[INDEX_MAX_THREADS];
+  for (int t = 0; t < threads; t++) {
+    chunks[t] = (newlineChunk){ text, from + (to - from) * t / threads, from + (to - from) * (t + 1) / threads, { NULL, 0, 0 } };
+    started[t] = (pthread_create(&workers[t], NULL, newlineChunkScan, &chunks[t]) == 0);
+    if (!started[t]) newlineChunkScan(&chunks[t]);  // no thread to be had - search the chunk here instead
+  }
+
+  for (int t = 0; t < threads; t++) {
+    if (started[t]) pthread_join(workers[t], NULL);
+    newlineIndex *found = &chunks[t].found;
+    newlineReserve(index, found->count);
+    if (found->count) memcpy(&index->offsets[index->count], found->offsets, sizeof(int64_t) * found->count);
+    index->count += found->count;
+    free(found->offsets);
+  }
+}
+
+// -----------------------------------------------------------------------------
+// a hash of a line, taken 8 bytes at a time - only used to tell lines apart, so it just has to be fast and mix well
+uint64_t chunkHashLine(const char *text, int64_t length) {
+  uint64_t hash = 0x9E3779B97F4A7C15ULL ^ (uint64_t)length;
+  int64_t j = 0;
+  for (; j + 8 <= length; j += 8) {
+    uint64_t word;
+    memcpy(&word, &text[j], 8);
+    hash = (hash ^ word) * 0xFF51AFD7ED558CCDULL;
+    hash ^= hash >> 32;
+  }
+  uint64_t word = 0;
+  memcpy(&word, &text[j], length - j);
+  hash = (hash ^ word) * 0xC4CEB9FE1A85EC53ULL;
+  return hash ^ (hash >> 29);
+}
+
+// -----------------------------------------------------------------------------
+// puts the chunk being added to on the list, if it has any lines
+void chunkFinish(chunkList *list) {
+  if (list->rows == 0) return;
+  if (list->count == list->capacity) {
+    list->capacity = list->capacity ? list->capacity * 2 : 64;
+    list->chunks = realloc(list->chunks, sizeof(textChunk) * list->capacity);
+  }
+  list->chunks[list->count++] = (textChunk){ list->hash, list->start, list->rows };
+  list->start += list->rows;
+  list->hash = 0;
+  list->rows = list->bytes = 0;
+}
+
+// -----------------------------------------------------------------------------
+// adds the next line of a file to the chunk being built from it. The chunk ends after a line whose own hash says so, rather than 
+// after a set quantity of lines or bytes, so a line added or taken out only changes the chunk it is in - the chunks after it are cut
+// just where they were before, and still match.
+void chunkAddLine(chunkList *list, const char *text, int64_t length) {
+  uint64_t line = chunkHashLine(text, length);
+  list->hash = ((list->hash << 7) | (list->hash >> 57)) ^ line;
+  list->rows++;
+  list->bytes += length + 1;
+  if ((list->rows >= RELOAD_CHUNK_MIN && (line & (RELOAD_CHUNK_LINES - 1)) == 0) || list->bytes >= RELOAD_CHUNK_BYTES) chunkFinish(list);
+}
+
+// -----------------------------------------------------------------------------
+// frees a list of chunks, leaving it empty
+void chunkFree(chunkList *list) {
+  free(list->chunks);
+  memset(list, 0, sizeof(*list));
+}
+
+// -----------------------------------------------------------------------------
+// appends every line of text to the end of the text in one call - the rows go into the buffer source (the original buffer, and while 
+// a file is being loaded the arena, or the add buffer for lines that turn up later, see editorFollowRead()) and are highlighted 
+// together in a single pass at the end. Returns the quantity of bytes used: a last line with no newline after it is left for the next
+// call, unless atEnd says no more text is coming.
+size_t editorAppendRows(char *text, size_t length, bool atEnd, int source) {
+  int64_t first = Text.totalRows;
+  int64_t start = (source == ORIGINAL_BUFFER) ? Text.rows.originalRows : Text.rows.addRows;
+  size_t used = 0;
+  newlineIndex newlines = { NULL, 0, 0 };
+  indexNewlines(text, 0, length, &newlines);  // find every line end first, then make the rows
+  for (int64_t j = 0; j <= newlines.count && used < length; j++) {
+    if (j == newlines.count && !atEnd) break;  // the last line has no newline after it yet
+    size_t end = (j < newlines.count) ? (size_t)newlines.offsets[j] : length;
+    size_t linelen = end - used;
+    while (linelen > 0 && text[used + linelen - 1] == '\r') {
+      linelen--;
+      Text.carriageReturns = true;
+    }
+
+    int64_t slot = (source == ORIGINAL_BUFFER) ? originalBufferNewRow() : addBufferNewRow();
+    textRow *row = bufferRow(source, slot);
+    editorInitRow(row, &text[used], linelen);
+    editorUpdateDisplay(row);
+    if (source == ORIGINAL_BUFFER) chunkAddLine(&Text.reload.loaded, &text[used], linelen);  // for editorReload()
+    used = (j < newlines.count) ? end + 1 : length;
+  }
+  free(newlines.offsets);
+
+  int64_t count = ((source == ORIGINAL_BUFFER) ? Text.rows.originalRows : Text.rows.addRows) - start;
+  pieceTableAppend(source, start, count);
+  Text.totalRows += count;
+  editorHighlightRows(first);
+  return used;
+}
+
+// -----------------------------------------------------------------------------
+//  frees memory owned by a row
+void editorFreeRow(textRow *row) {
+  if (row->displayCapacity) rowRelease(row, ARENA_DISPLAY, row->display);  // otherwise display points at the characters
+  rowRelease(row, ARENA_CHARACTERS, row->characters);
+  rowRelease(row, ARENA_COLORS, row->textColor);
+  row->characters = row->display = NULL;  // so freeing the row again when the file is closed does nothing
+  row->textColor = NULL;
+  row->displayCapacity = 0;
+  row->colorCapacity = 0;
+}
+
+// -----------------------------------------------------------------------------
+// notes that the text from position at onwards may no longer match the file, so the next save has to rewrite at least that much of it
+void editorMarkDirty(int64_t at) {
+  if (at < Text.dirtyFrom) Text.dirtyFrom = at;
+  if (at < Text.reload.changedFrom) Text.reload.changedFrom = at;
+  if (at >= Text.totalRows - 1) Text.follow.touched = true;  // the unfinished line of a followed file, or a row added after it
+}
+
+// -----------------------------------------------------------------------------
+// true if the save running in the background still has to write the row in a slot of one of the piece table buffers, so the row 
+// mustn't be changed or freed
+bool saveHolds(int source, int64_t slot) {
+  if (!Text.save.running) return false;
+  return slot < (source == ORIGINAL_BUFFER ? Text.save.originalRows : Text.save.addRows);
+}
+
+// -----------------------------------------------------------------------------
+// hands a row that has been taken out of the text to the running save, which frees it once it has been written
+void saveRetire(textRow *row) {
+  if (Text.save.retiredCount == Text.save.retiredCapacity) {
+    Text.save.retiredCapacity = Text.save.retiredCapacity ? Text.save.retiredCapacity * 2 : 64;
+    Text.save.retired = realloc(Text.save.retired, sizeof(textRow *) * Text.save.retiredCapacity);
+  }
+  Text.save.retired[Text.save.retiredCount++] = row;
+}
+
+// -----------------------------------------------------------------------------
+// returns the row at position at in the text, ready to be edited. While a save is running, a row it still has to write is copied into
+// the add buffer first and the copy takes its place in the text - the save goes on writing the old row, which nothing touches again.
+textRow *editorRowForEdit(int64_t at) {
+  int64_t slot;
+  piece *p = pieceAt(at, &slot);
+  textRow *row = editorRowAt(at);
+  if (!saveHolds(p->source, slot)) return row;
+
+  int64_t copySlot = addBufferNewRow();
+  textRow *copy = bufferRow(ADD_BUFFER, copySlot);
+  editorInitRow(copy, row->characters, row->gapStart);  // the characters before the gap, then the ones after it - without moving
+  int64_t after = row->length - row->gapStart;           // the gap, which would change the row under the save
+  if (after > 0) {
+    rowReserve(copy, after);
+    memcpy(&copy->characters[copy->gapStart], &row->characters[row->gapStart + rowGapLength(row)], after);
+    copy->gapStart += after;
+    copy->length += after;
+  }
+  pieceTableRemove(at);
+  pieceTableInsert(at, ADD_BUFFER, copySlot);
+  editorUpdateRow(copy);
+  saveRetire(row);
+  return copy;
+}
+
+// -----------------------------------------------------------------------------
+// takes the row at position at out of the text and frees it, without counting that as an edit - editorDelRow() does that
+void editorRemoveRow(int64_t at) {
+  int64_t slot;
+  piece *p = pieceAt(at, &slot);
+  textRow *row = madeRow(p->source, slot);  // a line of a mapped file that was never made has nothing to free
+  if (row && saveHolds(p->source, slot)) saveRetire(row);  // the running save still needs it - it is freed once it has been written
+  else if (row) editorFreeRow(row);  // free the memory owned by the row using editorFreeRow()
+  pieceTableRemove(at);  // take the row out of the piece table - its slot in the buffer is simply never used again
+  Text.totalRows--;  
+}
+
+// -----------------------------------------------------------------------------
+// editorDelRow() looks a lot like editorRowDelChar(), because in both cases we are deleting a single element from an array of elements by its index.
+void editorDelRow(int64_t at) {
+  if (at < 0 || at >= Text.totalRows) return;  // validate at index
+  editorRemoveRow(at);
+  Text.modified = true;
+  Text.version++;
+  editorMarkDirty(at);
+  journalRecord(JOURNAL_DELETE_ROW, at, 0, NULL, 0);
+}
+
+// -----------------------------------------------------------------------------
+// textRow *row - pointer to an textRow struct
+// int64_t at - the index at which we want to insert the character (index to insert 'at'???)
+// int c - new character to insert
+void editorRowInsertChar(textRow *row, int64_t at, int c) {
+  if (at < 0 || at > row->length) at = row->length;  // validate at - Notice that at is allowed to go one character past the end of the string, in which case the character should be inserted at the end of the string.
+  bool splice = (c != '\t' && at > row->lastTab);  // no tabs need re-expanding, so the display can be patched in place
+  if (splice && row->displayCapacity == 0 && at != row->length) editorDetachDisplay(row);  // the gap is about to move away from the end of the row
+  rowGapInsert(row, at, c);  // put the character into the row's gap buffer
+  if (splice) editorDisplayInsertChar(row, at, c);
+  else editorUpdateRow(row);  // call editorUpdateRow() so that the display and rsize fields get updated with the new row content.
+  Text.modified = true;
+  Text.version++;  // why not just set it to true? - and then set to false when save file
+  int64_t position = editorRowIndex(row);
+  char character = c;
+  editorMarkDirty(position);
+  journalRecord(JOURNAL_INSERT_CHAR, position, at, &character, 1);
+}
+
+// -----------------------------------------------------------------------------
+// appends a string to the end of a row
+void editorRowAppendString(textRow *row, char *s, size_t len) {
+  rowReserve(row, len);  // make sure the gap can hold the whole string
+  rowMoveGap(row, row->length);  // move the gap to the end of the row
+  memcpy(&row->characters[row->gapStart], s, len);
+  row->gapStart += len;
+  row->length += len;
+  editorUpdateRow(row);
+  Text.modified = true;
+  Text.version++;
+  int64_t position = editorRowIndex(row);
+  editorMarkDirty(position);
+  journalRecord(JOURNAL_APPEND_STRING, position, 0, s, len);
+}
+
+// -----------------------------------------------------------------------------
+// cuts a row off after its first length characters
+void editorRowTruncate(textRow *row, int64_t length) {
+  if (length < 0 || length >= row->length) return;
+  rowMoveGap(row, row->length);  // the gap at the end of the row grows to cover the characters cut off
+  row->length = length;
+  row->gapStart = length;
+  editorUpdateRow(row);
+  Text.modified = true;
+  Text.version++;
+  int64_t position = editorRowIndex(row);
+  editorMarkDirty(position);
+  journalRecord(JOURNAL_TRUNCATE_ROW, position, length, NULL, 0);
+}
+
+// -----------------------------------------------------------------------------
+// textRow *row - pointer to an textRow struct
+// int64_t at - the index at which we want to insert the character (index to insert 'at'???)
+void editorRowDelChar(textRow *row, int64_t at) {
+  if (at < 0 || at >= row->length) return;
+  bool splice = (rowCharAt(row, at) != '\t' && at > row->lastTab);  // no tabs need re-expanding, so the display can be patched in place
+  if (splice && row->displayCapacity == 0 && at != row->length - 1) editorDetachDisplay(row);  // the gap is about to move away from the end of the row
+  rowGapDelete(row, at);
+  if (splice) editorDisplayDelChar(row, at);
+  else editorUpdateRow(row);
+  Text.modified = true;
+  Text.version++;
+  int64_t position = editorRowIndex(row);
+  editorMarkDirty(position);
+  journalRecord(JOURNAL_DELETE_CHAR, position, at, NULL, 0);
+}
+
+/*** editor operations ***/  // This section will contain functions that we’ll call from editorProcessKeypress() when we’re mapping keypresses to various text editing operations
 // 8888888888 8888888b. 8888888 88888888888 .d88888b.  8888888b.        .d88888b.  8888888b.  8888888888 8888888b.         d8888 88888888888 8888888 .d88888b.  888b    888  .d8888b.  
 // 888        888  "Y88b  888       888    d88P" "Y88b 888   Y88b      d88P" "Y88b 888   Y88b 888        888   Y88b       d88888     888       888  d88P" "Y88b 8888b   888 d88P  Y88b 
 // 888        888    888  888       888    888     888 888    888      888     888 888    888 888        888    888      d88P888     888       888  888     888 88888b  888 Y88b.      
@@ -702,110 +2171,2081 @@ void editorRowDelChar(textRow *row, int at) {
 // 8888888888 8888888P" 8888888     888     "Y88888P"  888   T88b       "Y88888P"  888        8888888888 888   T88b d88P     888     888     8888888 "Y88888P"  888    Y888  "Y8888P"
 
 // -----------------------------------------------------------------------------
-// take a character and use editorRowInsertChar() to insert that character into the position that the cursor is at.
-void editorInsertChar(int c) {
-  if (Text.cursorYPosition == Text.totalRows) {    // if the cursor is located on the very last line of the editor text (the cursor is on the tilde line after the end of the file, so we need to append a new row)
-    editorInsertRow(Text.totalRows, "", 0);  // allocate memory space for a new row - the new character will be inserted on a new row 
+// take a character and use editorRowInsertChar() to insert that character into the position that the cursor is at.
+void editorInsertChar(int c) {
+  if (Text.cursorYPosition == Text.totalRows) {    // if the cursor is located on the very last line of the editor text (the cursor is on the tilde line after the end of the file, so we need to append a new row)
+    editorInsertRow(Text.totalRows, "", 0);  // allocate memory space for a new row - the new character will be inserted on a new row 
+  }
+  editorRowInsertChar(editorRowForEdit(Text.cursorYPosition), Text.cursorXPosition, c);  // insert the character (c) into the specific row of the row array
+  Text.cursorXPosition++;  // move the cursor forward so that the next character the user inserts will go after the character just inserted
+}
+
+// -----------------------------------------------------------------------------
+//
+void editorInsertNewline() {
+  if (Text.cursorXPosition == 0) {  // if the cursor is at the beginning of a line
+    editorInsertRow(Text.cursorYPosition, "", 0);  // insert a new blank row before the line the cursor is on
+  } else {  // Otherwise, we have to split the line we’re on into two rows
+    textRow *row = editorRowForEdit(Text.cursorYPosition);  // assign a new pointer to the address of the first character of the text that will be moved down a row
+    editorInsertRow(Text.cursorYPosition + 1, &editorRowText(row)[Text.cursorXPosition], row->length - Text.cursorXPosition); // insert the text pointed to by row into a new line - calls editorUpdateRow()
+    editorRowTruncate(row, Text.cursorXPosition);  // cut the row off at the x coordinate - the characters after it moved down
+  }
+  Text.cursorYPosition++;    // move the cursor to the beginning of the new row
+  Text.cursorXPosition = 0;  // move the cursor to the beginning of the new row
+}
+
+// -----------------------------------------------------------------------------
+// use editorRowDelChar() to delete a character at the position that the cursor is at.
+void editorDelChar() {
+  if (Text.cursorYPosition == Text.totalRows) return;  // do nothing if the cursor is on the tilde line - If the cursor’s past the end of the file, then there is nothing to delete, and we return immediately
+  if (Text.cursorXPosition == 0 && Text.cursorYPosition == 0) return;  //do nothing if the cursor is at the beginning of the first line
+
+  // Otherwise, we get the textRow the cursor is on, and if there is a character to the left of the cursor, we delete it and move the cursor one to the left
+  textRow *row = editorRowForEdit(Text.cursorYPosition);
+  if (Text.cursorXPosition > 0) {
+    editorRowDelChar(row, Text.cursorXPosition - 1);
+    Text.cursorXPosition--;
+  } else {  // if (Text.cursorXPosition == 0) - if the cursor is at the beginning of the line of text, append the entire line to the previous line and reduce the size of
+    textRow *previous = editorRowForEdit(Text.cursorYPosition - 1);
+    Text.cursorXPosition = previous->length;  // move the x coordniate of the cursor to the end of the previous row (while staying in the same row)
+    editorRowAppendString(previous, editorRowText(row), row->length);  // Append the contents of the line the cursor is on to the contents of the line above it
+    editorDelRow(Text.cursorYPosition);  // delete the row the cursor is on
+    Text.cursorYPosition--;  // move the cursor up one row to the position where the two lines were joined
+  }
+}
+
+/*** file i/o ***/
+// 8888888888 8888888 888      8888888888      8888888        d88P  .d88888b.  
+// 888          888   888      888               888         d88P  d88P" "Y88b 
+// 888          888   888      888               888        d88P   888     888 
+// 8888888      888   888      8888888           888       d88P    888     888 
+// 888          888   888      888               888      d88P     888     888 
+// 888          888   888      888               888     d88P      888     888 
+// 888          888   888      888               888    d88P       Y88b. .d88P 
+// 888        8888888 88888888 8888888888      8888888 d88P         "Y88888P"  
+                                                                                                                                                       
+// -----------------------------------------------------------------------------
+// writes all length bytes of s to fd, however many write()s that takes, carrying on after an interrupted or partial one - returns 
+// false on an error, with errno set
+bool writeAll(int fd, const char *s, size_t length) {
+  while (length > 0) {
+    ssize_t n = write(fd, s, length);
+    if (n == -1 && errno == EINTR) continue;
+    if (n == 0) errno = EIO;  // no room, and no error to say so
+    if (n <= 0) return false;
+    s += n;
+    length -= n;
+  }
+  return true;
+}
+
+typedef struct saveBatch {  // the pieces of the text editorWriteRows() has yet to write - they point at the rows, nothing is copied
+  struct iovec parts[SAVE_IOVECS];
+  int count;  // the quantity of parts in use
+  size_t written;  // the quantity of bytes written so far
+  codec *packer;  // compresses the parts on their way to the file, or NULL to write them as they are
+} saveBatch;
+
+// -----------------------------------------------------------------------------
+// writes every part of a batch to fd with writev(), carrying on after a partial write from wherever it stopped - returns false on an 
+// error, with errno set
+bool saveFlush(int fd, saveBatch *batch) {
+  struct iovec *part = batch->parts;
+  int left = batch->count;
+  batch->count = 0;
+  if (batch->packer) {  // the compressor takes the parts one at a time, and writes what comes out of it in big pieces
+    for (int j = 0; j < left; j++)
+      if (!codecCompress(batch->packer, fd, part[j].iov_base, part[j].iov_len, false, &batch->written)) return false;
+    return true;
+  }
+  while (left > 0) {
+    ssize_t written = writev(fd, part, left);
+    if (written == -1 && errno == EINTR) continue;
+    if (written == 0) errno = EIO;  // the way writeAll() does
+    if (written <= 0) return false;
+    batch->written += written;
+    while (left > 0 && (size_t)written >= part->iov_len) {  // skip the parts written in full
+      written -= part->iov_len;
+      part++;
+      left--;
+    }
+    if (left > 0) {  // and start the next writev() part way through the one that was cut short
+      part->iov_base = (char *)part->iov_base + written;
+      part->iov_len -= written;
+    }
+  }
+  return true;
+}
+
+// -----------------------------------------------------------------------------
+// adds length bytes at s to a batch, writing the batch out to fd first if it is full. Bytes that carry straight on from the last part
+// (the lines of a mapped file that haven't been touched, and their newlines) just make that part longer.
+bool saveAppend(int fd, saveBatch *batch, const char *s, size_t length) {
+  if (length == 0) return true;
+  if (batch->count > 0) {
+    struct iovec *last = &batch->parts[batch->count - 1];
+    if ((const char *)last->iov_base + last->iov_len == s) {
+      last->iov_len += length;
+      return true;
+    }
+  }
+  if (batch->count == SAVE_IOVECS && !saveFlush(fd, batch)) return false;
+  batch->parts[batch->count++] = (struct iovec){ (void *)s, length };
+  return true;
+}
+
+// -----------------------------------------------------------------------------
+// adds the row in a slot of one of the piece table buffers and a newline to a batch - it takes up to 3 parts. The parts point at the
+// row's characters (both sides of its gap) or straight into the mapped file, so nothing is copied.
+bool saveAppendRow(int fd, saveBatch *batch, int source, int64_t slot) {
+  textRow *row = madeRow(source, slot);
+  char *text;
+  int64_t length;
+  bool ok = true;
+  if (row && row->gapStart < row->length) {  // the characters before the gap, then the ones after it - the row is left as it is
+    ok = saveAppend(fd, batch, row->characters, row->gapStart);
+    text = &row->characters[row->gapStart + rowGapLength(row)];
+    length = row->length - row->gapStart;
+  } else if (row) {  // the gap is at the end, out of the way
+    text = row->characters;
+    length = row->length;
+  } else {  // a line of a mapped file that was never made into a row is written straight from the mapping
+    editorLineSpan(slot, &text, &length);
+  }
+  bool inMap = !row || (row->memory & MAPPED);  // there is always a byte after a line of the mapping, so it can be looked at
+  return ok && saveAppend(fd, batch, text, length) &&
+         saveAppend(fd, batch, (inMap && text[length] == '\n') ? &text[length] : "\n", 1);  // the file's own newline joins the line's part
+}
+
+// -----------------------------------------------------------------------------
+// writes every row of the text to fd with a newline after each one, SAVE_IOVECS parts per writev(), so saving copies nothing and takes
+// the same memory however big the text is. Puts the quantity of bytes written in *written, and returns false on an error, with errno
+// set.
+bool editorWriteRows(int fd, size_t *written) {
+  saveBatch batch;
+  batch.count = 0;
+  batch.written = 0;
+  batch.packer = NULL;
+  bool ok = true;
+  for (piece *run = pieceFirst(); run && ok; run = pieceNext(run))  // loop through the rows, run by run in text order
+    for (int64_t k = 0; k < run->count && ok; k++)
+      ok = saveAppendRow(fd, &batch, run->source, run->start + k);
+  ok = ok && saveFlush(fd, &batch);
+  *written = batch.written;
+  return ok;
+}
+
+// -----------------------------------------------------------------------------
+// editorWriteRows() for the save thread - writes the rows of the snapshot taken by editorSave(), from the row at position from on. The 
+// rows are only looked at with the save lock held, and the lock is let go while each batch is written, so the main thread can carry
+// on editing in the meantime.
+bool editorWriteSnapshotFrom(int fd, int64_t from, size_t *written) {
+  saveBatch batch;
+  batch.count = 0;
+  batch.written = 0;
+  batch.packer = NULL;
+  codec packer;
+  if (Text.save.compression != COMPRESSION_NONE) {  // the whole file is written, never just the end of it
+    if (!codecStart(&packer, Text.save.compression, true)) {
+      errno = ENOSYS;
+      return false;
+    }
+    batch.packer = &packer;
+  }
+  bool ok = true;
+  int64_t done = 0;
+  pthread_mutex_lock(&Text.save.lock);
+  for (int64_t r = 0; r < Text.save.runCount && ok; r++) {
+    pieceRun *run = &Text.save.runs[r];
+    if (done + run->count <= from) {  // a run before the first row wanted
+      done += run->count;
+      continue;
+    }
+    int64_t first = (from > done) ? from - done : 0;  // the run may start before the first row wanted
+    done += first;
+    for (int64_t k = first; k < run->count && ok; k++, done++) {
+      if (batch.count + 3 > SAVE_IOVECS) {  // no room for another row - the parts stay good without the lock, as the rows they point
+        Text.save.rowsDone = done;          // at can't change until the save is over
+        pthread_mutex_unlock(&Text.save.lock);
+        ok = saveFlush(fd, &batch);
+        pthread_mutex_lock(&Text.save.lock);
+      }
+      ok = ok && saveAppendRow(fd, &batch, run->source, run->start + k);
+    }
+  }
+  pthread_mutex_unlock(&Text.save.lock);
+  ok = ok && saveFlush(fd, &batch);
+  if (batch.packer) {
+    ok = ok && codecCompress(batch.packer, fd, NULL, 0, true, &batch.written);  // the end of the stream, and its checksum
+    codecEnd(batch.packer);
+  }
+  *written = batch.written;
+  return ok;
+}
+
+// -----------------------------------------------------------------------------
+// editorWriteSnapshotFrom() for the whole snapshot
+bool editorWriteSnapshot(int fd, size_t *written) {
+  return editorWriteSnapshotFrom(fd, 0, written);
+}
+
+// -----------------------------------------------------------------------------
+// returns where the line in a slot of a mapped file's original buffer starts in the mapping, and how long it is without its newline
+void editorLineSpan(int64_t slot, char **text, int64_t *length) {
+  int64_t start = Text.map.lineStart[slot];
+  int64_t end = Text.map.lineStart[slot + 1] - 1;  // the newline - or the end of the file, for a last line without one
+  while (end > start && Text.map.base[end - 1] == '\r') end--;
+  *text = &Text.map.base[start];
+  *length = end - start;
+}
+
+// -----------------------------------------------------------------------------
+// reads the line of the --pager file that starts at offset - puts where its text is in *text (which stays valid until the next read)
+// and its length in *length, and returns the offset of the line after it. Only the first PAGER_LINE_LIMIT bytes of a longer line are 
+// kept, the rest of it is skipped.
+int64_t pagerLine(int64_t offset, char **text, int64_t *length) {
+  pagerState *pager = &Text.pager;
+  char *newline = NULL;
+  if (offset >= pager->bufferOffset && offset < pager->bufferOffset + pager->bufferLength)
+    newline = memchr(&pager->buffer[offset - pager->bufferOffset], '\n', pager->bufferOffset + pager->bufferLength - offset);
+  for (int64_t read = PAGER_READ_SIZE; newline == NULL && read <= PAGER_LINE_LIMIT; read *= 4) {  // the line isn't all in what was read
+    if (offset >= pager->bufferOffset && offset <= pager->bufferOffset + pager->bufferLength &&
+        pager->bufferOffset + pager->bufferLength >= pager->size) break;  // the last line, and all of it is there
+    int64_t from = offset;
+    if (read == PAGER_READ_SIZE && offset < pager->bufferOffset)  // going backwards - the lines before this one are read along with it
+      from = offset > PAGER_READ_SIZE / 2 ? offset - PAGER_READ_SIZE / 2 : 0;
+    int64_t want = pager->size - from < read ? pager->size - from : read;
+    ssize_t n = want > 0 ? pread(pager->fd, pager->buffer, want, from) : 0;
+    pager->bufferOffset = from;
+    pager->bufferLength = n > 0 ? n : 0;
+    if (pager->bufferLength < offset - from) {  // the file was cut short since it was opened - the lines that are gone read as empty
+      pager->bufferOffset = from = offset;
+      pager->bufferLength = 0;
+    }
+    newline = memchr(&pager->buffer[offset - from], '\n', pager->bufferLength - (offset - from));
+  }
+
+  char *start = &pager->buffer[offset - pager->bufferOffset];
+  int64_t next;
+  if (newline) {
+    *length = newline - start;
+    next = offset + *length + 1;
+  } else {  // the last line of a file that doesn't end in a newline, or a line longer than the buffer
+    *length = pager->bufferOffset + pager->bufferLength - offset;
+    next = offset + *length;
+    while (next < pager->size) {
+      int64_t want = pager->size - next < PAGER_LINE_LIMIT ? pager->size - next : PAGER_LINE_LIMIT;
+      ssize_t n = pread(pager->fd, pager->scan, want, next);
+      if (n <= 0) {
+        next = pager->size;
+        break;
+      }
+      char *end = memchr(pager->scan, '\n', n);
+      next += end ? end - pager->scan + 1 : n;
+      if (end) break;
+    }
+  }
+  while (*length > 0 && start[*length - 1] == '\r') (*length)--;
+  *text = start;
+  return next;
+}
+
+// -----------------------------------------------------------------------------
+// returns the offset of the start of a line of the --pager file - the first time a line between two checkpoints is asked for, the 
+// starts of all of the lines between them are found
+int64_t pagerSeek(int64_t line) {
+  pagerState *pager = &Text.pager;
+  int64_t block = line / PAGER_CHECKPOINT_LINES;
+  if (block != pager->offsetsBlock || line % PAGER_CHECKPOINT_LINES >= pager->offsetsCount) {
+    int64_t count = Text.totalRows - block * PAGER_CHECKPOINT_LINES;
+    if (count > PAGER_CHECKPOINT_LINES) count = PAGER_CHECKPOINT_LINES;
+    char *text;
+    int64_t length;
+    pager->lineOffsets[0] = pager->checkpoints[block];
+    for (int64_t k = 0; k < count; k++) pager->lineOffsets[k + 1] = pagerLine(pager->lineOffsets[k], &text, &length);
+    pager->offsetsBlock = block;
+    pager->offsetsCount = count;
+  }
+  return pager->lineOffsets[line % PAGER_CHECKPOINT_LINES];
+}
+
+// -----------------------------------------------------------------------------
+// finds a line of the --pager file without making a row of it - like editorLineSpan(), for searching lines that aren't in the window
+void pagerSpan(int64_t line, char **text, int64_t *length) {
+  pagerLine(pagerSeek(line), text, length);
+}
+
+// -----------------------------------------------------------------------------
+// searches up to bytes more of the --pager file for line ends - only every PAGER_CHECKPOINT_LINES'th line's start is kept
+void pagerIndexMore(size_t bytes) {
+  pagerState *pager = &Text.pager;
+  int64_t end = pager->indexed + (int64_t)bytes < pager->size ? pager->indexed + (int64_t)bytes : pager->size;
+  bool newline = true;  // whether the last byte searched ended a line
+  while (pager->indexed < end) {
+    int64_t want = end - pager->indexed < PAGER_LINE_LIMIT ? end - pager->indexed : PAGER_LINE_LIMIT;
+    ssize_t n = pread(pager->fd, pager->scan, want, pager->indexed);
+    if (n <= 0) {  // the file got shorter - what was there is all there is
+      pager->size = end = pager->indexed;
+      break;
+    }
+    for (char *p = pager->scan; (p = memchr(p, '\n', &pager->scan[n] - p)) != NULL; p++) {
+      if (++Text.totalRows % PAGER_CHECKPOINT_LINES) continue;
+      int64_t k = Text.totalRows / PAGER_CHECKPOINT_LINES;
+      if (k == pager->checkpointCapacity) {
+        pager->checkpointCapacity *= 2;
+        pager->checkpoints = realloc(pager->checkpoints, sizeof(int64_t) * pager->checkpointCapacity);
+      }
+      pager->checkpoints[k] = pager->indexed + (p - pager->scan) + 1;
+    }
+    newline = (pager->scan[n - 1] == '\n');
+    pager->indexed += n;
+  }
+  if (pager->indexed == pager->size && pager->size > 0 && !newline) Text.totalRows++;  // the last line of a file that doesn't end in a 
+}                                                                                       // newline - its checkpoint is already there
+
+// -----------------------------------------------------------------------------
+// returns the slot in the pager's window holding the row at position at, or -1
+int pagerFind(int64_t at) {
+  int s = Text.pager.buckets[at % PAGER_SLOTS];
+  while (s != -1 && Text.pager.slots[s].line != at) s = Text.pager.slots[s].next;
+  return s;
+}
+
+// -----------------------------------------------------------------------------
+// takes a slot off the least recently used list
+void pagerUnlink(int s) {
+  pagerSlot *slot = &Text.pager.slots[s];
+  if (slot->newer != -1) Text.pager.slots[slot->newer].older = slot->older;
+  else Text.pager.newest = slot->older;
+  if (slot->older != -1) Text.pager.slots[slot->older].newer = slot->newer;
+  else Text.pager.oldest = slot->newer;
+}
+
+// -----------------------------------------------------------------------------
+// puts a slot that isn't on the least recently used list at the front of it
+void pagerLink(int s) {
+  Text.pager.slots[s].older = Text.pager.newest;
+  Text.pager.slots[s].newer = -1;
+  if (Text.pager.newest != -1) Text.pager.slots[Text.pager.newest].newer = s;
+  else Text.pager.oldest = s;
+  Text.pager.newest = s;
+}
+
+// -----------------------------------------------------------------------------
+// moves a slot to the front of the least recently used list
+void pagerTouch(int s) {
+  if (Text.pager.newest == s) return;
+  pagerUnlink(s);
+  pagerLink(s);
+}
+
+// -----------------------------------------------------------------------------
+// frees the least recently used row in the pager's window
+void pagerEvict() {
+  int s = Text.pager.oldest;
+  pagerSlot *slot = &Text.pager.slots[s];
+  pagerUnlink(s);
+  int *link = &Text.pager.buckets[slot->line % PAGER_SLOTS];
+  while (*link != s) link = &Text.pager.slots[*link].next;
+  *link = slot->next;
+  editorFreeRow(&slot->row);
+  Text.pager.used -= slot->bytes;
+  Text.pager.count--;
+  slot->line = -1;
+  slot->next = Text.pager.free;
+  Text.pager.free = s;
+}
+
+// -----------------------------------------------------------------------------
+// makes the row at position at out of its line, into the pager's window - rows that weren't used for longest make room for it, but a 
+// screenful of rows is always kept, so a row being drawn is never freed under it, and so are the rows being made along with it. 
+// Returns the bytes the row takes.
+size_t pagerMake(int64_t at, char *text, int64_t length) {
+  pagerState *pager = &Text.pager;
+  while (pager->count > Text.screenRows + 1 && (pager->free == -1 || pager->used + length + 1 > pager->budget) &&
+         pager->slots[pager->oldest].load != pager->loads)  // the oldest row is only one of them once every other row is gone
+    pagerEvict();
+  int s = pager->free;
+  pagerSlot *slot = &pager->slots[s];
+  pager->free = slot->next;
+  editorInitRow(&slot->row, text, length);
+  editorUpdateDisplay(&slot->row);  // no highlighting - whether a row starts in a comment can't be known without the rows before it
+  slot->row.owner = NULL;
+  slot->row.slot = at;
+  slot->line = at;
+  slot->load = pager->loads;
+  slot->bytes = slot->row.capacity + slot->row.displayCapacity;
+  slot->next = pager->buckets[at % PAGER_SLOTS];
+  pager->buckets[at % PAGER_SLOTS] = s;
+  pagerLink(s);
+  pager->used += slot->bytes;
+  pager->count++;
+  return slot->bytes;
+}
+
+// -----------------------------------------------------------------------------
+// makes the rows for count lines from position from into the pager's window, in one pass over the file - at is the one asked for, the
+// rest are there for when the screen gets to them. Stops making them once they take a quarter of the budget.
+void pagerLoad(int64_t from, int64_t count, int64_t at) {
+  int64_t offset = pagerSeek(from);
+  size_t made = 0;
+  Text.pager.loads++;
+  for (int64_t line = from; line < from + count; line++) {
+    char *text;
+    int64_t length;
+    int64_t next = pagerLine(offset, &text, &length);
+    if (pagerFind(line) == -1 && (line == at || made < Text.pager.budget / 4)) made += pagerMake(line, text, length);
+    offset = next;
+  }
+}
+
+// -----------------------------------------------------------------------------
+// returns the row at position at in a file opened with --pager, reading it and the rows after it (or before it, when the screen is
+// moving up) into the window first if it isn't there
+textRow *pagerRowAt(int64_t at) {
+  if (at < 0 || at >= Text.totalRows) return NULL;
+  int s = pagerFind(at);
+  if (s == -1) {
+    int64_t from = at, count = PAGER_LOAD_ROWS;
+    if (at < Text.pager.lastAsked) {
+      from = at >= PAGER_LOAD_ROWS - 1 ? at - (PAGER_LOAD_ROWS - 1) : 0;
+      count = at - from + 1;
+    } else if (count > Text.totalRows - from) {
+      count = Text.totalRows - from;
+    }
+    pagerLoad(from, count, at);
+    s = pagerFind(at);
+  }
+  Text.pager.lastAsked = at;
+  pagerTouch(s);
+  return &Text.pager.slots[s].row;
+}
+
+// -----------------------------------------------------------------------------
+// returns the row at position at in a file opened with --pager if it is in the window, or NULL
+textRow *pagerRowIfMade(int64_t at) {
+  int s = (at >= 0 && at < Text.totalRows) ? pagerFind(at) : -1;
+  return s == -1 ? NULL : &Text.pager.slots[s].row;
+}
+
+// -----------------------------------------------------------------------------
+// lets go of a file opened with --pager
+void pagerClose() {
+  pagerState *pager = &Text.pager;
+  if (!pager->on) return;
+  while (pager->count > 0) pagerEvict();
+  close(pager->fd);
+  free(pager->slots);
+  free(pager->buckets);
+  free(pager->checkpoints);
+  free(pager->lineOffsets);
+  free(pager->buffer);
+  free(pager->scan);
+  pager->slots = NULL;
+  pager->buckets = NULL;
+  pager->checkpoints = NULL;
+  pager->lineOffsets = NULL;
+  pager->buffer = pager->scan = NULL;
+  pager->fd = -1;
+  pager->on = false;
+  Text.totalRows = 0;
+}
+
+// -----------------------------------------------------------------------------
+// returns the entry of the hex view's patch map for the byte at offset - the one holding it, or the free one it would go in
+hexPatch *hexPatchAt(int64_t offset) {
+  uint64_t mask = Text.hex.patchCapacity - 1;
+  uint64_t k = ((uint64_t)offset * 0x9E3779B97F4A7C15ULL) & mask;  // spreads runs of neighbouring bytes over the map
+  while (Text.hex.patches[k].offset != -1 && Text.hex.patches[k].offset != offset) k = (k + 1) & mask;
+  return &Text.hex.patches[k];
+}
+
+// -----------------------------------------------------------------------------
+// returns the byte at offset in the hex view - the changed one, if it was changed
+byte hexByte(int64_t offset, bool *changed) {
+  hexPatch *patch = Text.hex.patchCount ? hexPatchAt(offset) : NULL;
+  *changed = (patch && patch->offset == offset);
+  return *changed ? patch->value : Text.hex.base[offset];
+}
+
+// -----------------------------------------------------------------------------
+// empties the hex view's patch map, making it capacity entries big
+void hexPatchReset(int64_t capacity) {
+  free(Text.hex.patches);
+  Text.hex.patches = malloc(sizeof(hexPatch) * capacity);
+  for (int64_t k = 0; k < capacity; k++) Text.hex.patches[k].offset = -1;
+  Text.hex.patchCapacity = capacity;
+  Text.hex.patchCount = 0;
+}
+
+// -----------------------------------------------------------------------------
+// changes the byte at offset in the hex view - nothing is written to the file until it is saved
+void hexSetByte(int64_t offset, byte value) {
+  if ((Text.hex.patchCount + 1) * 2 > Text.hex.patchCapacity) {  // half full - double it, putting every change back in
+    hexPatch *old = Text.hex.patches;
+    int64_t oldCapacity = Text.hex.patchCapacity;
+    Text.hex.patches = NULL;
+    hexPatchReset(oldCapacity * 2);
+    for (int64_t k = 0; k < oldCapacity; k++)
+      if (old[k].offset != -1) {
+        *hexPatchAt(old[k].offset) = old[k];
+        Text.hex.patchCount++;
+      }
+    free(old);
+  }
+  hexPatch *patch = hexPatchAt(offset);
+  if (patch->offset == -1) Text.hex.patchCount++;
+  patch->offset = offset;
+  patch->value = value;
+  Text.modified = true;
+}
+
+// -----------------------------------------------------------------------------
+// lets go of a file opened with --hex, and any changes to it that weren't saved
+void hexClose() {
+  if (!Text.hex.on) return;
+  if (Text.hex.base) munmap(Text.hex.base, Text.hex.size);
+  close(Text.hex.fd);
+  free(Text.hex.patches);
+  Text.hex.base = NULL;
+  Text.hex.patches = NULL;
+  Text.hex.patchCount = Text.hex.patchCapacity = 0;
+  Text.hex.fd = -1;
+  Text.hex.on = false;
+  Text.hex.cutShort = false;
+  Text.totalRows = 0;
+}
+
+// -----------------------------------------------------------------------------
+// maps the hex view's file again after it was found truncated (see editorMappingFault()), at the size it is now - the changes past
+// its new end are dropped. Returns false if it can't be, leaving the zeros where the file was cut.
+bool hexRemap() {
+  struct stat info;
+  byte *base = NULL;
+  if (fstat(Text.hex.fd, &info) == -1 ||
+      (info.st_size > 0 && (base = mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, Text.hex.fd, 0)) == MAP_FAILED))
+    return false;
+  if (base) madvise(base, info.st_size, MADV_RANDOM);
+  if (Text.hex.base) munmap(Text.hex.base, Text.hex.size);
+  Text.hex.base = base;
+  Text.hex.size = info.st_size;
+  Text.totalRows = (info.st_size + HEX_ROW_BYTES - 1) / HEX_ROW_BYTES;
+  if (Text.hex.cursor >= Text.hex.size) Text.hex.cursor = Text.hex.size > 0 ? Text.hex.size - 1 : 0;
+
+  hexPatch *old = Text.hex.patches;  // put back the changes that are still in the file
+  int64_t oldCapacity = Text.hex.patchCapacity;
+  Text.hex.patches = NULL;
+  hexPatchReset(oldCapacity);
+  for (int64_t k = 0; k < oldCapacity; k++)
+    if (old[k].offset != -1 && old[k].offset < Text.hex.size) {
+      *hexPatchAt(old[k].offset) = old[k];
+      Text.hex.patchCount++;
+    }
+  free(old);
+  Text.modified = (Text.hex.patchCount > 0);
+  return true;
+}
+
+// -----------------------------------------------------------------------------
+// true while some of a mapped file (or a file opened with --pager) hasn't been searched for lines yet
+bool editorLoading() {
+  return (Text.map.base && Text.map.indexed < Text.map.size) || (Text.pager.on && Text.pager.indexed < Text.pager.size);
+}
+
+// -----------------------------------------------------------------------------
+// searches up to bytes more of a mapped file for line ends, and adds the lines found to the end of the text - only their starts are 
+// recorded, no rows are made
+void editorIndexMore(size_t bytes) {
+  if (Text.pager.on) {
+    pagerIndexMore(bytes);
+    return;
+  }
+  size_t end = Text.map.indexed + bytes < Text.map.size ? Text.map.indexed + bytes : Text.map.size;
+  int64_t start = Text.rows.originalRows;
+  newlineIndex newlines = { NULL, 0, 0 };
+  indexNewlines(Text.map.base, Text.map.indexed, end, &newlines);
+  if (Text.rows.originalRows + newlines.count + 2 > Text.map.lineCapacity) {
+    while (Text.rows.originalRows + newlines.count + 2 > Text.map.lineCapacity) Text.map.lineCapacity *= 2;
+    Text.map.lineStart = realloc(Text.map.lineStart, sizeof(int64_t) * Text.map.lineCapacity);
+  }
+  for (int64_t j = 0; j < newlines.count; j++)  // a line that goes on past what was searched is finished by the next search
+    Text.map.lineStart[++Text.rows.originalRows] = newlines.offsets[j] + 1;
+  free(newlines.offsets);
+  if (end == Text.map.size && Text.map.lineStart[Text.rows.originalRows] < (int64_t)end)  // the last line of a file that doesn't end in a 
+    Text.map.lineStart[++Text.rows.originalRows] = end + 1;                              // newline - the 0 after the mapping stands in for it
+  Text.map.indexed = end;
+
+  int64_t blocks = (Text.rows.originalRows + ADD_BLOCK_ROWS - 1) / ADD_BLOCK_ROWS;
+  if (blocks > Text.map.blockCount) {  // room for the rows of the new lines, should they ever be made
+    Text.map.rowBlocks = realloc(Text.map.rowBlocks, sizeof(textRow *) * blocks);
+    memset(&Text.map.rowBlocks[Text.map.blockCount], 0, sizeof(textRow *) * (blocks - Text.map.blockCount));
+    Text.map.blockCount = blocks;
+  }
+  int64_t count = Text.rows.originalRows - start;
+  pieceTableAppend(ORIGINAL_BUFFER, start, count);
+  Text.totalRows += count;
+}
+
+// -----------------------------------------------------------------------------
+// finishes searching a mapped file for lines - needed before anything that has to see the whole text
+void editorIndexAll() {
+  while (editorLoading()) editorIndexMore(INDEX_STEP);
+}
+
+// -----------------------------------------------------------------------------
+// maps a file of size bytes into memory instead of reading it - returns false if it can't be mapped
+bool editorMapFile(int fd, size_t size) {
+  char *base = mmap(NULL, size + 1, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);  // room for the file and a 0 after it
+  if (base == MAP_FAILED) return false;
+  if (mmap(base, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {  // the file goes over the start of it
+    munmap(base, size + 1);
+    return false;
+  }
+  Text.map.base = base;
+  Text.map.size = size;
+  Text.map.indexed = 0;
+  Text.map.lineCapacity = 1024;
+  Text.map.lineStart = malloc(sizeof(int64_t) * Text.map.lineCapacity);
+  Text.map.lineStart[0] = 0;
+  return true;
+}
+
+// -----------------------------------------------------------------------------
+// the SIGBUS handler. Reading a page of a mapped file that something else has truncated since raises SIGBUS, which would kill the
+// editor - instead, the page is replaced with one of zeros, and the read that faulted finds those when it is tried again. Only the 
+// page read is replaced, as the pages after it may be copies an edit made, which still hold rows. editorMappingCheck() sees to the 
+// rest. The hex view's mapping is looked after the same way. Any other bus error is let through.
+void editorMappingFault(int number, siginfo_t *info, void *context) {
+  (void)context;
+  char *address = info->si_addr,
+       *page = (char *)((uintptr_t)address & ~(uintptr_t)(Text.pageSize - 1));
+  if (Text.map.base && address >= Text.map.base && address < Text.map.base + Text.map.size &&
+      mmap(page, Text.pageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0) != MAP_FAILED) {
+    Text.map.cutShort = true;
+    return;
+  }
+  if (Text.hex.base && address >= (char *)Text.hex.base && address < (char *)Text.hex.base + Text.hex.size &&
+      mmap(page, Text.pageSize, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0) != MAP_FAILED) {
+    Text.hex.cutShort = true;
+    return;
+  }
+  signal(number, SIG_DFL);  // the read faults again once this returns, and that kills the editor the way it always did
+}
+
+// -----------------------------------------------------------------------------
+// has editorMappingFault() catch the bus errors reading a truncated mapped file raises
+void editorCatchMappingFaults() {
+  Text.pageSize = sysconf(_SC_PAGESIZE);
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_sigaction = editorMappingFault;
+  action.sa_flags = SA_SIGINFO;
+  sigemptyset(&action.sa_mask);
+  sigaction(SIGBUS, &action, NULL);
+}
+
+// -----------------------------------------------------------------------------
+// frees all of the text - rows loaded from the file are freed along with the arena, so only the rows that were edited or added have
+// to be visited, not every line of the file. For a mapped file, only the blocks holding rows that were made have to be visited.
+void editorClose() {
+  pagerClose();
+  hexClose();
+  for (int64_t block = 0; block < Text.map.blockCount; block++) {
+    textRow *rows = Text.map.rowBlocks[block];
+    if (rows == NULL) continue;
+    for (int j = 0; j < ADD_BLOCK_ROWS; j++)
+      if (rows[j].characters) editorFreeRow(&rows[j]);
+    free(rows);
+  }
+  if (Text.map.base) munmap(Text.map.base, Text.map.size + 1);
+  free(Text.map.rowBlocks);
+  free(Text.map.lineStart);
+  Text.map.base = NULL;
+  Text.map.size = 0;
+  Text.map.indexed = 0;
+  Text.map.lineStart = NULL;
+  Text.map.lineCapacity = 0;
+  Text.map.rowBlocks = NULL;
+  Text.map.blockCount = 0;
+  Text.map.cutShort = false;
+
+  for (int64_t j = 0; j < Text.arena.ownedCount; j++) editorFreeRow(bufferRow(ORIGINAL_BUFFER, Text.arena.ownedRows[j]));
+  for (int64_t slot = 0; slot < Text.rows.addRows; slot++) editorFreeRow(bufferRow(ADD_BUFFER, slot));
+  for (int64_t block = 0; block * ADD_BLOCK_ROWS < Text.rows.addRows; block++) free(Text.rows.addBlocks[block]);
+  free(Text.rows.addBlocks);
+  free(Text.rows.original);
+  pieceFreeAll(Text.rows.root);
+  arenaFree();
+
+  Text.rows.original = NULL;
+  Text.rows.addBlocks = NULL;
+  Text.rows.originalRows = 0;
+  Text.rows.originalCapacity = 0;
+  Text.rows.addRows = 0;
+  Text.rows.root = NULL;
+  Text.totalRows = 0;
+  chunkFree(&Text.reload.loaded);
+  Text.reload.known = false;
+  Text.reload.changedFrom = INT64_MAX;
+  Text.carriageReturns = false;
+}
+
+// -----------------------------------------------------------------------------
+// for opening and reading a file from disk - returns what went wrong decompressing it, if it is compressed and something did, or NULL.
+// Whoever opened it says so, the way that suits them.
+const char *editorOpen(char *filename) {
+  editorClose();  // let go of any text that is already open
+  free(Text.filename);
+  Text.filename = strdup(filename);
+
+  editorSelectSyntaxHighlight();
+
+  FILE *fp = fopen(filename, "r");
+  if (!fp) die("fopen");
+  unsigned char magic[4];
+  ssize_t magicLength = pread(fileno(fp), magic, sizeof(magic), 0);
+  Text.compression = compressionOf(magic, magicLength > 0 ? magicLength : 0);
+
+  struct stat info;
+  if (!Text.follow.wanted && Text.compression == COMPRESSION_NONE && fstat(fileno(fp), &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0 && info.st_size >= MAP_OPEN_SIZE &&
+      editorMapFile(fileno(fp), info.st_size)) {
+    fclose(fp);  // the mapping stays after the file is closed
+    Text.map.device = info.st_dev;
+    Text.map.inode = info.st_ino;
+    while (editorLoading() && Text.totalRows <= Text.screenRows) editorIndexMore(INDEX_STEP);  // just enough lines for the first screen - 
+    Text.modified = false;                                                                    // the rest are found between keypresses
+    Text.dirtyFrom = INT64_MAX;
+    Text.savedFile = info;
+    Text.savedKnown = true;
+    return NULL;
+  }
+
+  FILE *input = fp;  // what the text is read from - for a compressed file, a pipe it is decompressed into as it is read
+  decompression job;
+  const char *error = NULL;
+  if (Text.compression != COMPRESSION_NONE && (input = decompressStart(&job, fileno(fp), Text.compression)) == NULL)
+    error = job.stream.error;
+
+  size_t capacity = OPEN_READ_SIZE;
+  char *buffer = malloc(capacity);
+  size_t length = 0;  // bytes in the buffer - whole lines are taken out after every read, so this is the start of an unfinished line
+  size_t bytesRead;
+  bool estimated = false;
+  Text.arena.open = true;  // the rows of the file go into the load arena
+  while (input && (bytesRead = fread(&buffer[length], 1, capacity - length, input)) > 0) {
+    length += bytesRead;
+    if (!estimated && fstat(fileno(input), &info) == 0 && (size_t)info.st_size > length) {  // size the original buffer from the length of the lines in the first read - unless it is a pipe, which has no size to go by
+      size_t lines = 1;
+      for (char *p = buffer; (p = memchr(p, '\n', &buffer[length] - p)) != NULL; p++) lines++;
+      originalBufferReserve(Text.totalRows + (int64_t)((double)info.st_size / length * lines * 1.1));  // 10% spare, in case the rest of the lines are shorter
+    }
+    estimated = true;
+
+    size_t used = editorAppendRows(buffer, length, false, ORIGINAL_BUFFER);
+    memmove(buffer, &buffer[used], length - used);
+    length -= used;
+    if (length == capacity) {  // a line longer than the buffer
+      size_t whole = fstat(fileno(input), &info) == 0 ? (size_t)info.st_size + 1 : 0;  // room for the rest of the file, plus a byte so fread() can see the end
+      capacity = (whole > length && whole < capacity * 2) ? whole : capacity * 2;  // doubling a buffer of gigabytes past the end of the file would waste gigabytes
+      buffer = realloc(buffer, capacity);
+    }
+  }
+  editorAppendRows(buffer, length, true, ORIGINAL_BUFFER);
+  chunkFinish(&Text.reload.loaded);
+  Text.reload.known = true;
+  Text.arena.open = false;
+  free(buffer);
+  if (input && input != fp) error = decompressFinish(&job, input);
+  Text.savedKnown = (fstat(fileno(fp), &Text.savedFile) == 0);  // what the file looks like, so a save can tell if it changed since
+  fclose(fp);
+  Text.modified = false;  // reset the modified flag
+  Text.dirtyFrom = INT64_MAX;  // the text is the file
+  return error;
+}
+
+// -----------------------------------------------------------------------------
+// opens a file read-only for paging through, however much bigger than memory it is - only the line index and a window of rows around
+// what is on the screen are kept. Returns false if the file can't be paged (it isn't a plain file, or it is compressed).
+bool editorPagerOpen(char *filename) {
+  int fd = open(filename, O_RDONLY);
+  struct stat info;
+  unsigned char magic[4];
+  ssize_t magicLength = fd == -1 ? -1 : pread(fd, magic, sizeof(magic), 0);
+  if (fd == -1 || fstat(fd, &info) == -1 || !S_ISREG(info.st_mode) || compressionOf(magic, magicLength > 0 ? magicLength : 0) != COMPRESSION_NONE) {
+    if (fd != -1) close(fd);
+    return false;
+  }
+
+  editorClose();
+  free(Text.filename);
+  Text.filename = strdup(filename);
+  Text.syntax = NULL;  // highlighting a row can depend on every row before it, and those aren't kept
+
+  pagerState *pager = &Text.pager;
+  pager->on = true;
+  pager->fd = fd;
+  pager->size = info.st_size;
+  pager->indexed = 0;
+  pager->checkpointCapacity = 1024;
+  pager->checkpoints = malloc(sizeof(int64_t) * pager->checkpointCapacity);
+  pager->checkpoints[0] = 0;
+  pager->loads = 0;
+  pager->lastAsked = 0;
+  pager->lineOffsets = malloc(sizeof(int64_t) * (PAGER_CHECKPOINT_LINES + 1));
+  pager->offsetsBlock = -1;
+  pager->offsetsCount = 0;
+  pager->bufferOffset = -1;  // nothing read yet
+  pager->bufferLength = 0;
+  pager->buffer = malloc(PAGER_LINE_LIMIT);
+  pager->scan = malloc(PAGER_LINE_LIMIT);
+  pager->slots = malloc(sizeof(pagerSlot) * PAGER_SLOTS);
+  pager->buckets = malloc(sizeof(int) * PAGER_SLOTS);
+  for (int s = 0; s < PAGER_SLOTS; s++) {
+    pager->slots[s].line = -1;
+    pager->slots[s].next = s + 1 < PAGER_SLOTS ? s + 1 : -1;
+    pager->buckets[s] = -1;
+  }
+  pager->free = 0;
+  pager->newest = pager->oldest = -1;
+  pager->count = 0;
+  pager->used = 0;
+
+  while (editorLoading() && Text.totalRows <= Text.screenRows) editorIndexMore(INDEX_STEP);  // the rest is searched between keypresses
+  Text.modified = false;
+  Text.dirtyFrom = INT64_MAX;
+  Text.savedKnown = false;  // nothing is ever saved, reloaded or journaled
+  return true;
+}
+
+// -----------------------------------------------------------------------------
+// opens a file as bytes - it is mapped, and nothing of it is read until it is on the screen, so a file of any size opens at once. 
+// Returns false if it isn't a plain file or can't be mapped.
+bool editorHexOpen(char *filename) {
+  bool writable = true;
+  int fd = open(filename, O_RDWR);
+  if (fd == -1) {
+    writable = false;
+    fd = open(filename, O_RDONLY);
+  }
+  struct stat info;
+  if (fd == -1 || fstat(fd, &info) == -1 || !S_ISREG(info.st_mode)) {
+    if (fd != -1) close(fd);
+    return false;
+  }
+  byte *base = NULL;
+  if (info.st_size > 0 && (base = mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, fd, 0)) == MAP_FAILED) {
+    close(fd);
+    return false;
+  }
+  if (base) madvise(base, info.st_size, MADV_RANDOM);  // a jump to an offset reads the page it lands on, not the megabytes after it
+
+  editorClose();
+  free(Text.filename);
+  Text.filename = strdup(filename);
+  Text.syntax = NULL;
+  Text.hex.on = true;
+  Text.hex.writable = writable;
+  Text.hex.fd = fd;
+  Text.hex.base = base;
+  Text.hex.size = info.st_size;
+  Text.hex.cursor = 0;
+  Text.hex.lowNibble = false;
+  Text.hex.patches = NULL;
+  hexPatchReset(HEX_PATCH_CAPACITY);
+  Text.totalRows = (info.st_size + HEX_ROW_BYTES - 1) / HEX_ROW_BYTES;  // a line of the screen for every HEX_ROW_BYTES bytes
+  Text.modified = false;
+  Text.dirtyFrom = INT64_MAX;
+  Text.savedKnown = false;  // saving only ever writes the changed bytes, so it needs nothing from the last save
+  return true;
+}
+
+// -----------------------------------------------------------------------------
+// used by qsort() to put the changed bytes in the order they are in the file
+int hexPatchCompare(const void *a, const void *b) {
+  int64_t x = ((const hexPatch *)a)->offset, y = ((const hexPatch *)b)->offset;
+  return (x > y) - (x < y);
+}
+
+// -----------------------------------------------------------------------------
+// writes the bytes changed in the hex view to the file, in place - a run of changed bytes next to each other takes one pwrite()
+void hexSave() {
+  if (!Text.hex.writable) {
+    editorSetStatusMessage("Can't save! The file is read-only");
+    return;
+  }
+  hexPatch *changes = malloc(sizeof(hexPatch) * (Text.hex.patchCount ? Text.hex.patchCount : 1));
+  int64_t count = 0;
+  for (int64_t k = 0; k < Text.hex.patchCapacity; k++)
+    if (Text.hex.patches[k].offset != -1) changes[count++] = Text.hex.patches[k];
+  qsort(changes, count, sizeof(hexPatch), hexPatchCompare);
+
+  byte run[HEX_WRITE_SIZE];
+  int64_t writes = 0;
+  bool ok = true;
+  for (int64_t k = 0; k < count && ok; writes++) {
+    int64_t start = changes[k].offset, length = 0;
+    while (k < count && changes[k].offset == start + length && length < HEX_WRITE_SIZE) run[length++] = changes[k++].value;
+    ok = (lseek(Text.hex.fd, start, SEEK_SET) != -1 && writeAll(Text.hex.fd, (char *)run, length));
+  }
+  ok = ok && fdatasync(Text.hex.fd) == 0;
+  free(changes);
+  if (!ok) {
+    editorSetStatusMessage("Can't save! I/O error: %s", strerror(errno));  // the changes are kept, so the save can be tried again
+    return;
+  }
+  hexPatchReset(HEX_PATCH_CAPACITY);
+  Text.modified = false;
+  editorSetStatusMessage("%lld bytes written to disk with %lld writes", (long long)count, (long long)writes);
+}
+
+// -----------------------------------------------------------------------------
+// the part of a struct stat a journal keeps, to tell later whether a file is still the one its edits were made to
+journalStamp journalStampOf(struct stat *info) {
+  return (journalStamp){ info->st_dev, info->st_ino, info->st_size, info->st_mtim.tv_sec, info->st_mtim.tv_nsec };
+}
+
+// -----------------------------------------------------------------------------
+// returns the name of the journal kept for filename - .name.journal in the same directory - for the caller to free
+char *journalPathFor(const char *filename) {
+  const char *slash = strrchr(filename, '/');
+  int directory = slash ? slash - filename + 1 : 0;
+  char *path = malloc(strlen(filename) + 10);
+  sprintf(path, "%.*s.%s.journal", directory, filename, &filename[directory]);
+  return path;
+}
+
+// -----------------------------------------------------------------------------
+// the function the journal thread runs - writes each batch of records it is handed and syncs it to the disk, so however many edits
+// there are in a batch, they cost one fdatasync() between them and the main thread never waits for it
+void *journalThread(void *unused) {
+  (void)unused;
+  pthread_mutex_lock(&Text.journal.lock);
+  while (true) {
+    while (!Text.journal.busy) pthread_cond_wait(&Text.journal.change, &Text.journal.lock);
+    pthread_mutex_unlock(&Text.journal.lock);
+    bool ok = writeAll(Text.journal.fd, Text.journal.writing, Text.journal.writingLength) && fdatasync(Text.journal.fd) == 0;
+    int error = errno;
+    pthread_mutex_lock(&Text.journal.lock);
+    if (!ok) Text.journal.error = error;
+    Text.journal.writingLength = 0;
+    Text.journal.busy = false;
+    pthread_cond_broadcast(&Text.journal.change);
+  }
+  return NULL;
+}
+
+// -----------------------------------------------------------------------------
+// hands the records made so far to the journal thread - at most once every JOURNAL_SYNC_MS while keys keep coming, and straight away 
+// once they stop (now), so an edit is on the disk within about that long of being made
+void journalCommit(bool now) {
+  if (Text.journal.pendingLength == 0) return;
+  struct timespec clock;
+  clock_gettime(CLOCK_MONOTONIC, &clock);
+  double seconds = clock.tv_sec + clock.tv_nsec / 1e9;
+  if (!now && seconds - Text.journal.lastCommit < JOURNAL_SYNC_MS / 1000.0) return;
+
+  int error = 0;
+  if (!Text.journal.started) {  // no thread to be had - write here instead, with the editor waiting for the disk
+    if (!writeAll(Text.journal.fd, Text.journal.pending, Text.journal.pendingLength) || fdatasync(Text.journal.fd) != 0)
+      error = errno;
+    Text.journal.pendingLength = 0;
+  } else {
+    pthread_mutex_lock(&Text.journal.lock);
+    if (!Text.journal.busy) {  // otherwise the thread is still writing the last batch - these records go with the next one
+      char *batch = Text.journal.writing;
+      size_t capacity = Text.journal.writingCapacity;
+      Text.journal.writing = Text.journal.pending;
+      Text.journal.writingLength = Text.journal.pendingLength;
+      Text.journal.writingCapacity = Text.journal.pendingCapacity;
+      Text.journal.pending = batch;  // the buffer the last batch was in is used again for the next one
+      Text.journal.pendingLength = 0;
+      Text.journal.pendingCapacity = capacity;
+      Text.journal.busy = true;
+      pthread_cond_broadcast(&Text.journal.change);
+    }
+    error = Text.journal.error;
+    Text.journal.error = 0;
+    pthread_mutex_unlock(&Text.journal.lock);
+  }
+  Text.journal.lastCommit = seconds;
+  if (error) editorSetStatusMessage("Can't write the journal! I/O error: %s", strerror(error));
+}
+
+// -----------------------------------------------------------------------------
+// waits for the journal thread to finish writing the batch it has
+void journalDrain() {
+  if (!Text.journal.started) return;
+  pthread_mutex_lock(&Text.journal.lock);
+  while (Text.journal.busy) pthread_cond_wait(&Text.journal.change, &Text.journal.lock);
+  pthread_mutex_unlock(&Text.journal.lock);
+}
+
+// -----------------------------------------------------------------------------
+// starts the journal for Text.filename, headed by the stamp of the file as it was last opened or saved - the edits in it are made to
+// that. Returns false if there can't be a journal.
+bool journalOpen() {
+  if (Text.filename == NULL || !Text.savedKnown) return false;  // nothing to make the edits to
+  if (Text.journal.path == NULL) Text.journal.path = journalPathFor(Text.filename);
+  int fd = open(Text.journal.path, O_WRONLY | O_CREAT | O_TRUNC, 0600);  // only the owner can read it, whatever the file's permissions
+  if (fd == -1) {
+    Text.journal.on = false;  // rather than trying again every keystroke
+    editorSetStatusMessage("Can't start the journal! I/O error: %s", strerror(errno));
+    return false;
+  }
+  Text.journal.fd = fd;
+  if (!Text.journal.started) Text.journal.started = (pthread_create(&Text.journal.thread, NULL, journalThread, NULL) == 0);
+
+  journalStamp stamp = journalStampOf(&Text.savedFile);
+  if (Text.journal.pendingCapacity < JOURNAL_HEADER_SIZE) {
+    Text.journal.pendingCapacity = JOURNAL_HEADER_SIZE;
+    Text.journal.pending = realloc(Text.journal.pending, Text.journal.pendingCapacity);
+  }
+  memcpy(Text.journal.pending, JOURNAL_MAGIC, 8);  // the header goes to the disk with the first batch of records
+  memcpy(&Text.journal.pending[8], &stamp, sizeof(stamp));
+  Text.journal.pendingLength = JOURNAL_HEADER_SIZE;
+  return true;
+}
+
+// -----------------------------------------------------------------------------
+// adds an edit to the journal - called by each of the functions that change the text, so it only copies the edit into memory. 
+// journalCommit() sees it gets to the disk.
+void journalRecord(int operation, int64_t row, int64_t column, const char *text, size_t length) {
+  if (!Text.journal.on || Text.journal.replaying) return;
+  if (Text.journal.fd == -1 && !journalOpen()) return;  // the first edit since the file was opened or saved starts a new journal
+
+  size_t needed = Text.journal.pendingLength + JOURNAL_RECORD_SIZE + length;
+  if (needed > Text.journal.pendingCapacity) {
+    while (needed > Text.journal.pendingCapacity) Text.journal.pendingCapacity = Text.journal.pendingCapacity ? Text.journal.pendingCapacity * 2 : 4096;
+    Text.journal.pending = realloc(Text.journal.pending, Text.journal.pendingCapacity);
+  }
+  char *record = &Text.journal.pending[Text.journal.pendingLength];
+  int64_t size = length;
+  record[0] = operation;
+  memcpy(&record[1], &row, 8);
+  memcpy(&record[9], &column, 8);
+  memcpy(&record[17], &size, 8);
+  if (length) memcpy(&record[JOURNAL_RECORD_SIZE], text, length);
+  Text.journal.pendingLength = needed;
+}
+
+// -----------------------------------------------------------------------------
+// throws the journal away, once the file holds every edit in it or the user has chosen to lose them
+void journalDiscard() {
+  if (Text.journal.fd == -1) return;
+  journalDrain();
+  close(Text.journal.fd);
+  unlink(Text.journal.path);
+  Text.journal.fd = -1;
+  Text.journal.pendingLength = 0;
+}
+
+// -----------------------------------------------------------------------------
+// makes an edit read back from the journal, the way it was made the first time - returns false if it can't have been made to this
+// text, which means the rest of the journal can't be trusted either
+bool journalReplay(int operation, int64_t row, int64_t column, char *text, int64_t length) {
+  switch (operation) {
+    case JOURNAL_INSERT_ROW:
+      if (row < 0 || row > Text.totalRows) return false;
+      editorInsertRow(row, text, length);
+      return true;
+    case JOURNAL_SNAPSHOT:
+    case JOURNAL_SAVED:
+    case JOURNAL_FOLLOWED:
+      return true;
+  }
+  if (row < 0 || row >= Text.totalRows) return false;
+  switch (operation) {
+    case JOURNAL_DELETE_ROW:
+      editorDelRow(row);
+      break;
+    case JOURNAL_INSERT_CHAR:
+      if (length != 1) return false;
+      editorRowInsertChar(editorRowForEdit(row), column, (byte)text[0]);
+      break;
+    case JOURNAL_DELETE_CHAR:
+      editorRowDelChar(editorRowForEdit(row), column);
+      break;
+    case JOURNAL_APPEND_STRING:
+      editorRowAppendString(editorRowForEdit(row), text, length);
+      break;
+    case JOURNAL_TRUNCATE_ROW:
+      editorRowTruncate(editorRowForEdit(row), column);
+      break;
+  }
+  return true;
+}
+
+// -----------------------------------------------------------------------------
+// makes the edits left in the journal of the file just opened, if the editor was killed before they were saved. They are made to the
+// file as it was when the journal was started, or as a save the journal recorded left it, or as either of those grew while it was
+// being followed - if the file is none of them, the journal is moved out of the way rather than applied to the wrong text.
+void editorJournalRecover() {
+  if (!Text.journal.on || Text.filename == NULL || !Text.savedKnown) return;
+  char *path = journalPathFor(Text.filename);
+  int fd = open(path, O_RDONLY);
+  struct stat info;
+  if (fd == -1 || fstat(fd, &info) == -1) {  // no journal - the last session ended cleanly
+    if (fd != -1) close(fd);
+    free(path);
+    return;
+  }
+  size_t size = 0;
+  char *data = malloc(info.st_size ? info.st_size : 1);
+  ssize_t n;
+  while (size < (size_t)info.st_size && (n = read(fd, &data[size], info.st_size - size)) > 0) size += n;
+  close(fd);
+
+  journalStamp file = journalStampOf(&Text.savedFile), stamp;
+  size_t from = 0,  // where the edits to make start - 0 until the journal turns out to fit the file
+         end = JOURNAL_HEADER_SIZE,  // where the last whole record ends - a crash can leave half of one after it
+         snapshot = JOURNAL_HEADER_SIZE,  // where the edits made after the last save's snapshot start
+         base = JOURNAL_HEADER_SIZE;  // where the edits to the file the last stamp was of start
+  bool valid = (size >= JOURNAL_HEADER_SIZE && !memcmp(data, JOURNAL_MAGIC, 8));
+  if (valid) {
+    memcpy(&stamp, &data[8], sizeof(stamp));
+    if (!memcmp(&stamp, &file, sizeof(stamp))) from = JOURNAL_HEADER_SIZE;
+  } else if (size < JOURNAL_HEADER_SIZE) {
+    from = JOURNAL_HEADER_SIZE;  // killed before the first batch was written - there is nothing in it
+  }
+  while (valid && size - end >= JOURNAL_RECORD_SIZE) {
+    int operation = (byte)data[end];
+    int64_t length;
+    memcpy(&length, &data[end + 17], 8);
+    if (operation < JOURNAL_INSERT_ROW || operation > JOURNAL_FOLLOWED || length < 0 || (size_t)length > size - end - JOURNAL_RECORD_SIZE) break;
+    size_t next = end + JOURNAL_RECORD_SIZE + length;
+    if (operation == JOURNAL_SNAPSHOT) snapshot = next;
+    if (operation == JOURNAL_SAVED) base = snapshot;  // the file that save left holds the edits before its snapshot
+    if ((operation == JOURNAL_SAVED || operation == JOURNAL_FOLLOWED) && length == sizeof(stamp)) {
+      memcpy(&stamp, &data[end + JOURNAL_RECORD_SIZE], sizeof(stamp));
+      if (!memcmp(&stamp, &file, sizeof(stamp))) from = base;  // the file is that one, so only the edits made to it count
+    }
+    end = next;
+  }
+
+  if (from == 0) {
+    char *aside = malloc(strlen(path) + 5);
+    sprintf(aside, "%s.old", path);
+    rename(path, aside);
+    editorSetStatusMessage("The journal doesn't fit the file - kept as %s", basename(aside));
+    free(aside);
+    free(path);
+    free(data);
+    return;
+  }
+
+  int64_t edits = 0;
+  if (from < end) editorIndexAll();  // the edits can be anywhere in the text
+  Text.journal.replaying = true;
+  for (size_t at = from; at < end; ) {
+    int operation = (byte)data[at];
+    int64_t row, column, length;
+    memcpy(&row, &data[at + 1], 8);
+    memcpy(&column, &data[at + 9], 8);
+    memcpy(&length, &data[at + 17], 8);
+    if (!journalReplay(operation, row, column, &data[at + JOURNAL_RECORD_SIZE], length)) {
+      end = at;
+      break;
+    }
+    if (operation < JOURNAL_SNAPSHOT) edits++;
+    at += JOURNAL_RECORD_SIZE + length;
+  }
+  Text.journal.replaying = false;
+  free(data);
+
+  if (edits == 0) {  // the file has every edit already
+    unlink(path);
+    free(path);
+    return;
+  }
+  Text.journal.path = path;  // carry on with the same journal, so it still holds these edits if the editor is killed again
+  Text.journal.fd = open(path, O_WRONLY | O_APPEND);
+  if (Text.journal.fd != -1 && ftruncate(Text.journal.fd, end) == 0) {
+    if (!Text.journal.started) Text.journal.started = (pthread_create(&Text.journal.thread, NULL, journalThread, NULL) == 0);
+  } else if (Text.journal.fd != -1) {
+    close(Text.journal.fd);
+    Text.journal.fd = -1;
+  }
+  editorSetStatusMessage("Recovered %lld unsaved edits from the journal", (long long)edits);
+}
+
+// -----------------------------------------------------------------------------
+// the way a file is compressed, from its first bytes - gzip and zstd both start with magic numbers
+int compressionOf(const unsigned char *magic, size_t length) {
+  if (length >= 2 && magic[0] == 0x1F && magic[1] == 0x8B) return COMPRESSION_GZIP;
+  if (length >= 4 && magic[0] == 0x28 && magic[1] == 0xB5 && magic[2] == 0x2F && magic[3] == 0xFD) return COMPRESSION_ZSTD;
+  return COMPRESSION_NONE;
+}
+
+// -----------------------------------------------------------------------------
+// the way a file that doesn't exist yet should be compressed, from the end of its name - returns the length of the name without that
+// end in *stem, if stem isn't NULL
+int compressionOfName(const char *filename, size_t *stem) {
+  size_t length = strlen(filename);
+  int format = COMPRESSION_NONE;
+  if (length > 3 && !strcmp(&filename[length - 3], ".gz")) format = COMPRESSION_GZIP;
+  if (length > 4 && !strcmp(&filename[length - 4], ".zst")) format = COMPRESSION_ZSTD;
+  if (stem) *stem = length - (format == COMPRESSION_GZIP ? 3 : format == COMPRESSION_ZSTD ? 4 : 0);
+  return format;
+}
+
+// -----------------------------------------------------------------------------
+// opens libzstd the first time a .zst file needs it - returns false if it can't be had
+bool zstdLoad() {
+  if (Zstd.tried) return Zstd.handle != NULL;
+  Zstd.tried = true;
+  Zstd.handle = dlopen("libzstd.so.1", RTLD_NOW | RTLD_LOCAL);
+  if (Zstd.handle == NULL) return false;
+  struct { void **function; const char *name; } symbols[] = {
+    { (void **)&Zstd.createCStream, "ZSTD_createCStream" },
+    { (void **)&Zstd.initCStream, "ZSTD_initCStream" },
+    { (void **)&Zstd.compressStream2, "ZSTD_compressStream2" },
+    { (void **)&Zstd.freeCStream, "ZSTD_freeCStream" },
+    { (void **)&Zstd.createDStream, "ZSTD_createDStream" },
+    { (void **)&Zstd.initDStream, "ZSTD_initDStream" },
+    { (void **)&Zstd.decompressStream, "ZSTD_decompressStream" },
+    { (void **)&Zstd.freeDStream, "ZSTD_freeDStream" },
+    { (void **)&Zstd.isError, "ZSTD_isError" },
+    { (void **)&Zstd.getErrorName, "ZSTD_getErrorName" },
+  };
+  for (size_t j = 0; j < sizeof(symbols) / sizeof(symbols[0]); j++) {
+    if ((*symbols[j].function = dlsym(Zstd.handle, symbols[j].name)) == NULL) {  // too old to have the streaming functions used here
+      dlclose(Zstd.handle);
+      Zstd.handle = NULL;
+      return false;
+    }
+  }
+  return true;
+}
+
+// -----------------------------------------------------------------------------
+// gets a stream ready to compress or decompress in the given format - returns false, with stream->error saying why, if it can't be
+bool codecStart(codec *stream, int format, bool compressing) {
+  memset(stream, 0, sizeof(*stream));
+  stream->format = format;
+  stream->compressing = compressing;
+  if (format == COMPRESSION_GZIP) {
+    int status = compressing ? deflateInit2(&stream->gzip, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY)  // + 16 
+                             : inflateInit2(&stream->gzip, 15 + 32);                                 // for a gzip header, + 32 to find it
+    if (status != Z_OK) {
+      stream->error = "zlib can't start";
+      return false;
+    }
+  } else {
+    if (!zstdLoad()) {
+      stream->error = "libzstd.so.1 can't be loaded";
+      return false;
+    }
+    stream->zstd = compressing ? Zstd.createCStream() : Zstd.createDStream();
+    if (stream->zstd == NULL || Zstd.isError(compressing ? Zstd.initCStream(stream->zstd, ZSTD_LEVEL) : Zstd.initDStream(stream->zstd))) {
+      if (stream->zstd) compressing ? Zstd.freeCStream(stream->zstd) : Zstd.freeDStream(stream->zstd);
+      stream->error = "libzstd can't start";
+      return false;
+    }
+  }
+  stream->output = malloc(CODEC_BUFFER_SIZE);
+  return true;
+}
+
+// -----------------------------------------------------------------------------
+// frees what a stream holds
+void codecEnd(codec *stream) {
+  if (stream->format == COMPRESSION_GZIP) stream->compressing ? deflateEnd(&stream->gzip) : inflateEnd(&stream->gzip);
+  else stream->compressing ? Zstd.freeCStream(stream->zstd) : Zstd.freeDStream(stream->zstd);
+  free(stream->output);
+  stream->output = NULL;
+}
+
+// -----------------------------------------------------------------------------
+// compresses length bytes of data, writing whatever comes out to fd and adding its length to *written - end finishes the stream off.
+// Returns false on an error, with errno set.
+bool codecCompress(codec *stream, int fd, const char *data, size_t length, bool end, size_t *written) {
+  if (stream->format == COMPRESSION_GZIP) {
+    stream->gzip.next_in = (Bytef *)data;
+    stream->gzip.avail_in = length;  // a part of a save batch is never anywhere near 4 GB
+    do {
+      stream->gzip.next_out = (Bytef *)stream->output;
+      stream->gzip.avail_out = CODEC_BUFFER_SIZE;
+      if (deflate(&stream->gzip, end ? Z_FINISH : Z_NO_FLUSH) == Z_STREAM_ERROR) {
+        errno = EIO;
+        return false;
+      }
+      size_t produced = CODEC_BUFFER_SIZE - stream->gzip.avail_out;
+      if (!writeAll(fd, stream->output, produced)) return false;
+      *written += produced;
+    } while (stream->gzip.avail_out == 0);  // the output was full, so there may be more of it
+    return true;
+  }
+
+  zstdBuffer input = { (void *)data, length, 0 };
+  size_t left;
+  do {
+    zstdBuffer output = { stream->output, CODEC_BUFFER_SIZE, 0 };
+    left = Zstd.compressStream2(stream->zstd, &output, &input, end ? 2 : 0);
+    if (Zstd.isError(left)) {
+      errno = EIO;
+      return false;
+    }
+    if (!writeAll(fd, stream->output, output.pos)) return false;
+    *written += output.pos;
+  } while (end ? left != 0 : input.pos < input.size);  // left is how much of the end is still to be written
+  return true;
+}
+
+// -----------------------------------------------------------------------------
+// decompresses length bytes of a compressed file into a pipe - ended says whether the last stream in the file was finished, so a
+// file that was cut short can be told from one that wasn't. Returns false, with stream->error saying why, on an error.
+bool codecDecompress(codec *stream, int pipe, char *data, size_t length, bool *ended) {
+  if (stream->format == COMPRESSION_GZIP) {
+    stream->gzip.next_in = (Bytef *)data;
+    stream->gzip.avail_in = length;
+    do {
+      stream->gzip.next_out = (Bytef *)stream->output;
+      stream->gzip.avail_out = CODEC_BUFFER_SIZE;
+      int status = inflate(&stream->gzip, Z_NO_FLUSH);
+      if (status != Z_OK && status != Z_STREAM_END && status != Z_BUF_ERROR) {
+        stream->error = stream->gzip.msg ? stream->gzip.msg : "the file isn't gzip";
+        return false;
+      }
+      if (!writeAll(pipe, stream->output, CODEC_BUFFER_SIZE - stream->gzip.avail_out)) {
+        stream->error = strerror(errno);
+        return false;
+      }
+      *ended = (status == Z_STREAM_END);
+      if (*ended) inflateReset(&stream->gzip);  // gzip files can be several streams one after another, as cat makes them
+    } while (stream->gzip.avail_in > 0 || stream->gzip.avail_out == 0);
+    return true;
+  }
+
+  zstdBuffer input = { data, length, 0 };
+  bool full;
+  do {
+    zstdBuffer output = { stream->output, CODEC_BUFFER_SIZE, 0 };
+    size_t hint = Zstd.decompressStream(stream->zstd, &output, &input);
+    if (Zstd.isError(hint)) {
+      stream->error = Zstd.getErrorName(hint);
+      return false;
+    }
+    if (!writeAll(pipe, stream->output, output.pos)) {
+      stream->error = strerror(errno);
+      return false;
+    }
+    *ended = (hint == 0);  // a frame just finished - libzstd carries on into the next one by itself
+    full = (output.pos == output.size);
+  } while (input.pos < input.size || full);
+  return true;
+}
+
+// -----------------------------------------------------------------------------
+// the function the decompressing thread runs - reads the compressed file and writes the text in it down the pipe, then closes the
+// pipe so editorOpen() sees the end of it
+void *decompressThread(void *argument) {
+  decompression *job = argument;
+  sigset_t pipeSignal;  // editorOpen() only stops reading early if it can't read, and then a write should just fail
+  sigemptyset(&pipeSignal);
+  sigaddset(&pipeSignal, SIGPIPE);
+  pthread_sigmask(SIG_BLOCK, &pipeSignal, NULL);
+
+  char *data = malloc(CODEC_BUFFER_SIZE);
+  bool ended = false;
+  ssize_t bytesRead;
+  while ((bytesRead = read(job->file, data, CODEC_BUFFER_SIZE)) != 0) {
+    if (bytesRead == -1 && errno == EINTR) continue;
+    if (bytesRead == -1) {
+      job->stream.error = strerror(errno);
+      break;
+    }
+    if (!codecDecompress(&job->stream, job->pipe, data, bytesRead, &ended)) break;
   }
-  editorRowInsertChar(&Text.row[Text.cursorYPosition], Text.cursorXPosition, c);  // insert the character (c) into the specific row of the row array
-  Text.cursorXPosition++;  // move the cursor forward so that the next character the user inserts will go after the character just inserted
+  if (job->stream.error == NULL && !ended) job->stream.error = "the file is cut short";
+  free(data);
+  close(job->pipe);
+  return NULL;
 }
 
 // -----------------------------------------------------------------------------
-//
-void editorInsertNewline() {
-  if (Text.cursorXPosition == 0) {  // if the cursor is at the beginning of a line
-    editorInsertRow(Text.cursorYPosition, "", 0);  // insert a new blank row before the line the cursor is on
-  } else {  // Otherwise, we have to split the line we’re on into two rows
-    textRow *row = &Text.row[Text.cursorYPosition];  // assign a new pointer to the address of the first character of the text that will be moved down a row
-    editorInsertRow(Text.cursorYPosition + 1, &row->characters[Text.cursorXPosition], row->length - Text.cursorXPosition); // insert the text pointed to by row into a new line - calls editorUpdateRow()
-    row = &Text.row[Text.cursorYPosition]; // reset row to the line that was truncated, because editorInsertRow() may have invalidated the pointer
-    row->length = Text.cursorXPosition;  // set the size equal to the x coordinate
-    row->characters[row->length] = '\0'; // add a null character to terminate the string in row->characters
-    editorUpdateRow(row);  // update the row that was truncated
+// starts decompressing the file in fd on a thread of its own, and returns the pipe the text comes out of, for editorOpen() to read
+// just as it reads a file that isn't compressed - the two go on at once. Returns NULL if it can't, with job->stream.error saying why.
+FILE *decompressStart(decompression *job, int fd, int format) {
+  int ends[2];
+  if (!codecStart(&job->stream, format, false)) return NULL;
+  if (pipe(ends) == -1) {
+    job->stream.error = strerror(errno);
+    codecEnd(&job->stream);
+    return NULL;
   }
-  Text.cursorYPosition++;    // move the cursor to the beginning of the new row
-  Text.cursorXPosition = 0;  // move the cursor to the beginning of the new row
+  fcntl(ends[1], F_SETPIPE_SZ, CODEC_BUFFER_SIZE);  // a megabyte at a time rather than the usual 64 KB, so there are fewer switches
+  job->file = fd;
+  job->pipe = ends[1];
+  if (pthread_create(&job->thread, NULL, decompressThread, job) != 0) {
+    job->stream.error = "no thread to be had";
+    close(ends[0]);
+    close(ends[1]);
+    codecEnd(&job->stream);
+    return NULL;
+  }
+  return fdopen(ends[0], "r");
 }
 
 // -----------------------------------------------------------------------------
-// use editorRowDelChar() to delete a character at the position that the cursor is at.
-void editorDelChar() {
-  if (Text.cursorYPosition == Text.totalRows) return;  // do nothing if the cursor is on the tilde line - If the cursor’s past the end of the file, then there is nothing to delete, and we return immediately
-  if (Text.cursorXPosition == 0 && Text.cursorYPosition == 0) return;  //do nothing if the cursor is at the beginning of the first line
+// closes the pipe editorOpen() read the text from, once it is at its end, and waits for the thread - returns what went wrong, or NULL
+const char *decompressFinish(decompression *job, FILE *input) {
+  fclose(input);
+  pthread_join(job->thread, NULL);
+  const char *error = job->stream.error;
+  codecEnd(&job->stream);
+  return error;
+}
 
-  // Otherwise, we get the textRow the cursor is on, and if there is a character to the left of the cursor, we delete it and move the cursor one to the left
-  textRow *row = &Text.row[Text.cursorYPosition];
-  if (Text.cursorXPosition > 0) {
-    editorRowDelChar(row, Text.cursorXPosition - 1);
-    Text.cursorXPosition--;
-  } else {  // if (Text.cursorXPosition == 0) - if the cursor is at the beginning of the line of text, append the entire line to the previous line and reduce the size of
-    Text.cursorXPosition = Text.row[Text.cursorYPosition - 1].length;  // move the x coordniate of the cursor to the end of the previous row (while staying in the same row)
-    editorRowAppendString(&Text.row[Text.cursorYPosition - 1], row->characters, row->length);  // Append the contents of the line the cursor is on to the contents of the line above it
-    editorDelRow(Text.cursorYPosition);  // delete the row the cursor is on
-    Text.cursorYPosition--;  // move the cursor up one row to the position where the two lines were joined
+// -----------------------------------------------------------------------------
+// opens Text.filename to follow it from offset, and watches it for writes, and for being moved, deleted or truncated
+bool editorFollowOpen(int64_t offset) {
+  Text.follow.fd = open(Text.filename, O_RDONLY | O_CLOEXEC);
+  if (Text.follow.fd == -1) return false;
+  Text.follow.fileWatch = inotify_add_watch(Text.follow.inotify, Text.filename, IN_MODIFY | IN_ATTRIB | IN_MOVE_SELF | IN_DELETE_SELF);
+  Text.follow.offset = Text.follow.end = offset;
+  Text.follow.partial = Text.follow.touched = false;
+  return true;
+}
+
+// -----------------------------------------------------------------------------
+// stops reading the file being followed, so the one now called Text.filename can be read instead
+void editorFollowClose() {
+  if (Text.follow.fd == -1) return;
+  if (Text.follow.fileWatch != -1) inotify_rm_watch(Text.follow.inotify, Text.follow.fileWatch);
+  close(Text.follow.fd);
+  Text.follow.fd = -1;
+  Text.follow.fileWatch = -1;
+}
+
+// -----------------------------------------------------------------------------
+// adds whatever has been written to the followed file since it was last read to the end of the text, through editorAppendRows() a 
+// buffer at a time, the way editorOpen() reads a file. An unfinished last line is added too, but taken out again and read over once
+// more of it has been written - unless it has been edited since, when the rest of the line is added after it instead.
+void editorFollowRead() {
+  struct stat info;
+  if (fstat(Text.follow.fd, &info) == -1 || info.st_size <= Text.follow.end) return;
+  if (Text.follow.partial && Text.follow.touched) {  // the user's row stays as it is
+    Text.follow.offset = Text.follow.end;
+    Text.follow.diverged = true;  // the file has it and the rest of it as one line
+  }
+  else if (Text.follow.partial) editorRemoveRow(Text.totalRows - 1);  // read again below, with the rest of it
+
+  size_t capacity = OPEN_READ_SIZE;
+  char *buffer = malloc(capacity);
+  size_t length = 0;  // bytes in the buffer - whole lines are taken out after every read, so this is the start of an unfinished line
+  ssize_t bytesRead;
+  int64_t at = Text.follow.offset;  // where the next read starts
+  while ((bytesRead = pread(Text.follow.fd, &buffer[length], capacity - length, at)) > 0) {
+    length += bytesRead;
+    at += bytesRead;
+    size_t used = editorAppendRows(buffer, length, false, ADD_BUFFER);
+    memmove(buffer, &buffer[used], length - used);
+    length -= used;
+    if (length == capacity) {  // a line longer than the buffer
+      capacity *= 2;
+      buffer = realloc(buffer, capacity);
+    }
   }
+  Text.follow.partial = (length > 0);
+  Text.follow.touched = false;
+  Text.follow.offset = at - length;
+  Text.follow.end = at;
+  if (length > 0) editorAppendRows(buffer, length, true, ADD_BUFFER);
+  free(buffer);
+  Text.version++;  // a save running now doesn't have these lines
 }
 
-/*** file i/o ***/
-// 8888888888 8888888 888      8888888888      8888888        d88P  .d88888b.  
-// 888          888   888      888               888         d88P  d88P" "Y88b 
-// 888          888   888      888               888        d88P   888     888 
-// 8888888      888   888      8888888           888       d88P    888     888 
-// 888          888   888      888               888      d88P     888     888 
-// 888          888   888      888               888     d88P      888     888 
-// 888          888   888      888               888    d88P       Y88b. .d88P 
-// 888        8888888 88888888 8888888888      8888888 d88P         "Y88888P"  
-                                                                                                                                                       
 // -----------------------------------------------------------------------------
-//
-char *editorRowsToString(int *buflen) {
-  int totlen = 0;
-  int j;
-  for (j = 0; j < Text.totalRows; j++)  // add up the lengths of each row of text, adding 1 to each one for the newline character we’ll add to the end of each line
-    totlen += Text.row[j].length + 1;
-  *buflen = totlen;  // save the total length into buflen, to tell the caller how long the string is
+// starts following Text.filename with inotify, from the end of what editorOpen() read of it
+void editorFollowStart() {
+  if (Text.compression != COMPRESSION_NONE) {
+    editorSetStatusMessage("Can't follow a compressed file");
+    return;
+  }
+  Text.follow.inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (Text.follow.inotify == -1) {
+    editorSetStatusMessage("Can't follow the file! inotify error: %s", strerror(errno));
+    return;
+  }
+  char *copy = strdup(Text.filename);
+  inotify_add_watch(Text.follow.inotify, dirname(copy), IN_CREATE | IN_MOVED_TO);  // a new file by the same name - the log was rotated
+  free(copy);
+  int64_t size = Text.savedKnown ? Text.savedFile.st_size : 0;
+  if (!editorFollowOpen(size)) {
+    editorSetStatusMessage("Can't follow the file! I/O error: %s", strerror(errno));
+    return;
+  }
+
+  char tail[4096];  // if the file doesn't end with a newline, its last line is read again once more of it is written
+  int64_t from = size;  // the start of that line
+  while (from > 0) {  // look back from the end of the file for the newline before it
+    int64_t chunk = from < (int64_t)sizeof(tail) ? from : (int64_t)sizeof(tail);
+    if (pread(Text.follow.fd, tail, chunk, from - chunk) != chunk) break;
+    char *newline = memrchr(tail, '\n', chunk);
+    if (from == size && newline == &tail[chunk - 1]) break;  // the file ends with one
+    if (newline) {
+      from -= chunk - (newline - tail + 1);
+      break;
+    }
+    from -= chunk;
+  }
+  Text.follow.partial = (from < size);
+  Text.follow.touched = false;  // the journal's edits, if it had any, were made before the file was followed
+  Text.follow.offset = from;
+  Text.follow.on = true;
+}
 
-  char *buf = malloc(totlen);  // allocate the required memory for the string
-  char *p = buf;  // set p to point at the same address as buf - this is so we increase the address p is pointing to as we copy characters while leaving buf point to the beginning address
-  for (j = 0; j < Text.totalRows; j++) {  // loop through the rows
-    memcpy(p, Text.row[j].characters, Text.row[j].length);  // memcpy() the contents of each row to the end of the buffer
-    p += Text.row[j].length;  // advance the address being pointed at by the p pointer by the qty of characters added to the string
-    *p = '\n';  // append a new line character after each row
-    p++;  // advance the address being pointed at by the pointer by one to account for the newline character
+// -----------------------------------------------------------------------------
+// called between keypresses - if inotify has seen the followed file change, adds what was written to it to the end of the text, 
+// scrolling with it if the cursor was on the last line. A file that was truncated is read again from the start, and one that was 
+// rotated (renamed, with a new file made in its place) is read to its end and then the new file is read. Neither drops the rows 
+// already read. Returns true if the file changed, so the screen needs drawing again.
+bool editorFollowCheck() {
+  if (!Text.follow.on) return false;
+  char events[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+  while (read(Text.follow.inotify, events, sizeof(events)) > 0) Text.follow.changed = true;  // what happened is worked out below
+  if (!Text.follow.changed || editorLoading() || Text.save.running) return false;  // a mapped file has to be all indexed before rows
+  Text.follow.changed = false;                                                       // are added after it, and a save may be writing it
+
+  int64_t before = Text.totalRows,
+          readTo = Text.follow.end;
+  bool atEnd = (Text.cursorYPosition >= Text.totalRows - 1);
+  struct stat info, now;
+  bool known = (Text.follow.fd != -1 && fstat(Text.follow.fd, &info) == 0);
+  bool truncated = (known && info.st_size < Text.follow.end);
+  if (truncated) {  // cut short - read it again from the start, leaving the rows already read as they are
+    Text.follow.offset = Text.follow.end = 0;
+    Text.follow.partial = false;
+  }
+  if (known) editorFollowRead();
+  bool rotated = (stat(Text.filename, &now) == 0 && (!known || now.st_ino != info.st_ino || now.st_dev != info.st_dev));
+  if (rotated) {
+    editorFollowClose();  // the old file has been read to its end, so the new one takes over from its start
+    if (editorFollowOpen(0)) editorFollowRead();
   }
 
-  return buf; // return the string - we expect the caller to free the memory
+  if (truncated || rotated) Text.follow.diverged = true;
+  if (!Text.follow.diverged && Text.follow.end != readTo && Text.journal.fd != -1 && fstat(Text.follow.fd, &info) == 0 &&
+      info.st_size == Text.follow.end) {  // a file still growing is stamped once the next check has read the rest of it
+    journalStamp stamp = journalStampOf(&info);  // the edits in the journal are to the file as it is now, with these lines in it
+    journalRecord(JOURNAL_FOLLOWED, 0, 0, (char *)&stamp, sizeof(stamp));
+  }
+  if (truncated || rotated) {
+    Text.savedKnown = false;  // the text isn't the file any more, so the next save has to write all of it
+    editorSetStatusMessage(rotated ? "The file was replaced - following the new one" : "The file was truncated - following it from the start");
+  } else if (Text.savedKnown && !Text.modified && fstat(Text.follow.fd, &info) == 0) {
+    Text.savedFile = info;  // the text is still just what the file holds
+  } else {
+    Text.savedKnown = false;
+  }
+  if (atEnd && Text.totalRows != before) {
+    Text.cursorYPosition += Text.totalRows - before;
+    Text.cursorXPosition = 0;
+  }
+  return true;
 }
 
 // -----------------------------------------------------------------------------
-// for opening and reading a file from disk
-void editorOpen(char *filename) {
-  free(Text.filename);
-  Text.filename = strdup(filename);
+// picks up following the file from the end of what a save just wrote to it - the save's own writes aren't new lines
+void editorFollowSaved(size_t written) {
+  if (!Text.follow.on) return;
+  char events[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+  while (read(Text.follow.inotify, events, sizeof(events)) > 0) continue;
+  editorFollowClose();
+  editorFollowOpen(written);
+  Text.follow.changed = false;
+  Text.follow.diverged = false;  // the file is the text again
+}
 
-  editorSelectSyntaxHighlight();
+// -----------------------------------------------------------------------------
+// reads the text coming down the pipe in fd from now on, without ever waiting for it - standard input has already been given back to
+// the terminal
+void editorStreamStart(int fd) {
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+  Text.stream.fd = fd;
+  Text.stream.capacity = OPEN_READ_SIZE;
+  Text.stream.buffer = malloc(Text.stream.capacity);
+  Text.stream.length = 0;
+  Text.stream.on = true;
+  while (Text.totalRows <= Text.screenRows && editorStreamRead()) continue;  // whatever is there already, up to a screen of it
+}
 
-  FILE *fp = fopen(filename, "r");
-  if (!fp) die("fopen");
+// -----------------------------------------------------------------------------
+// adds what has come down the pipe since the last call to the end of the text, up to the buffer's worth - returns false if nothing
+// had. A save may be writing the rows, so nothing is added while one runs.
+bool editorStreamRead() {
+  if (!Text.stream.on || Text.save.running) return false;
+  ssize_t bytesRead = read(Text.stream.fd, &Text.stream.buffer[Text.stream.length], Text.stream.capacity - Text.stream.length);
+  if (bytesRead == -1 && (errno == EAGAIN || errno == EINTR)) return false;
+
+  int64_t first = Text.totalRows;
+  bool atEnd = (bytesRead <= 0);  // the end of the stream, or an error that ends it
+  if (!atEnd) Text.stream.length += bytesRead;
+  Text.arena.open = true;  // the rows go into the load arena, like the rows of a file
+  size_t used = editorAppendRows(Text.stream.buffer, Text.stream.length, atEnd, ORIGINAL_BUFFER);
+  Text.arena.open = false;
+  memmove(Text.stream.buffer, &Text.stream.buffer[used], Text.stream.length - used);
+  Text.stream.length -= used;
+  if (Text.stream.length == Text.stream.capacity) {  // a line longer than the buffer
+    Text.stream.capacity *= 2;
+    Text.stream.buffer = realloc(Text.stream.buffer, Text.stream.capacity);
+  }
 
-  char *line = NULL;
-  size_t linecap = 0;
-  ssize_t linelen;
-  while ((linelen = getline(&line, &linecap, fp)) != -1) {
-    while (linelen > 0 && (line[linelen - 1] == '\n' || 
-                           line[linelen - 1] == '\r'))
-      linelen--;
-    editorInsertRow(Text.totalRows, line, linelen);
+  if (Text.filename && Text.totalRows > first) {  // the text was saved as a file that doesn't have these lines
+    for (int64_t at = first; at < Text.totalRows; at++) {
+      textRow *row = editorRowAt(at);
+      journalRecord(JOURNAL_INSERT_ROW, at, 0, row->characters, row->length);
+    }
+    Text.modified = true;
+    Text.version++;
+    editorMarkDirty(first);
   }
-  free(line);
-  fclose(fp);
-  Text.modified = false;  // reset the modified flag
+  if (atEnd) {
+    if (bytesRead == -1) editorSetStatusMessage("Can't read standard input! I/O error: %s", strerror(errno));
+    close(Text.stream.fd);
+    free(Text.stream.buffer);
+    Text.stream.buffer = NULL;
+    Text.stream.fd = -1;
+    Text.stream.on = false;
+  }
+  return true;
+}
+
+// -----------------------------------------------------------------------------
+// returns where the line of a file starting at offset at ends, and puts its length without its newline in *length
+int64_t reloadLineEnd(const char *base, int64_t size, int64_t at, int64_t *length) {
+  const char *newline = memchr(&base[at], '\n', size - at);
+  int64_t end = newline ? newline - base : size;
+  *length = end - at;
+  while (*length > 0 && base[at + *length - 1] == '\r') {
+    (*length)--;
+    Text.carriageReturns = true;
+  }
+  return end;
+}
+
+// -----------------------------------------------------------------------------
+// reads the file again after something else changed it. The new file is cut into chunks the way it was when it was opened, and a
+// chunk that is still in it keeps its rows, highlighting and all - only the lines of the chunks that are new are made into rows. The 
+// cursor and the scroll stay on the lines they were on. Edits made since the file was opened are lost, but the chunks before the first
+// of them are still kept.
+void editorReload() {
+  if (Text.filename == NULL) return;
+  if (Text.follow.on || Text.stream.on) {
+    editorSetStatusMessage("Lines are still being added to the text as they come");
+    return;
+  }
+  int fd = open(Text.filename, O_RDONLY);
+  struct stat info;
+  if (fd == -1 || fstat(fd, &info) != 0) {
+    editorSetStatusMessage("Can't reload! I/O error: %s", strerror(errno));
+    if (fd != -1) close(fd);
+    return;
+  }
+  int64_t cursorY = Text.cursorYPosition,
+          offset = Text.rowOffset;
+
+  bool underMapping = (Text.map.base && (int64_t)info.st_dev == Text.map.device && (int64_t)info.st_ino == Text.map.inode);
+  if (underMapping || Text.compression != COMPRESSION_NONE) {  // changed under the mapping, so no line of it can be trusted, or its
+    close(fd);                                                  // lines can only be had by decompressing all of it - open it again
+    char *filename = strdup(Text.filename);
+    const char *error = editorOpen(filename);
+    free(filename);
+    while (editorLoading() && Text.totalRows <= (cursorY > offset + Text.screenRows ? cursorY : offset + Text.screenRows))
+      editorIndexMore(INDEX_STEP);
+    Text.version++;
+    journalDiscard();
+    if (error) editorSetStatusMessage("Reloaded, but can't decompress all of the file! %s", error);
+    else editorSetStatusMessage(underMapping ? "Reloaded - the file was changed where it was mapped, so all of it was read again"
+                                             : "Reloaded - the file is compressed, so all of it was read again");
+  } else {
+    editorIndexAll();
+    chunkList *old = &Text.reload.loaded;
+    for (int64_t slot = 0; Text.map.base && !Text.reload.known && slot < Text.rows.originalRows; slot++) {  // the mapping still holds the file as it was
+      char *text;                                                                        // opened, as it isn't the file that changed
+      int64_t length;
+      editorLineSpan(slot, &text, &length);
+      chunkAddLine(old, text, length);
+    }
+    chunkFinish(old);
+    size_t size = info.st_size;
+    char *base = size ? mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0) : NULL;
+    close(fd);
+    if (base == MAP_FAILED) {
+      editorSetStatusMessage("Can't reload! I/O error: %s", strerror(errno));
+      return;
+    }
+
+    chunkList fresh = { 0 };  // the chunks of the file as it is now
+    int64_t *starts = NULL,  // where the first line of each of them starts in the file
+            startCapacity = 0;
+    for (int64_t at = 0, end, length; at < (int64_t)size; at = end + 1) {
+      if (fresh.rows == 0) {
+        if (fresh.count == startCapacity) {
+          startCapacity = startCapacity ? startCapacity * 2 : 64;
+          starts = realloc(starts, sizeof(int64_t) * startCapacity);
+        }
+        starts[fresh.count] = at;
+      }
+      end = reloadLineEnd(base, size, at, &length);
+      chunkAddLine(&fresh, &base[at], length);
+    }
+    chunkFinish(&fresh);
+
+    int64_t usable = 0;  // the chunks before the first edit - the rows of these are still what was loaded, at the same positions
+    while (usable < old->count && old->chunks[usable].start + old->chunks[usable].rows <= Text.reload.changedFrom) usable++;
+    int64_t buckets = 1;
+    while (buckets < usable * 2) buckets *= 2;
+    int64_t *head = malloc(sizeof(int64_t) * buckets),  // the old chunks by hash, each bucket in order of position
+            *next = malloc(sizeof(int64_t) * (usable + 1));
+    for (int64_t b = 0; b < buckets; b++) head[b] = -1;
+    for (int64_t k = usable - 1; k >= 0; k--) {
+      int64_t b = old->chunks[k].hash & (buckets - 1);
+      next[k] = head[b];
+      head[b] = k;
+    }
+
+    int64_t at = 0,  // the position in the text of the next old chunk not yet matched
+            after = 0,  // and that chunk
+            changed = 0,
+            newY = cursorY,
+            newOffset = offset;
+    for (int64_t i = 0; i < fresh.count; i++) {
+      textChunk *chunk = &fresh.chunks[i];
+      int64_t *bucket = &head[chunk->hash & (buckets - 1)];
+      while (*bucket != -1 && *bucket < after) *bucket = next[*bucket];  // chunks before the last match can never match again
+      int64_t k = *bucket;
+      while (k != -1 && (old->chunks[k].hash != chunk->hash || old->chunks[k].rows != chunk->rows)) k = next[k];
+
+      if (k == -1) {  // a new chunk - its lines are made into rows
+        if (at > 0 && Text.syntax && Text.syntax->blockCommentStart) editorRowAt(at - 1);  // it highlights from the row before it
+        int64_t line = starts[i], length;
+        for (int64_t n = 0; n < chunk->rows; n++) {
+          int64_t end = reloadLineEnd(base, size, line, &length);
+          editorPlaceRow(at++, &base[line], length);
+          line = end + 1;
+        }
+        changed++;
+        continue;
+      }
+
+      int64_t gone = old->chunks[k].start - old->chunks[after].start;
+      for (int64_t n = 0; n < gone; n++) editorRemoveRow(at);  // the old chunks skipped over aren't in the file any more
+      textRow *row = (gone > 0) ? editorRowIfMade(at) : NULL;
+      if (row) editorUpdateSyntax(row);  // the rows before it changed, so it may start in a comment now, or not
+      if (cursorY >= old->chunks[k].start) newY = at + cursorY - old->chunks[k].start;  // the chunk the lines are on, or the last one
+      if (offset >= old->chunks[k].start) newOffset = at + offset - old->chunks[k].start;  // before them
+      at += chunk->rows;
+      after = k + 1;
+    }
+    while (Text.totalRows > at) editorRemoveRow(Text.totalRows - 1);  // whatever was after the last chunk that matched
+    free(head);
+    free(next);
+    free(starts);
+    if (base) munmap(base, size);
+
+    editorSetStatusMessage("Reloaded - %lld of %lld chunks changed", (long long)changed, (long long)fresh.count);
+    chunkFree(old);
+    Text.reload.loaded = fresh;
+    Text.reload.known = true;
+    Text.reload.changedFrom = INT64_MAX;
+    Text.modified = false;
+    Text.dirtyFrom = INT64_MAX;
+    Text.savedFile = info;
+    Text.savedKnown = true;
+    Text.version++;
+    journalDiscard();  // the edits it holds were made to the text that was just thrown away
+    cursorY = newY;
+    offset = newOffset;
+  }
+
+  Text.cursorYPosition = cursorY < Text.totalRows ? cursorY : Text.totalRows;
+  Text.rowOffset = offset < Text.cursorYPosition ? offset : Text.cursorYPosition;
+  textRow *row = (Text.cursorYPosition < Text.totalRows) ? editorRowAt(Text.cursorYPosition) : NULL;
+  int64_t length = row ? row->length : 0;
+  if (Text.cursorXPosition > length) Text.cursorXPosition = length;
+}
+
+// -----------------------------------------------------------------------------
+// looks at the file every RELOAD_CHECK_MS while nobody is typing, in case something else changed it. If the text hasn't been edited
+// it is reloaded straight away, otherwise the user is told once, and can reload it with Ctrl-R. Returns true if the screen changed.
+bool editorReloadCheck() {
+  if (Text.filename == NULL || !Text.savedKnown || Text.save.running || Text.follow.on || Text.stream.on || editorLoading()) return false;
+  struct timespec clock;
+  clock_gettime(CLOCK_MONOTONIC, &clock);
+  double seconds = clock.tv_sec + clock.tv_nsec / 1e9;
+  if (seconds - Text.reload.lastCheck < RELOAD_CHECK_MS / 1000.0) return false;
+  Text.reload.lastCheck = seconds;
+
+  struct stat info;
+  if (stat(Text.filename, &info) != 0) return false;  // gone - perhaps just for a moment, while it is replaced
+  journalStamp now = journalStampOf(&info),
+               saved = journalStampOf(&Text.savedFile);
+  if (memcmp(&now, &saved, sizeof(now)) == 0) return false;
+  if (!Text.modified) {
+    editorReload();
+    return true;
+  }
+  if (memcmp(&now, &Text.reload.noticed, sizeof(now)) == 0) return false;
+  Text.reload.noticed = now;
+  editorSetStatusMessage("The file changed on disk - Ctrl-R reloads it, losing your edits");
+  return true;
+}
+
+// -----------------------------------------------------------------------------
+// called between keypresses - if a mapped file was found truncated while it was read (see editorMappingFault()), what was past its
+// new end reads as zeros. If the text hasn't been edited it is reloaded straight away, otherwise the user is told, and can reload it
+// with Ctrl-R. The hex view is mapped again at the file's new size. Returns true if the screen changed.
+bool editorMappingCheck() {
+  if (Text.hex.cutShort) {
+    Text.hex.cutShort = false;
+    if (hexRemap()) editorSetStatusMessage("The file was cut short to %lld bytes - changes past its end are dropped", (long long)Text.hex.size);
+    else editorSetStatusMessage("The file was cut short, and can't be mapped again! I/O error: %s", strerror(errno));
+    return true;
+  }
+  if (!Text.map.cutShort || Text.save.running) return false;  // a save may still be reading the mapping
+  Text.map.cutShort = false;
+  if (!Text.modified) editorReload();
+  else editorSetStatusMessage("The file was cut short under the text - Ctrl-R reloads it, losing your edits");
+  return true;
+}
+
+// -----------------------------------------------------------------------------
+// makes an empty file next to filename to save into, owned like filename and with the same permissions - or the ones a new file 
+// would get, if there is no filename yet. Returns its fd and puts its name in *temporary for the caller to free, or returns -1 with
+// errno set.
+int saveCreateTemporary(const char *filename, char **temporary) {
+  *temporary = malloc(strlen(filename) + 8);
+  sprintf(*temporary, "%s.XXXXXX", filename);
+  int fd = mkstemp(*temporary);  // mkstemp() makes a file only we can read
+  if (fd == -1) return -1;
+
+  struct stat info;
+  if (stat(filename, &info) == 0) {
+    if (fchown(fd, info.st_uid, info.st_gid) == -1 && fchown(fd, -1, info.st_gid) == -1) {
+      // somebody else's file - only root can give the new one away, so it ends up ours
+    }
+    fchmod(fd, info.st_mode & 07777);  // after fchown(), which clears the set-user-ID and set-group-ID bits
+  } else {
+    mode_t mask = umask(0);  // the only way to read the umask is to set it
+    umask(mask);
+    fchmod(fd, 0644 & ~mask);  // what open() with O_CREAT and 0644 would have made
+  }
+  return fd;
+}
+
+// -----------------------------------------------------------------------------
+// flushes the directory holding filename to disk, so a file renamed into it stays renamed after a crash - returns false on an error, 
+// with errno set
+bool saveSyncDirectory(const char *filename) {
+  char *copy = strdup(filename);  // dirname() may change the string it is given
+  int fd = open(dirname(copy), O_RDONLY | O_DIRECTORY);
+  free(copy);
+  if (fd == -1) return false;
+  bool ok = (fsync(fd) == 0);
+  int error = errno;
+  close(fd);
+  errno = error;
+  return ok;
+}
+
+// -----------------------------------------------------------------------------
+// saves the text with writeRows() (editorWriteRows() or editorWriteSnapshot()) by writing it to a new file next to filename and 
+// renaming that over it. The data reaches the disk before the rename, and the rename before this returns, so after a crash filename 
+// holds either the old text or the new, never part of either. Puts the size of the file in *len, and returns false on an error, with 
+// errno set and filename untouched.
+bool editorSaveAtomic(const char *filename, bool (*writeRows)(int, size_t *), size_t *len) {
+  char *temporary;
+  int fd = saveCreateTemporary(filename, &temporary);
+  bool ok = (fd != -1 &&
+             writeRows(fd, len) &&
+             fdatasync(fd) != -1 &&
+             rename(temporary, filename) != -1);
+  int error = errno;
+  if (fd != -1) close(fd);
+  if (!ok && fd != -1) unlink(temporary);  // if mkstemp() failed, the name may be somebody else's file
+  free(temporary);
+  if (ok) ok = saveSyncDirectory(filename);
+  else errno = error;
+  return ok;
+}
+
+// -----------------------------------------------------------------------------
+// saves the text with writeRows() by writing it over filename, then cutting off whatever was left of the old text after it - quicker
+// than editorSaveAtomic(), but a crash part way through leaves a mixture of the two. Puts the size of the file in *len, and returns 
+// false on an error, with errno set.
+bool editorSaveInPlace(const char *filename, bool (*writeRows)(int, size_t *), size_t *len) {
+  int fd = open(filename, O_WRONLY | O_CREAT, 0644);  // create a new file if it doesn’t already exist (O_CREAT) - 0644 is the standard permissions you usually want for text files
+  if (fd == -1) return false;
+  bool ok = (writeRows(fd, len) &&  // stream the rows to the file referenced by fd
+             ftruncate(fd, *len) != -1);  // sets the file’s size to the length written
+  int error = errno;
+  close(fd);
+  errno = error;
+  return ok;
+}
+
+// -----------------------------------------------------------------------------
+// saves the snapshot by rewriting only the end of filename, from the first row edited since it was last opened or saved - the rows
+// before that are already there. Only done if the file is just as it was left, and the end is no more than 1 / TAIL_SAVE_SHARE of it,
+// as a small edit near the top of a big file gains nothing from it. Returns the offset the rewrite started at, with the size of the
+// file in *len, -1 if the whole file has to be written instead, or -2 on an error part way through, with errno set.
+int64_t editorSaveTail(const char *filename, size_t *len) {
+  if (!Text.save.tailAllowed) return -1;
+  int fd = open(filename, O_WRONLY);
+  struct stat now;
+  if (fd == -1) return -1;
+  if (fstat(fd, &now) == -1 || now.st_dev != Text.save.file.st_dev || now.st_ino != Text.save.file.st_ino ||
+      now.st_size != Text.save.file.st_size || now.st_mtim.tv_sec != Text.save.file.st_mtim.tv_sec ||
+      now.st_mtim.tv_nsec != Text.save.file.st_mtim.tv_nsec) {  // changed by something else since - it can't be trusted
+    close(fd);
+    return -1;
+  }
+
+  int64_t from = (Text.save.dirtyFrom < Text.save.rowCount) ? Text.save.dirtyFrom : Text.save.rowCount;
+  int64_t offset = 0, done = 0;
+  pthread_mutex_lock(&Text.save.lock);  // the rows before the edit are the bytes before the offset, a newline after each
+  for (int64_t r = 0; r < Text.save.runCount && done < from; r++) {
+    pieceRun *run = &Text.save.runs[r];
+    for (int64_t k = 0; k < run->count && done < from; k++, done++) offset += madeRow(run->source, run->start + k)->length + 1;
+  }
+  pthread_mutex_unlock(&Text.save.lock);
+  if (offset > now.st_size || now.st_size - offset > now.st_size / TAIL_SAVE_SHARE) {
+    close(fd);
+    return -1;
+  }
+
+  size_t written = 0;
+  bool ok = (lseek(fd, offset, SEEK_SET) != -1 &&
+             editorWriteSnapshotFrom(fd, from, &written) &&
+             ftruncate(fd, offset + written) != -1);
+  int error = errno;
+  close(fd);
+  errno = error;
+  *len = offset + written;
+  return ok ? offset : -2;
+}
+
+// -----------------------------------------------------------------------------
+// the function the save thread runs - writes the snapshot to the file, and tells the main thread how it went
+void *editorSaveThread(void *unused) {
+  (void)unused;
+  size_t written = 0;
+  int64_t tailFrom = editorSaveTail(Text.save.filename, &written);
+  bool ok = (tailFrom >= 0);
+  if (tailFrom == -1)
+    ok = Text.save.atomic ? editorSaveAtomic(Text.save.filename, editorWriteSnapshot, &written)
+                          : editorSaveInPlace(Text.save.filename, editorWriteSnapshot, &written);
+  int error = errno;
+  struct stat file;
+  bool known = ok && stat(Text.save.filename, &file) == 0;  // what the file looks like now, for the next save to check
+  pthread_mutex_lock(&Text.save.lock);
+  Text.save.ok = ok;
+  Text.save.error = error;
+  Text.save.written = written;
+  Text.save.tailFrom = tailFrom;
+  Text.save.fileKnown = known;
+  if (known) Text.save.file = file;
+  Text.save.rowsDone = Text.save.rowCount;
+  Text.save.done = true;
+  pthread_mutex_unlock(&Text.save.lock);
+  return NULL;
+}
+
+// -----------------------------------------------------------------------------
+// copies the pieces of the text for the save thread to write. Only the pieces are copied, not the rows: the rows they name are left 
+// alone until the save is over, because editorRowForEdit() copies a row before it is edited and editorDelRow() leaves it to the save 
+// to free.
+void editorSaveSnapshot() {
+  int64_t count = 0;
+  for (piece *run = pieceFirst(); run; run = pieceNext(run)) count++;
+  Text.save.runs = malloc(sizeof(pieceRun) * (count ? count : 1));
+  Text.save.runCount = 0;
+  for (piece *run = pieceFirst(); run; run = pieceNext(run))
+    Text.save.runs[Text.save.runCount++] = (pieceRun){ run->source, run->start, run->count };
+  Text.save.originalRows = Text.rows.originalRows;
+  Text.save.addRows = Text.rows.addRows;
+  Text.save.rowCount = Text.totalRows;
+  Text.save.rowsDone = 0;
+  Text.save.version = Text.version;
+  Text.save.dirtyFrom = Text.dirtyFrom;  // the file will hold the snapshot, so edits from here on are measured against that
+  Text.dirtyFrom = INT64_MAX;
+  Text.save.retiredCount = 0;
+  if (Text.journal.fd != -1) journalRecord(JOURNAL_SNAPSHOT, 0, 0, NULL, 0);  // if the save works, a recovery only needs the edits after this
+}
+
+// -----------------------------------------------------------------------------
+// tidies up after the save thread has finished - frees the rows that were kept for it, and says how it went. The text is only 
+// unmodified if it wasn't edited while it was being saved.
+void editorSaveFinish() {
+  if (Text.save.threaded) pthread_join(Text.save.thread, NULL);
+  Text.save.running = false;
+  for (int64_t j = 0; j < Text.save.retiredCount; j++) editorFreeRow(Text.save.retired[j]);
+  Text.save.retiredCount = 0;
+  free(Text.save.runs);
+  Text.save.runs = NULL;
+  free(Text.save.filename);
+  Text.save.filename = NULL;
+
+  Text.savedKnown = Text.save.fileKnown;  // a failed save may have left the file half written, so the next one writes all of it
+  Text.savedFile = Text.save.file;
+  if (Text.save.ok && Text.save.fileKnown && Text.journal.fd != -1) {
+    journalStamp stamp = journalStampOf(&Text.save.file);
+    if (Text.version == Text.save.version) journalDiscard();  // nothing was edited while the save ran, so the file has every edit
+    else journalRecord(JOURNAL_SAVED, 0, 0, (char *)&stamp, sizeof(stamp));
+  }
+  if (Text.save.ok) {
+    if (Text.save.tailFrom < 0) Text.carriageReturns = false;  // every line of the file ends in just \n now
+    editorFollowSaved(Text.save.written);
+    Text.modified = (Text.version != Text.save.version);
+    if (Text.save.tailFrom >= 0)
+      editorSetStatusMessage("%zu bytes written to disk (only the last %zu rewritten)", Text.save.written,
+                             Text.save.written - (size_t)Text.save.tailFrom);
+    else
+      editorSetStatusMessage("%zu bytes written to disk", Text.save.written);
+  } else {
+    if (Text.save.dirtyFrom < Text.dirtyFrom) Text.dirtyFrom = Text.save.dirtyFrom;
+    editorSetStatusMessage("Can't save! I/O error: %s", strerror(Text.save.error));
+  }
+}
+
+// -----------------------------------------------------------------------------
+// shows how far the save has got on the status bar, or finishes with it if it is done - called by the main thread, holding the lock
+void editorSaveProgress() {
+  if (!Text.save.running) return;
+  if (Text.save.done) {
+    editorSaveFinish();
+    return;
+  }
+  editorSetStatusMessage("Saving... %lld%%", Text.save.rowCount ? (long long)(Text.save.rowsDone * 100 / Text.save.rowCount) : 0LL);
+}
+
+// -----------------------------------------------------------------------------
+// waits for the save running in the background to finish, then finishes with it
+void editorSaveWait() {
+  if (!Text.save.running) return;
+  pthread_mutex_unlock(&Text.save.lock);
+  if (Text.save.threaded) pthread_join(Text.save.thread, NULL);
+  Text.save.threaded = false;  // joined already
+  pthread_mutex_lock(&Text.save.lock);
+  editorSaveFinish();
 }
 
 // -----------------------------------------------------------------------------
-// saves the current text on the screen to the file with error handling
+// true if the next save will write a new file and rename it over the old one, rather than overwrite the old one
+bool editorSavesAtomically() {
+  return Text.atomicSave || Text.map.base ||  // lines that were never made into rows are copied from the mapped file as it is written,
+         Text.compression;                    // so it can't be overwritten - it stays mapped until it is closed. And a compressed file
+}                                             // can only be written from its start.
+
+// -----------------------------------------------------------------------------
+// saves the current text on the screen to the file with error handling. The text is written by a thread of its own, from a snapshot,
+// so a big file doesn't freeze the editor - see editorReadKey() for how the two share the rows.
 void editorSave() {
+  if (Text.save.running) {
+    editorSetStatusMessage("Still saving - wait for it to finish");
+    return;
+  }
   if (Text.filename == NULL) {
     Text.filename = editorPrompt("Save as: %s (ESC x 3 to cancel)", NULL);
     if (Text.filename == NULL) {  // pressing ESC causes editorPrompt to return NULL
@@ -813,27 +4253,27 @@ void editorSave() {
       return;
     }
     editorSelectSyntaxHighlight();
+    Text.compression = compressionOfName(Text.filename, NULL);  // a new file is compressed if its name says so
   }
 
-  int len;
-  char *buf = editorRowsToString(&len);  // converts the contents of rows array into one continuos string
-
-  int fd = open(Text.filename, O_RDWR | O_CREAT, 0644);  // create a new file if it doesn’t already exist (O_CREAT), and we want to open it for reading and writing (O_RDWR) - 0644 is the standard permissions you usually want for text files
-  if (fd != -1) {
-    if (ftruncate(fd, len) != -1) {  // sets the file’s size to the specified length
-      if (write(fd, buf, len) == len) {  // write the contents of buf to the file referenced by fd
-        close(fd);
-        free(buf);
-        Text.modified = false;
-        editorSetStatusMessage("%d bytes written to disk", len);
-        return;
-      }
-    }
-    close(fd);
+  editorIndexAll();  // the whole of a mapped file has to be in the text before it is written
+  Text.save.compression = Text.compression;
+  Text.save.atomic = editorSavesAtomically();
+  char *target = Text.save.atomic ? realpath(Text.filename, NULL) : NULL;  // save over the file a symbolic link points at, not the link
+  Text.save.filename = target ? target : strdup(Text.filename);
+  Text.save.tailAllowed = (!Text.save.atomic && Text.savedKnown &&  // a tail rewrite is done in place, so it is never atomic
+                           !Text.carriageReturns);
+  Text.save.file = Text.savedFile;
+  editorSaveSnapshot();
+  Text.save.done = false;
+  Text.save.running = true;
+  Text.save.threaded = (pthread_create(&Text.save.thread, NULL, editorSaveThread, NULL) == 0);
+  if (!Text.save.threaded) {  // no thread to be had - save here instead, with the editor waiting the way it used to
+    pthread_mutex_unlock(&Text.save.lock);
+    editorSaveThread(NULL);
+    pthread_mutex_lock(&Text.save.lock);
   }
-
-  free(buf);
-  editorSetStatusMessage("Can't save! I/O error: %s", strerror(errno));
+  editorSaveProgress();
 }
 
 /*** find ***/
@@ -849,14 +4289,20 @@ void editorSave() {
 // -----------------------------------------------------------------------------
 //
 void editorFindCallback(char *query, int key) {
-  static int last_match = -1;
+  static int64_t last_match = -1;
   static int direction = 1;
 
-  static int saved_hl_line;  // static variable to know which line’s hl needs to be restored
+  static int64_t saved_hl_line;  // static variable to know which line’s hl needs to be restored
   static char *saved_hl = NULL;  // dynamically allocated array which points to NULL when there is nothing to restore
+  static int64_t saved_hl_length;  // the length of the line's display when its hl was saved
 
   if (saved_hl) {  // if there is something to restore
-    memcpy(Text.row[saved_hl_line].textColor, saved_hl, Text.row[saved_hl_line].displayLength);  // memcpy it to the saved line’s hl
+    textRow *saved_row = saved_hl_line < Text.totalRows ? editorRowAt(saved_hl_line) : NULL;  // the line may be gone if the text changed since
+    if (saved_row && saved_row->textColor) {  // a row the pager let go of since is read again without the match's colors
+      int64_t length = saved_hl_length < saved_row->displayLength ? saved_hl_length : saved_row->displayLength;  // or shorter
+      memcpy(saved_row->textColor, saved_hl, length);  // memcpy it to the saved line’s hl
+    }
+    if (saved_row && Text.syntax == NULL) editorUpdateSyntax(saved_row);  // the colors were only there for the match - drop them again
     free(saved_hl);  // deallocate saved_hl
     saved_hl = NULL;  // set it back to NULL - so we won't have a dangling pointer
   }
@@ -876,15 +4322,25 @@ void editorFindCallback(char *query, int key) {
 
   // Otherwise, after any other keypress, we do another search for the current query string
   if (last_match == -1) direction = 1;
-  int current = last_match;  // current is the index of the current row we are searching
-  int i;
+  int64_t current = last_match;  // current is the index of the current row we are searching
+  int64_t i;
+  size_t queryLength = strlen(query);
   for (i = 0; i < Text.totalRows; i++) {  // loop through all the row structures in the E structure
     current += direction;  //  move current index forward or backward based on the value of direction
     if (current == -1) current = Text.totalRows - 1;  // if beginning of the text is reached, wrap around to the last row
     else if (current == Text.totalRows) current = 0;  // if the end of the text is reached, wrap around to the first row
 
-    textRow *row = &Text.row[current];  // set a pointer to the address of Text.row[i]
-    char *match = strstr(row->display, query);  // searches the row structure pointed to by row->display for the first occurence of query
+    int64_t slot;
+    piece *p = Text.pager.on ? NULL : pieceAt(current, &slot);
+    if (Text.pager.on ? editorRowIfMade(current) == NULL : madeRow(p->source, slot) == NULL) {  // a line of a mapped file (or one outside
+      char *text;                                                                                 // the pager's window) - only worth making
+      int64_t length;                                                                             // into a row if it could match
+      if (Text.pager.on) pagerSpan(current, &text, &length);
+      else editorLineSpan(slot, &text, &length);
+      if (!memmem(text, length, query, queryLength) && !memchr(text, '\t', length)) continue;  // tabs turn into spaces in the display, so they could make a match
+    }
+    textRow *row = editorRowAt(current);  // set a pointer to the row at position current
+    char *match = memmem(row->display, row->displayLength, query, queryLength);  // searches the row structure pointed to by row->display for the first occurence of query
     if (match) {  // a match is found
       last_match = current;
       Text.cursorYPosition = current;  // set cursor to location of the match
@@ -892,9 +4348,14 @@ void editorFindCallback(char *query, int key) {
       Text.rowOffset = Text.totalRows;  // scroll the text row where the match was found to the top of the screen -  set Text.rowOffset so that we are scrolled to the very bottom of the file, which will cause editorScroll() to scroll upwards at the next screen refresh so that the matching line will be at the very top of the screen
       
       saved_hl_line = current;
+      if (row->textColor == NULL) {  // rows only have colors when there is highlighting
+        editorReserveColor(row, row->displayLength);
+        memset(row->textColor, HL_NORMAL, row->displayLength);
+      }
       saved_hl = malloc(row->displayLength);
+      saved_hl_length = row->displayLength;
       memcpy(saved_hl, row->textColor, row->displayLength);
-      memset(&row->textColor[match - row->display], HL_MATCH, strlen(query));
+      memset(&row->textColor[match - row->display], HL_MATCH, queryLength);
       break;
     }
   }
@@ -903,10 +4364,11 @@ void editorFindCallback(char *query, int key) {
 // -----------------------------------------------------------------------------
 //
 void editorFind() {
-  int saved_cursorXPosition = Text.cursorXPosition;          // change all these into a cursor position struct
-  int saved_cursorYPosition = Text.cursorYPosition;          // ...
-  int saved_columnOffset = Text.columnOffset;  // ...
-  int saved_rowOffset = Text.rowOffset;  // ...
+  int64_t saved_cursorXPosition = Text.cursorXPosition;          // change all these into a cursor position struct
+  int64_t saved_cursorYPosition = Text.cursorYPosition;          // ...
+  int64_t saved_columnOffset = Text.columnOffset;  // ...
+  int64_t saved_rowOffset = Text.rowOffset;  // ...
+  editorIndexAll();  // the search wraps around from the end of the text, so all of a mapped file has to be in it
 
   char *query = editorPrompt("Search: %s (Use ESCx3/Arrows/Enter)", 
                              editorFindCallback);  // prompt for search text
@@ -921,6 +4383,44 @@ void editorFind() {
   }
 }
 
+// -----------------------------------------------------------------------------
+// asks for a line number and moves the cursor to the start of that line, in the middle of the screen - a file still being searched
+// for lines is only searched as far as the line
+void editorGotoLine() {
+  char *answer = editorPrompt("Go to line: %s (ESC to cancel)", NULL);
+  if (answer == NULL) return;
+  long long line = atoll(answer);
+  free(answer);
+  while (editorLoading() && Text.totalRows < line) {
+    editorIndexMore(INDEX_STEP);
+    editorRefreshScreen();  // the line count on the status bar goes up
+  }
+  if (line > Text.totalRows) line = Text.totalRows;
+  if (line < 1) return;
+  Text.cursorYPosition = line - 1;
+  Text.cursorXPosition = 0;
+  Text.rowOffset = Text.cursorYPosition > Text.screenRows / 2 ? Text.cursorYPosition - Text.screenRows / 2 : 0;
+}
+
+// -----------------------------------------------------------------------------
+// asks for an offset in the hex view (in hex with 0x before it, or decimal) and moves the cursor to that byte, in the middle of the 
+// screen - the byte's line is worked out, nothing has to be read to find it
+void editorHexGoto() {
+  char *answer = editorPrompt("Go to offset: %s (0x for hex, ESC to cancel)", NULL);
+  if (answer == NULL || Text.hex.size == 0) {
+    free(answer);
+    return;
+  }
+  long long offset = strtoll(answer, NULL, 0);
+  free(answer);
+  if (offset < 0) offset = 0;
+  if (offset >= Text.hex.size) offset = Text.hex.size - 1;
+  Text.hex.cursor = offset;
+  Text.hex.lowNibble = false;
+  int64_t row = offset / HEX_ROW_BYTES;
+  Text.rowOffset = row > Text.screenRows / 2 ? row - Text.screenRows / 2 : 0;
+}
+
 
 /*** append buffer ***/
 //        d8888 8888888b.  8888888b.  8888888888 888b    888 8888888b.       888888b.   888     888 8888888888 8888888888 8888888888 8888888b.  
@@ -933,23 +4433,21 @@ void editorFind() {
 // d88P     888 888        888        8888888888 888    Y888 8888888P"       8888888P"   "Y88888P"  888        888        8888888888 888   T88b 
 
 
-struct abuf {
-  char *b;
-  int len;
-};
-
-#define ABUF_INIT { NULL, 0}
-
 // -----------------------------------------------------------------------------
-void abAppend(struct abuf *ab, const char *s, int len) 
+void abAppend(struct abuf *ab, const char *s, size_t len) 
 {
-  char *new = realloc(ab->b, ab->len + len);  // allocate memeory for the new string
-
-  if (new == NULL) {
-    return;
+  if (len == 0) return;  // s may be an empty buffer's NULL
+  if (ab->len + len > ab->capacity) {  // out of room - double it, so a buffer filled a byte at a time is only copied a few times
+    size_t capacity = ab->capacity ? ab->capacity : ABUF_CAPACITY;
+    while (capacity < ab->len + len) capacity *= 2;
+    char *new = realloc(ab->b, capacity);  // allocate memeory for the new string
+    if (new == NULL) {
+      return;
+    }
+    ab->b = new;  // update ab.b
+    ab->capacity = capacity;
   }
-  memcpy(&new[ab->len], s, len);  // copy the contents of s onto the end of the contents of new
-  ab->b = new;  // update ab.b
+  memcpy(&ab->b[ab->len], s, len);  // copy the contents of s onto the end of the buffer
   ab->len += len;  // update ab.len
 }
 
@@ -957,7 +4455,7 @@ void abAppend(struct abuf *ab, const char *s, int len)
 void abFree(struct abuf *ab) 
 {
   free(ab->b);
-  // comment just so I can collapse this function
+  *ab = (struct abuf)ABUF_INIT;
 }
 
 /*** output ***/
@@ -974,8 +4472,11 @@ void abFree(struct abuf *ab)
 //  check if the cursor has moved outside of the visible window, and if so, adjust Text.rowOffset so that the cursor is just inside the visible window.
 void editorScroll() {
   Text.displayXPosition = 0;
-  if (Text.cursorYPosition < Text.totalRows) {
-    Text.displayXPosition = convertToDisplayIndex(&Text.row[Text.cursorYPosition], Text.cursorXPosition);
+  if (Text.hex.on) {  // the cursor is on a byte - on the first or second of its hex digits
+    Text.cursorYPosition = Text.hex.cursor / HEX_ROW_BYTES;
+    Text.displayXPosition = HEX_DATA_COLUMN + 3 * (Text.hex.cursor % HEX_ROW_BYTES) + Text.hex.lowNibble;
+  } else if (Text.cursorYPosition < Text.totalRows) {
+    Text.displayXPosition = convertToDisplayIndex(editorRowAt(Text.cursorYPosition), Text.cursorXPosition);
   }
 
   if (Text.cursorYPosition < Text.rowOffset) {
@@ -992,74 +4493,103 @@ void editorScroll() {
   }
 }
 
+#define COLOR_SEQUENCE_SIZE 5  // <esc>[nm switches to foreground color n, which always has two digits
+
+const char *colorSequences[] = {  // the escape sequence for each foreground color, so drawing a row never has to make one
+  [BLACK] = "\x1b[30m", [RED] = "\x1b[31m", [GREEN] = "\x1b[32m", [YELLOW] = "\x1b[33m",
+  [BLUE] = "\x1b[34m", [MAGENTA] = "\x1b[35m", [CYAN] = "\x1b[36m", [WHITE] = "\x1b[37m",
+  [DEFAULT_COLOR] = "\x1b[39m",
+  [GRAY] = "\x1b[90m", [BRIGHT_RED] = "\x1b[91m", [BRIGHT_GREEN] = "\x1b[92m", [BRIGHT_YELLOW] = "\x1b[93m",
+  [BRIGHT_BLUE] = "\x1b[94m", [BRIGHT_MAGENTA] = "\x1b[95m", [BRIGHT_CYAN] = "\x1b[96m", [BRIGHT_WHITE] = "\x1b[97m",
+};
+
 // -----------------------------------------------------------------------------
-// draws a tilde on every row of the terminal just like Vim
-void editorDrawRows(struct abuf *ab) {
-  int y;
-  for (y = 0; y < Text.screenRows; y++) {
-    int filtextRow = y + Text.rowOffset; // To get the row of the file that we want to display at each y position, we add Text.rowOffset to the y position.
-    if (filtextRow >= Text.totalRows) {
-      if (Text.totalRows == 0 && y == Text.screenRows / 3) {
-        char welcome[80];
-        int welcomelen = snprintf(welcome, sizeof(welcome),
-          "Text Editor -- version %s", VERSION);
-        if (welcomelen > Text.screenColumns) {
-          welcomelen = Text.screenColumns;
-        }
-        int padding = (Text.screenColumns - welcomelen) / 2;
-        if (padding) {
-          abAppend(ab, "~", 1);
-          padding--;
-        }
-        while (padding--) abAppend(ab, " ", 1);
-        abAppend(ab, welcome,welcomelen);
-      } else {
+// draws a line of the hex view - the offset of its first byte, its bytes in hex, then as characters. Bytes changed since the last
+// save are in their own color.
+void editorDrawHexRow(struct abuf *ab, int64_t row) {
+  int64_t offset = row * HEX_ROW_BYTES;
+  int count = Text.hex.size - offset < HEX_ROW_BYTES ? Text.hex.size - offset : HEX_ROW_BYTES;
+  byte bytes[HEX_ROW_BYTES];
+  bool changed[HEX_ROW_BYTES];
+  for (int j = 0; j < count; j++) bytes[j] = hexByte(offset + j, &changed[j]);
+
+  char cell[32];
+  int room = Text.screenColumns;  // the columns left on the screen - the line is cut there
+  int length = snprintf(cell, sizeof(cell), "%012llx  ", (long long)offset);
+  abAppend(ab, cell, length < room ? length : room);
+  room -= length;
+  for (int pane = 0; pane < 2; pane++) {
+    for (int j = 0; j < HEX_ROW_BYTES && room > 0; j++) {
+      if (pane == 0) length = j < count ? snprintf(cell, sizeof(cell), "%02x ", bytes[j]) : snprintf(cell, sizeof(cell), "   ");
+      else if (j < count) length = snprintf(cell, sizeof(cell), "%c", isprint(bytes[j]) ? bytes[j] : '.');
+      else break;
+      if (j < count && changed[j]) abAppend(ab, colorSequences[HL_CHANGED], COLOR_SEQUENCE_SIZE);
+      abAppend(ab, cell, length < room ? length : room);
+      if (j < count && changed[j]) abAppend(ab, colorSequences[DEFAULT_COLOR], COLOR_SEQUENCE_SIZE);
+      room -= length;
+    }
+    if (pane == 0 && room > 0) {
+      abAppend(ab, " ", 1);
+      room--;
+    }
+  }
+}
+
+// -----------------------------------------------------------------------------
+// draws line y of the screen - a row of the text, or a tilde past the end of it just like Vim
+void editorDrawRow(struct abuf *ab, int y) {
+  int64_t filtextRow = y + Text.rowOffset; // To get the row of the file that we want to display at each y position, we add Text.rowOffset to the y position.
+  if (filtextRow >= Text.totalRows) {
+    if (Text.totalRows == 0 && y == Text.screenRows / 3) {
+      char welcome[80];
+      int welcomelen = snprintf(welcome, sizeof(welcome),
+        "Text Editor -- version %s", VERSION);
+      if (welcomelen > Text.screenColumns) {
+        welcomelen = Text.screenColumns;
+      }
+      int padding = (Text.screenColumns - welcomelen) / 2;
+      if (padding) {
         abAppend(ab, "~", 1);
+        padding--;
       }
+      while (padding--) abAppend(ab, " ", 1);
+      abAppend(ab, welcome,welcomelen);
     } else {
-      int len = Text.row[filtextRow].displayLength - Text.columnOffset;
-      if (len < 0) len = 0;
-      if (len > Text.screenColumns) len = Text.screenColumns;
-      char *c = &Text.row[filtextRow].display[Text.columnOffset];
-      byte *textColor = &Text.row[filtextRow].textColor[Text.columnOffset];  // a pointer, textColor, to the slice of the textColor array that corresponds to the slice of display that we are printing
-      int current_color = -1;
-      int j;
-      for (j = 0; j < len; j++) {  // for every character 
-        if (iscntrl(c[j])) {  // We use iscntrl() to check if the current character is a control character. 
-          char sym = (c[j] <= 26) ? '@' + c[j] : '?';  // If so, we translate it into a printable character by adding its value to '@' (in ASCII, the capital letters of the alphabet come after the @ character), or using the '?' character if it’s not in the alphabetic range.
-          abAppend(ab, "\x1b[7m", 4);  // use the <esc>[7m escape sequence to switch to inverted colors
-          abAppend(ab, &sym, 1);  // add new symbol we just created to the buffer
-          abAppend(ab, "\x1b[m", 3); //  use <esc>[m to turn off inverted colors - Unfortunately, <esc>[m turns off all text formatting, including colors. So let’s print the escape sequence for the current color afterwards.
-          if (current_color != -1) {
-            char buf[16];
-            int clen = snprintf(buf, sizeof(buf), "\x1b[%dm", current_color);  // clen is c length
-            abAppend(ab, buf, clen);
-          }
-        } else if (textColor[j] == HL_NORMAL) {  // if the character gets normal highlighting
-          if (current_color != -1) {
-            abAppend(ab, "\x1b[39m", 5);  // append an escaspe sequence for NORMAL coloring
-            current_color = -1;
-          }
-          abAppend(ab, &c[j], 1);  // append the character
-        } else {  // if the character does not get normal highlighting 
-          int color = textColor[j];  // get color to highlight
-          if (color != current_color) {
-            current_color = color;
-            char buf[16];
-            int clen = snprintf(buf, sizeof(buf), "\x1b[%dm", color);
-            abAppend(ab, buf, clen);
-          }  
-          abAppend(ab, &c[j], 1);
-        }
+      abAppend(ab, "~", 1);
+    }
+  } else if (Text.hex.on) {
+    editorDrawHexRow(ab, filtextRow);
+  } else {
+    textRow *row = editorRowAt(filtextRow);
+    int64_t len = row->displayLength - Text.columnOffset;
+    if (len < 0) len = 0;
+    if (len > Text.screenColumns) len = Text.screenColumns;
+    char *c = &row->display[Text.columnOffset];
+    byte *textColor = row->textColor ? &row->textColor[Text.columnOffset] : NULL;  // a pointer, textColor, to the slice of the textColor array that corresponds to the slice of display that we are printing - NULL without highlighting
+    int current_color = -1;
+    int64_t j = 0;
+    while (j < len) {
+      if (iscntrl(c[j])) {  // We use iscntrl() to check if the current character is a control character. 
+        char sym = (c[j] <= 26) ? '@' + c[j] : '?';  // If so, we translate it into a printable character by adding its value to '@' (in ASCII, the capital letters of the alphabet come after the @ character), or using the '?' character if it’s not in the alphabetic range.
+        abAppend(ab, "\x1b[7m", 4);  // use the <esc>[7m escape sequence to switch to inverted colors
+        abAppend(ab, &sym, 1);  // add new symbol we just created to the buffer
+        abAppend(ab, "\x1b[m", 3); //  use <esc>[m to turn off inverted colors - Unfortunately, <esc>[m turns off all text formatting, including colors. So let’s print the escape sequence for the current color afterwards.
+        if (current_color != -1) abAppend(ab, colorSequences[current_color], COLOR_SEQUENCE_SIZE);
+        j++;
+        continue;
+      }
+      int color = textColor ? textColor[j] : HL_NORMAL;  // the characters from j on that are the same color go in one append
+      int64_t end = j + 1;
+      while (end < len && !iscntrl(c[end]) && (textColor ? textColor[end] : HL_NORMAL) == color) end++;
+      if (color == HL_NORMAL) color = -1;  // normal highlighting is the terminal's own color
+      if (color != current_color) {
+        abAppend(ab, colorSequences[color == -1 ? DEFAULT_COLOR : color], COLOR_SEQUENCE_SIZE);
+        current_color = color;
       }
-      abAppend(ab, "\x1b[39m", 5);  // after we’re done looping through all the characters and displaying them, we print a final <esc>[39m escape sequence to make sure the text color is reset to default
+      abAppend(ab, &c[j], end - j);
+      j = end;
     }
-
-    abAppend(ab, "\x1b[K", 3);  // append a 3-byte escape sequence which erases the line right of the cursor
-                                  // "\x1b[2K" - erases whole line
-                                  // "\x1b[1K" - erases line to the left of the cursor
-                                  // "\x1b[0K" - erases line to the rightt of the cursor (same as "\x1b[K")
-    abAppend(ab, "\r\n", 2);
+    abAppend(ab, "\x1b[39m", 5);  // after we’re done looping through all the characters and displaying them, we print a final <esc>[39m escape sequence to make sure the text color is reset to default
   }
 }
 
@@ -1071,11 +4601,16 @@ void editorDrawStatusBar(struct abuf *ab) {
                                 // For example, you could specify all of these attributes using the command <esc>[1;4;5;7m. An argument 
                                 // of 0 clears all attributes, and is the default argument, so we use <esc>[m to go back to normal text formatting.
   char status[80], rstatus[80];
-  int len = snprintf(status, sizeof(status), "%.20s - %d lines %s",
-    Text.filename ? Text.filename : "[No Name]", Text.totalRows, 
+  int len = snprintf(status, sizeof(status), "%.20s - %lld%s lines %s",
+    Text.filename ? Text.filename : "[No Name]", (long long)Text.totalRows, (editorLoading() || Text.stream.on) ? "+" : "",  // + while a mapped file is still being searched for lines, or a pipe read
     Text.modified ? "(modified)" : "");
-  int rlen = snprintf(rstatus, sizeof(rstatus), "%s | %d/%d",
-    Text.syntax ? Text.syntax->filetype : "no filetype", Text.cursorYPosition + 1, Text.totalRows);  // prints file type (or no filetype) and current line as well as total lines
+  int rlen = snprintf(rstatus, sizeof(rstatus), "%s%s | %lld/%lld", editorSavesAtomically() ? "atomic save | " : "",  // how a save will go
+    Text.syntax ? Text.syntax->filetype : "no filetype", (long long)Text.cursorYPosition + 1, (long long)Text.totalRows);  // prints file type (or no filetype) and current line as well as total lines
+  if (Text.hex.on) {  // bytes rather than lines
+    len = snprintf(status, sizeof(status), "%.20s - %lld bytes %s%s", Text.filename, (long long)Text.hex.size,
+      Text.modified ? "(modified)" : "", Text.hex.writable ? "" : "(read-only)");
+    rlen = snprintf(rstatus, sizeof(rstatus), "hex | 0x%llx/0x%llx", (long long)Text.hex.cursor, (long long)Text.hex.size);
+  }
   if (len > Text.screenColumns) len = Text.screenColumns;
   abAppend(ab, status, len);
   while (len < Text.screenColumns) {
@@ -1088,12 +4623,10 @@ void editorDrawStatusBar(struct abuf *ab) {
     }
   }
   abAppend(ab, "\x1b[m", 3);  // The escape sequence <esc>[m switches back to normal formatting
-  abAppend(ab, "\r\n", 2);
 }
 
 // -----------------------------------------------------------------------------
 void editorDrawMessageBar(struct abuf *ab) {
-  abAppend(ab, "\x1b[K", 3);  // clear the message bar
   int msglen = strlen(Text.statusMessage);
   if (msglen > Text.screenColumns) msglen = Text.screenColumns;  // if message length is grater than the width of the screen, cut it down
   if (msglen && time(NULL) - Text.statusMessage_time < 5)  // display the message only if it is lenn than 5 seconds old
@@ -1101,28 +4634,134 @@ void editorDrawMessageBar(struct abuf *ab) {
 }
 
 // -----------------------------------------------------------------------------
-void editorRefreshScreen() {
-  editorScroll();
+// forgets what the terminal shows, so the next refresh draws every line - for ctrl-L
+void editorFrameReset() {
+  if (Text.frame.lines == NULL) return;
+  for (int y = 0; y < Text.frame.rows + 2; y++) Text.frame.lines[y].known = false;
+  Text.frame.rowOffset = -1;
+}
 
-  struct abuf ab = ABUF_INIT;
+// -----------------------------------------------------------------------------
+// lets go of the lines kept for a screen of another size, and makes a line for each line of the screen as it is now - none known yet
+void editorFrameResize() {
+  if (Text.frame.lines) {
+    for (int y = 0; y < Text.frame.rows + 2; y++) abFree(&Text.frame.lines[y].drawn);
+    free(Text.frame.lines);
+  }
+  Text.frame.rows = Text.screenRows;
+  Text.frame.columns = Text.screenColumns;
+  Text.frame.lines = malloc(sizeof(screenLine) * (Text.screenRows + 2));
+  for (int y = 0; y < Text.screenRows + 2; y++) Text.frame.lines[y] = (screenLine){ ABUF_INIT, false };
+  Text.frame.rowOffset = -1;
+}
+
+// -----------------------------------------------------------------------------
+// reverses the order of the frame's lines from from up to, but not including, to
+void editorFrameReverse(int from, int to) {
+  for (to--; from < to; from++, to--) {
+    screenLine line = Text.frame.lines[from];
+    Text.frame.lines[from] = Text.frame.lines[to];
+    Text.frame.lines[to] = line;
+  }
+}
+
+// -----------------------------------------------------------------------------
+// scrolls the rows of text on the terminal up by k lines, or down for a negative k, in a scroll region that leaves the status and
+// message bars where they are - the frame's lines move with them, and the ones that scroll into view are blank
+void editorScrollFrame(struct abuf *ab, int k) {
+  int lines = abs(k),
+      kept = Text.screenRows - lines;
+  char sequence[48];  // <esc>[top;bottomr sets the scroll region (DECSTBM), <esc>[nS scrolls it up n lines (SU) and <esc>[nT down (SD),
+                      // and <esc>[r puts the region back to the whole screen - which also moves the cursor to the top left
+  int length = snprintf(sequence, sizeof(sequence), "\x1b[1;%dr\x1b[%d%c\x1b[r", Text.screenRows, lines, k > 0 ? 'S' : 'T');
+  abAppend(ab, sequence, length);
+  int split = k > 0 ? lines : kept;  // the lines are rotated by three reversals, so their buffers are moved rather than let go of - the
+  editorFrameReverse(0, split);       // lines that scroll off come round to where the blank ones scroll in
+  editorFrameReverse(split, Text.screenRows);
+  editorFrameReverse(0, Text.screenRows);
+  int blank = k > 0 ? kept : 0;
+  for (int y = blank; y < blank + lines; y++) {
+    Text.frame.lines[y].drawn.len = 0;
+    Text.frame.lines[y].known = true;
+  }
+}
+
+// -----------------------------------------------------------------------------
+// draws each line of the screen and compares it with what the terminal already shows there - only the lines that differ are added to
+// ab, each after moving the cursor to it and erasing it. If the text scrolled, the terminal is told to scroll first, so mostly only
+// the lines that scrolled into view differ. Returns the quantity of lines added.
+int editorDrawFrame(struct abuf *ab) {
+  if (Text.frame.lines == NULL || Text.frame.rows != Text.screenRows || Text.frame.columns != Text.screenColumns) {
+    editorFrameResize();
+  } else if (Text.frame.rowOffset != -1 && Text.rowOffset != Text.frame.rowOffset && Text.columnOffset == Text.frame.columnOffset &&
+             llabs(Text.rowOffset - Text.frame.rowOffset) < Text.screenRows) {  // the text only moved up or down, by less than a screen,
+    editorScrollFrame(ab, (int)(Text.rowOffset - Text.frame.rowOffset));        // so the terminal can move what it shows itself
+  }
+  Text.frame.rowOffset = Text.rowOffset;
+  Text.frame.columnOffset = Text.columnOffset;
+
+  int drawn = 0;
+  struct abuf *line = &Text.frame.line;
+  for (int y = 0; y < Text.screenRows + 2; y++) {
+    line->len = 0;
+    if (y < Text.screenRows) editorDrawRow(line, y);
+    else if (y == Text.screenRows) editorDrawStatusBar(line);
+    else editorDrawMessageBar(line);
+
+    screenLine *shown = &Text.frame.lines[y];
+    if (shown->known && shown->drawn.len == line->len && (line->len == 0 || memcmp(shown->drawn.b, line->b, line->len) == 0)) {
+      continue;  // the terminal already shows it
+    }
+    char position[32];
+    int length = snprintf(position, sizeof(position), "\x1b[%d;1H\x1b[K", y + 1);  // erase the line before drawing it, not after - erasing
+                                                                                      // after a line as wide as the screen would take its last
+                                                                                      // character with it on some terminals
+    abAppend(ab, position, length);
+    abAppend(ab, line->b, line->len);
+    struct abuf previous = shown->drawn;  // the line is kept as drawn, to compare the next frame with, and the buffer it replaces
+    shown->drawn = *line;                 // is drawn into next
+    shown->known = true;
+    *line = previous;
+    drawn++;
+  }
+  return drawn;
+}
 
-  abAppend(&ab, "\x1b[?25l", 6);  // set mode escape sequence - hide cursor
-  // abAppend(&ab, "\x1b[2J", 4); REMOVED
-  abAppend(&ab, "\x1b[H", 3);
+// -----------------------------------------------------------------------------
+// adds what has to be sent to the terminal to bring it up to date to ab - the lines that changed, then the cursor
+void editorRenderScreen(struct abuf *ab) {
+  editorScroll();
 
-  editorDrawRows(&ab);
-  editorDrawStatusBar(&ab);
-  editorDrawMessageBar(&ab);
+  abAppend(ab, "\x1b[?25l", 6);  // set mode escape sequence - hide cursor
+  editorDrawFrame(ab);
 
   char buf[32];
-  snprintf(buf, sizeof(buf), "\x1b[%d;%dH", (Text.cursorYPosition - Text.rowOffset) + 1,
-                                            (Text.displayXPosition - Text.columnOffset) + 1);
-  abAppend(&ab, buf, strlen(buf));
+  snprintf(buf, sizeof(buf), "\x1b[%d;%dH", (int)(Text.cursorYPosition - Text.rowOffset) + 1,  // both are on the screen, so they fit in an int
+                                            (int)(Text.displayXPosition - Text.columnOffset) + 1);
+  abAppend(ab, buf, strlen(buf));
+
+  abAppend(ab, "\x1b[?25h", 6);  // reset mode escape sequence - show cursor
+}
+
+// -----------------------------------------------------------------------------
+void editorRefreshScreen() {
+  Text.frame.output.len = 0;  // what the last frame wrote is done with, but the room it took is kept
+  editorRenderScreen(&Text.frame.output);
+  write(STDOUT_FILENO, Text.frame.output.b, Text.frame.output.len);
+  struct timespec clock;
+  clock_gettime(CLOCK_MONOTONIC, &clock);
+  Text.frame.lastDrawn = clock.tv_sec + clock.tv_nsec / 1e9;
+}
 
-  abAppend(&ab, "\x1b[?25h", 6);  // reset mode escape sequence - show cursor
-  
-  write(STDOUT_FILENO, ab.b, ab.len);
-  abFree(&ab);
+// -----------------------------------------------------------------------------
+// true if the screen should be drawn before the next key is handled - straight away once no more keys are waiting, so the last key of
+// a burst is always seen at once, but while keys that were pasted, repeated or typed faster than they can be shown keep coming, only
+// once FRAME_MS has gone by since the last frame, so the keys in between are handled together without a frame each
+bool editorFrameDue() {
+  if (!keyWaiting()) return true;
+  struct timespec clock;
+  clock_gettime(CLOCK_MONOTONIC, &clock);
+  return clock.tv_sec + clock.tv_nsec / 1e9 - Text.frame.lastDrawn >= FRAME_MS / 1000.0;
 }
 
 #if 0
@@ -1158,6 +4797,106 @@ void editorSetStatusMessage(const char *fmt, ...) {
   Text.statusMessage_time = time(NULL);
 }
 
+/*** memory ***/
+// 888b     d888 8888888888 888b     d888  .d88888b.  8888888b.  Y88b   d88P 
+// 8888b   d8888 888        8888b   d8888 d88P" "Y88b 888   Y88b  Y88b d88P  
+// 88888b.d88888 888        88888b.d88888 888     888 888    888   Y88o88P   
+// 888Y88888P888 8888888    888Y88888P888 888     888 888   d88P    Y888P    
+// 888 Y888P 888 888        888 Y888P 888 888     888 8888888P"      888     
+// 888  Y8P  888 888        888  Y8P  888 888     888 888 T88b       888     
+// 888   "   888 888        888   "   888 Y88b. .d88P 888  T88b      888     
+// 888       888 8888888888 888       888  "Y88888P"  888   T88b     888     
+
+typedef struct memoryStats {
+  long long rows,  // the quantity of rows in the text
+            aliasedRows,  // the quantity of rows whose display points at their characters instead of being a copy
+            arenaRows,  // the quantity of rows whose characters are still in the load arena
+            unmadeRows,  // the quantity of lines of a mapped file that haven't been made into rows
+            mappedRows,  // the quantity of rows made from a mapped file whose characters still point into it
+            characterBytes,  // bytes allocated for the characters of every row, gaps included
+            displayBytes,  // bytes allocated for displays that are copies
+            colorBytes,  // bytes allocated for textColor arrays
+            rowBytes,  // bytes taken by the textRow structs in the piece table buffers, used or not
+            pieceBytes,  // bytes taken by the pieces
+            indexBytes,  // bytes taken by the line starts of a mapped file and its row block pointers
+            copiedDisplayBytes,  // what the displays would take if every row had a copy of its own
+            copiedColorBytes;  // what textColor would take if every row had an array
+} memoryStats;
+
+// -----------------------------------------------------------------------------
+// adds up the memory the text is using by walking every row
+void editorMemoryStats(memoryStats *stats) {
+  memset(stats, 0, sizeof(*stats));
+  int64_t addBlocks = (Text.rows.addRows + ADD_BLOCK_ROWS - 1) / ADD_BLOCK_ROWS;
+  stats->rowBytes = ((long long)Text.rows.originalCapacity + (long long)addBlocks * ADD_BLOCK_ROWS) * sizeof(textRow) + addBlocks * sizeof(textRow *);
+  for (int64_t block = 0; block < Text.map.blockCount; block++)
+    if (Text.map.rowBlocks[block]) stats->rowBytes += ADD_BLOCK_ROWS * sizeof(textRow);
+  stats->indexBytes = Text.map.lineCapacity * sizeof(int64_t) + Text.map.blockCount * sizeof(textRow *);
+
+  for (piece *run = pieceFirst(); run; run = pieceNext(run)) {
+    stats->pieceBytes += sizeof(piece);
+    for (int64_t k = 0; k < run->count; k++) {
+      textRow *row = madeRow(run->source, run->start + k);
+      stats->rows++;
+      if (row == NULL) {
+        stats->unmadeRows++;
+        continue;
+      }
+      if (!(row->memory & MAPPED)) stats->characterBytes += row->capacity;
+      stats->displayBytes += row->displayCapacity;
+      stats->colorBytes += row->colorCapacity;
+      stats->copiedDisplayBytes += row->displayCapacity ? row->displayCapacity : row->displayLength + 1;
+      stats->copiedColorBytes += row->colorCapacity ? row->colorCapacity : row->displayLength;
+      if (row->displayCapacity == 0) stats->aliasedRows++;
+      if (row->memory & MAPPED) stats->mappedRows++;
+      else if (row->memory & ARENA_CHARACTERS) stats->arenaRows++;
+    }
+  }
+}
+
+// -----------------------------------------------------------------------------
+// shows a one line summary of the memory the text is using on the status bar
+void editorShowMemory() {
+  memoryStats stats;
+  editorMemoryStats(&stats);
+  double mb = 1024.0 * 1024.0;
+  if (Text.pager.on) {
+    editorSetStatusMessage("pager window %d rows, %.1f of %.1f MB | index %.1f MB", Text.pager.count, Text.pager.used / mb,
+      Text.pager.budget / mb, (Text.pager.checkpointCapacity * sizeof(int64_t) + PAGER_SLOTS * (sizeof(pagerSlot) + sizeof(int))) / mb);
+    return;
+  }
+  editorSetStatusMessage("text %.1f MB | display %.1f MB | colors %.1f MB | rows %.1f MB",
+    stats.characterBytes / mb, stats.displayBytes / mb, stats.colorBytes / mb, (stats.rowBytes + stats.pieceBytes + stats.indexBytes) / mb);
+}
+
+// -----------------------------------------------------------------------------
+// opens a file without touching the terminal and prints the memory it takes once loaded - returns the program's exit code
+int editorMemoryReport(char *filename) {
+  const char *error = editorOpen(filename);
+  if (error) fprintf(stderr, "%s: can't decompress all of it! %s\n", filename, error);
+  editorIndexAll();
+  memoryStats stats;
+  editorMemoryStats(&stats);
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+
+  double mb = 1024.0 * 1024.0;
+  long long total = stats.characterBytes + stats.displayBytes + stats.colorBytes + stats.rowBytes + stats.pieceBytes + stats.indexBytes;
+  long long copied = stats.characterBytes + stats.copiedDisplayBytes + stats.copiedColorBytes + stats.rowBytes + stats.pieceBytes + stats.indexBytes;
+  printf("%s: %lld rows, %lld of them display their characters in place\n", filename, stats.rows, stats.aliasedRows);
+  printf("  %lld rows in the load arena (%d blocks)\n", stats.arenaRows, Text.arena.blockCount);
+  if (Text.map.base) printf("  mapped: %lld lines not made into rows yet, %lld rows pointing into the file\n", stats.unmadeRows, stats.mappedRows);
+  printf("  characters     %10.1f MB\n", stats.characterBytes / mb);
+  printf("  display        %10.1f MB  (%.1f MB if every row had its own copy)\n", stats.displayBytes / mb, stats.copiedDisplayBytes / mb);
+  printf("  textColor      %10.1f MB  (%.1f MB if every row had an array)\n", stats.colorBytes / mb, stats.copiedColorBytes / mb);
+  printf("  row structs    %10.1f MB\n", stats.rowBytes / mb);
+  printf("  pieces         %10.1f MB\n", stats.pieceBytes / mb);
+  printf("  line index     %10.1f MB\n", stats.indexBytes / mb);
+  printf("  total          %10.1f MB  (%.1f MB)\n", total / mb, copied / mb);
+  printf("  peak resident  %10.1f MB\n", usage.ru_maxrss / 1024.0);  // ru_maxrss is in kilobytes on Linux
+  return 0;
+}
+
 /*** input ***/
 // 8888888 888b    888 8888888b.  888     888 88888888888 
 //   888   8888b   888 888   Y88b 888     888     888     
@@ -1176,6 +4915,7 @@ char *editorPrompt(char *prompt, void (*callback)(char *, int)) {  // The prompt
 
   size_t buflen = 0;
   buf[0] = '\0';
+  Text.prompting = true;
 
   while (1) {  // infinite loop that repeatedly sets the status message, refreshes the screen, and waits for a keypress to handle
     editorSetStatusMessage(prompt, buf);
@@ -1188,11 +4928,13 @@ char *editorPrompt(char *prompt, void (*callback)(char *, int)) {  // The prompt
       editorSetStatusMessage("");  // erase status message asking for a file name
       if (callback) callback(buf, c);  // the if (callback) allows the caller to pass NULL for the callback, in case they don't want to use the callback
       free(buf); // free the memory allocated to buf
+      Text.prompting = false;
       return NULL;  // end loop and return without file name
     } else if (c == '\r') {  // if Enter is pressed
       if (buflen != 0) {  // if the length of the buffer where we are storing the text is not 0 - meaning the buffer is not empty
         editorSetStatusMessage("");  // set status message back to nothing
         if (callback) callback(buf, c);  // the if (callback) allows the caller to pass NULL for the callback, in case they don't want to use the callback
+        Text.prompting = false;
         return buf;  // return the file name entered
       }
     } else if (!iscntrl(c) && c < 128) {  // Otherwise, when they input a printable character (not a control character and not a charcter value above 128 - so no characters in our specialKeys enum), we append it to buf - Notice that we have to make sure the input key isn’t one of the special keys in the specialKeys enum, which have high integer values. To do that, we test whether the input key is in the range of a char by making sure it is less than 128.
@@ -1210,7 +4952,7 @@ char *editorPrompt(char *prompt, void (*callback)(char *, int)) {  // The prompt
 
 // -----------------------------------------------------------------------------
 void editorMoveCursor(int key) {
-  textRow *row = (Text.cursorYPosition >= Text.totalRows) ? NULL : &Text.row[Text.cursorYPosition];
+  textRow *row = (Text.cursorYPosition >= Text.totalRows) ? NULL : editorRowAt(Text.cursorYPosition);
 
   switch (key) {
     case ARROW_LEFT:
@@ -1218,7 +4960,7 @@ void editorMoveCursor(int key) {
         Text.cursorXPosition--;
       } else if (Text.cursorYPosition > 0) {
         Text.cursorYPosition--;
-        Text.cursorXPosition = Text.row[Text.cursorYPosition].length;
+        Text.cursorXPosition = editorRowAt(Text.cursorYPosition)->length;
       }
       break;
     case ARROW_RIGHT:
@@ -1241,19 +4983,119 @@ void editorMoveCursor(int key) {
       break;
   }
 
-  row = (Text.cursorYPosition >= Text.totalRows) ? NULL : &Text.row[Text.cursorYPosition];
-  int rowlen = row ? row->length : 0;
+  if (editorLoading() && Text.cursorYPosition >= Text.totalRows && Text.totalRows > 0)  // the line after the last one found so far is not the end 
+    Text.cursorYPosition = Text.totalRows - 1;                                          // of the text, so the cursor can't go there
+  row = (Text.cursorYPosition >= Text.totalRows) ? NULL : editorRowAt(Text.cursorYPosition);
+  int64_t rowlen = row ? row->length : 0;
   if (Text.cursorXPosition > rowlen) {
     Text.cursorXPosition = rowlen;
   }
 }
 
+// -----------------------------------------------------------------------------
+// handles a key in the hex view - the cursor moves a byte at a time, and a hex digit typed overwrites half of the byte under it
+void editorHexKeypress(int c) {
+  int64_t last = Text.hex.size > 0 ? Text.hex.size - 1 : 0;
+  int64_t page = (int64_t)Text.screenRows * HEX_ROW_BYTES;
+  int64_t cursor = Text.hex.cursor;
+
+  switch (c) {
+    case ARROW_LEFT:
+      if (cursor > 0) cursor--;
+      break;
+    case ARROW_RIGHT:
+      if (cursor < last) cursor++;
+      break;
+    case ARROW_UP:
+      if (cursor >= HEX_ROW_BYTES) cursor -= HEX_ROW_BYTES;
+      break;
+    case ARROW_DOWN:
+      if (cursor + HEX_ROW_BYTES <= last) cursor += HEX_ROW_BYTES;
+      break;
+    case PAGE_UP:
+      cursor = cursor >= page ? cursor - page : cursor % HEX_ROW_BYTES;
+      break;
+    case PAGE_DOWN:
+      cursor = cursor + page <= last ? cursor + page : last;
+      break;
+    case HOME_KEY:
+      cursor -= cursor % HEX_ROW_BYTES;
+      break;
+    case END_KEY:
+      cursor = cursor - cursor % HEX_ROW_BYTES + HEX_ROW_BYTES - 1 < last ? cursor - cursor % HEX_ROW_BYTES + HEX_ROW_BYTES - 1 : last;
+      break;
+    case CTRL_KEY('s'):
+      hexSave();
+      return;
+    case CTRL_KEY('g'):
+      editorHexGoto();
+      return;
+    case CTRL_KEY('t'):
+      editorSetStatusMessage("%lld bytes changed | patch map %.1f KB", (long long)Text.hex.patchCount,
+        Text.hex.patchCapacity * sizeof(hexPatch) / 1024.0);
+      return;
+    case CTRL_KEY('l'):
+      editorFrameReset();
+      return;
+    case '\x1b':
+      return;
+    default:
+      if (!isxdigit(c) || Text.hex.size == 0) {
+        editorSetStatusMessage("Hex view - type hex digits to change the byte under the cursor");
+      } else if (!Text.hex.writable) {
+        editorSetStatusMessage("Read-only - the file can't be opened for writing");
+      } else {
+        int digit = isdigit(c) ? c - '0' : tolower(c) - 'a' + 10;
+        bool changed;
+        byte value = hexByte(cursor, &changed);
+        hexSetByte(cursor, Text.hex.lowNibble ? (value & 0xF0) | digit : (value & 0x0F) | (digit << 4));
+        Text.hex.lowNibble = !Text.hex.lowNibble;
+        if (!Text.hex.lowNibble && cursor < last) Text.hex.cursor++;  // both digits typed - on to the next byte
+      }
+      return;
+  }
+  Text.hex.cursor = cursor;
+  Text.hex.lowNibble = false;
+}
+
+// -----------------------------------------------------------------------------
+// true for the keys that only look at the text - the only ones a file opened with --pager takes
+bool editorViewingKey(int c) {
+  switch (c) {
+    case CTRL_KEY('q'):
+    case CTRL_KEY('f'):
+    case CTRL_KEY('g'):
+    case CTRL_KEY('t'):
+    case CTRL_KEY('l'):
+    case '\x1b':
+    case HOME_KEY:
+    case END_KEY:
+    case PAGE_UP:
+    case PAGE_DOWN:
+    case ARROW_UP:
+    case ARROW_DOWN:
+    case ARROW_LEFT:
+    case ARROW_RIGHT:
+      return true;
+  }
+  return false;
+}
+
 // -----------------------------------------------------------------------------
 // waits for a keypress and handles it
 void editorProcessKeypress() {
   static int quit_times = TIMES_TO_QUIT;
 
   int c = editorReadKey();
+  if (Text.hex.on && c != CTRL_KEY('q')) {
+    editorHexKeypress(c);
+    quit_times = TIMES_TO_QUIT;
+    return;
+  }
+  if (Text.pager.on && !editorViewingKey(c)) {
+    editorSetStatusMessage("Read-only - the file was opened with --pager");
+    return;
+  }
 
   switch (c) {
     case '\r':  // Enter key
@@ -1261,12 +5103,14 @@ void editorProcessKeypress() {
       break;
 
     case CTRL_KEY('q'):  // exit program if ctrl-q is pressed
+      editorSaveWait();  // quitting part way through a save would throw it away
       if (Text.modified && quit_times > 0) {
         editorSetStatusMessage("WARNING!!! File has unsaved changes. "
           "Press Ctrl-Q %d more times to quit", quit_times);
         quit_times--;
         return;
       }
+      journalDiscard();  // the edits were saved, or the user chose to lose them
       write(STDOUT_FILENO, "\x1b[2J", 4);  // clear the screen
       write(STDOUT_FILENO, "\x1b[H", 3);  // position the cursor at the top left of the screen
       exit(0);
@@ -1276,19 +5120,32 @@ void editorProcessKeypress() {
       editorSave();
       break;
 
+    case CTRL_KEY('r'):
+      editorSaveWait();  // the save is still writing rows the reload would free
+      editorReload();
+      break;
+
     case HOME_KEY:
       Text.cursorXPosition = 0;
       break;
 
     case END_KEY:
       if (Text.cursorYPosition < Text.totalRows)
-        Text.cursorXPosition = Text.row[Text.cursorYPosition].length;
+        Text.cursorXPosition = editorRowAt(Text.cursorYPosition)->length;
       break;
 
     case CTRL_KEY('f'):
       editorFind();
       break;
 
+    case CTRL_KEY('g'):
+      editorGotoLine();
+      break;
+
+    case CTRL_KEY('t'):
+      editorShowMemory();
+      break;
+
     case BACKSPACE:      // mapped to 127
     case CTRL_KEY('h'):  // sends the control code 8, which is originally what the Backspace character would send back in the day
     case DELETE_KEY:        // mapped to <esc>[3~ (as seen in chapter 3)
@@ -1319,7 +5176,10 @@ void editorProcessKeypress() {
       editorMoveCursor(c);
       break;
 
-    case CTRL_KEY('l'):  // ctrl-L is traditionally used to refresh the screen in terminal programs (we do nothing because the screen is refreshed with every keypress by default)
+    case CTRL_KEY('l'):  // ctrl-L is traditionally used to refresh the screen in terminal programs
+      editorFrameReset();  // every line is drawn again, in case something other than the editor wrote to the terminal
+      break;
+
     case '\x1b':  // escape - we ignore escape because there are many escape sequences we aren't handling, such as F1-F12
       break;
 
@@ -1331,6 +5191,970 @@ void editorProcessKeypress() {
   quit_times = TIMES_TO_QUIT;
 }
 
+/*** benchmarks ***/
+// 888888b.   8888888888 888b    888  .d8888b.  888    888 888b     d888        d8888 8888888b.  888    d8P   .d8888b.  
+// 888  "88b  888        8888b   888 d88P  Y88b 888    888 8888b   d8888       d88888 888   Y88b 888   d8P   d88P  Y88b 
+// 888  .88P  888        88888b  888 888    888 888    888 88888b.d88888      d88P888 888    888 888  d8P    Y88b.      
+// 8888888K.  8888888    888Y88b 888 888        8888888888 888Y88888P888     d88P 888 888   d88P 888d88K      "Y888b.   
+// 888  "Y88b 888        888 Y88b888 888        888    888 888 Y888P 888    d88P  888 8888888P"  8888888b        "Y88b. 
+// 888    888 888        888  Y88888 888    888 888    888 888  Y8P  888   d88P   888 888 T88b   888  Y88b         "888 
+// 888   d88P 888        888   Y8888 Y88b  d88P 888    888 888   "   888  d8888888888 888  T88b  888   Y88b  Y88b  d88P 
+// 8888888P"  8888888888 888    Y888  "Y8888P"  888    888 888       888 d88P     888 888   T88b 888    Y88b  "Y8888P"  
+
+#define BENCHMARK_ROW_LENGTH  (1 << 20)  // the typing benchmark edits the middle of a 1 MB row
+#define BENCHMARK_KEYS        100000  // the quantity of characters typed (and then backspaced) by the typing benchmark
+#define BENCHMARK_CODE_LENGTH (1 << 14)  // the keystroke benchmark edits the middle of a 16 KB row of highlighted C
+#define BENCHMARK_CODE_KEYS   1000  // the quantity of characters typed (and then backspaced) by the keystroke benchmark
+#define BENCHMARK_LOAD_LINES  2000000  // the quantity of lines in the file the load benchmark writes and then opens
+#define BENCHMARK_SCREEN_ROWS 50  // the load and stress benchmarks time how long it takes until a screen of this many rows can be drawn
+#define BENCHMARK_SAVE_LINE   1024  // the save benchmark's text is made of lines this long, newline included
+#define BENCHMARK_TAIL_LINES  200  // and it checks rewriting just the tail of a file with this many lines
+#define BENCHMARK_JOURNAL_LINES 100000  // the journal benchmark types BENCHMARK_KEYS characters across a file of this many lines
+#define BENCHMARK_PAGER_BUDGET (4 << 20)  // the pager benchmark pages through the load benchmark's file with this much memory for rows
+#define BENCHMARK_GOTOS       1000  // and then goes to this many lines picked at random
+#define BENCHMARK_HEX_SIZE    (10LL << 30)  // the hex benchmark opens a sparse file this big - it takes no room on the disk
+#define BENCHMARK_HEX_EDITS   1000  // and changes this many bytes of it, half of them in runs next to each other, then saves them
+#define BENCHMARK_REDRAW_LINES 2000  // the redraw benchmark types into, and goes down through, a text of this many lines of C
+#define BENCHMARK_SCREEN_COLUMNS 160  // on a screen BENCHMARK_SCREEN_ROWS by this many columns
+#define BENCHMARK_FRAMES      2000  // the frames benchmark draws the screen this many times each way
+#define BENCHMARK_BURST_KEYS  1000  // the burst benchmark replays this many keys typed faster than the screen can be drawn
+#ifndef STRESS_FILE_SIZE  // build with -DSTRESS_FILE_SIZE=... to run the stress test on a smaller file
+#define STRESS_FILE_SIZE      (5LL << 30)  // the stress test writes, opens, edits and saves a 5 GB file
+#endif
+#define STRESS_LONG_LINE      ((1LL << 31) + 4096)  // the first line of the stress test file is too long for an int to count
+#define STRESS_LINE_LENGTH    100  // the rest of its lines are this many bytes long, newline included
+
+// -----------------------------------------------------------------------------
+// returns the time in seconds since an arbitrary fixed point - used to time the benchmarks
+double benchmarkClock() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+// -----------------------------------------------------------------------------
+// types characters into the middle of a long row and then backspaces over them, first through the row's gap buffer and then the way
+// rows used to be edited (realloc() to the exact new size and memmove() the rest of the row every keystroke) for comparison
+void benchmarkTyping() {
+  char *line = malloc(BENCHMARK_ROW_LENGTH);
+  memset(line, 'a', BENCHMARK_ROW_LENGTH);
+  int middle = BENCHMARK_ROW_LENGTH / 2;
+
+  textRow row;
+  editorInitRow(&row, line, BENCHMARK_ROW_LENGTH);
+  double start = benchmarkClock();
+  for (int i = 0; i < BENCHMARK_KEYS; i++) rowGapInsert(&row, middle + i, 'x');
+  double gapTyping = benchmarkClock() - start;
+  start = benchmarkClock();
+  for (int i = BENCHMARK_KEYS; i > 0; i--) rowGapDelete(&row, middle + i - 1);
+  double gapDeleting = benchmarkClock() - start;
+
+  char *flat = line;  // the old way - one realloc() and one memmove() of the rest of the row per keystroke
+  int flatLength = BENCHMARK_ROW_LENGTH;
+  start = benchmarkClock();
+  for (int i = 0; i < BENCHMARK_KEYS; i++) {
+    flat = realloc(flat, flatLength + 2);
+    memmove(&flat[middle + i + 1], &flat[middle + i], flatLength - (middle + i));
+    flat[middle + i] = 'x';
+    flatLength++;
+  }
+  double flatTyping = benchmarkClock() - start;
+  start = benchmarkClock();
+  for (int i = BENCHMARK_KEYS; i > 0; i--) {
+    memmove(&flat[middle + i - 1], &flat[middle + i], flatLength - (middle + i));
+    flatLength--;
+  }
+  double flatDeleting = benchmarkClock() - start;
+
+  if (row.length != flatLength || memcmp(editorRowText(&row), flat, flatLength) != 0) printf("typing: rows do not match!\n");
+
+  printf("typing %d characters into the middle of a %d character row, then backspacing them\n", BENCHMARK_KEYS, BENCHMARK_ROW_LENGTH);
+  printf("  gap buffer:       typing %8.3f s (%7.0f ns/key)  deleting %8.3f s (%7.0f ns/key)\n",
+    gapTyping, gapTyping * 1e9 / BENCHMARK_KEYS, gapDeleting, gapDeleting * 1e9 / BENCHMARK_KEYS);
+  printf("  realloc+memmove:  typing %8.3f s (%7.0f ns/key)  deleting %8.3f s (%7.0f ns/key)\n",
+    flatTyping, flatTyping * 1e9 / BENCHMARK_KEYS, flatDeleting, flatDeleting * 1e9 / BENCHMARK_KEYS);
+
+  free(row.characters);
+  free(flat);
+}
+
+// -----------------------------------------------------------------------------
+// types into the middle of a long row of C with highlighting turned on, first with the display and highlighting patched in place and
+// then rebuilding both for the whole row every keystroke the way editorRowInsertChar() and editorRowDelChar() used to
+void benchmarkKeystroke() {
+  char *code = "if (x == 1) { y = \"s\"; } /* c */ int z = 42; ";
+  int codeLength = strlen(code);
+  char *typed = "count = count + 1; ";  // what gets typed - plain code, so the highlighting only changes near the cursor
+  int typedLength = strlen(typed);
+  char *line = malloc(BENCHMARK_CODE_LENGTH);
+  for (int j = 0; j < BENCHMARK_CODE_LENGTH; j++) line[j] = code[j % codeLength];
+  int middle = BENCHMARK_CODE_LENGTH / 2;
+
+  Text.syntax = &syntaxDatabase[0];
+  editorInsertRow(0, line, BENCHMARK_CODE_LENGTH);
+  textRow *row = editorRowAt(0);
+  double start = benchmarkClock();
+  for (int i = 0; i < BENCHMARK_CODE_KEYS; i++) editorRowInsertChar(row, middle + i, typed[i % typedLength]);
+  double spliceTyping = benchmarkClock() - start;
+  start = benchmarkClock();
+  for (int i = BENCHMARK_CODE_KEYS; i > 0; i--) editorRowDelChar(row, middle + i - 1);
+  double spliceDeleting = benchmarkClock() - start;
+
+  start = benchmarkClock();
+  for (int i = 0; i < BENCHMARK_CODE_KEYS; i++) {
+    rowGapInsert(row, middle + i, typed[i % typedLength]);
+    editorUpdateRow(row);
+  }
+  double fullTyping = benchmarkClock() - start;
+  start = benchmarkClock();
+  for (int i = BENCHMARK_CODE_KEYS; i > 0; i--) {
+    rowGapDelete(row, middle + i - 1);
+    editorUpdateRow(row);
+  }
+  double fullDeleting = benchmarkClock() - start;
+
+  printf("typing %d characters into the middle of a %d character row of C, then backspacing them\n", BENCHMARK_CODE_KEYS, BENCHMARK_CODE_LENGTH);
+  printf("  patched in place: typing %8.3f s (%7.0f ns/key)  deleting %8.3f s (%7.0f ns/key)\n",
+    spliceTyping, spliceTyping * 1e9 / BENCHMARK_CODE_KEYS, spliceDeleting, spliceDeleting * 1e9 / BENCHMARK_CODE_KEYS);
+  printf("  whole row:        typing %8.3f s (%7.0f ns/key)  deleting %8.3f s (%7.0f ns/key)\n",
+    fullTyping, fullTyping * 1e9 / BENCHMARK_CODE_KEYS, fullDeleting, fullDeleting * 1e9 / BENCHMARK_CODE_KEYS);
+
+  editorDelRow(0);
+  Text.syntax = NULL;
+  free(line);
+}
+
+// -----------------------------------------------------------------------------
+// opens a file and makes the rows of the first screen - returns how long it took
+double benchmarkFirstScreen(char *filename) {
+  Text.screenRows = BENCHMARK_SCREEN_ROWS;
+  double start = benchmarkClock();
+  editorOpen(filename);
+  for (int64_t j = 0; j < BENCHMARK_SCREEN_ROWS && j < Text.totalRows; j++) editorRowAt(j);
+  return benchmarkClock() - start;
+}
+
+// -----------------------------------------------------------------------------
+// writes a file of BENCHMARK_LOAD_LINES log lines, with a name made from the template in filename - returns false if it can't
+bool benchmarkLogFile(char *filename) {
+  int fd = mkstemp(filename);
+  if (fd == -1) {
+    perror("mkstemp");
+    return false;
+  }
+  FILE *fp = fdopen(fd, "w");
+  for (int i = 0; i < BENCHMARK_LOAD_LINES; i++)
+    fprintf(fp, "2026-01-01T00:00:%02d.%03dZ INFO [worker-%d] request %d took %dms\n", i % 60, i % 1000, i % 16, i, i % 997);
+  fclose(fp);
+  return true;
+}
+
+// -----------------------------------------------------------------------------
+// writes a file of log lines, then times opening it (up to when the first screen can be drawn, and then the rest of it) and closing 
+// it again
+void benchmarkLoad() {
+  char filename[] = "/tmp/myEditorBenchmarkXXXXXX";
+  if (!benchmarkLogFile(filename)) return;
+
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  long residentBefore = usage.ru_maxrss;
+  double firstScreen = benchmarkFirstScreen(filename);
+  bool mapped = (Text.map.base != NULL);
+  double start = benchmarkClock();
+  editorIndexAll();
+  double opening = firstScreen + benchmarkClock() - start;
+  getrusage(RUSAGE_SELF, &usage);
+  long resident = usage.ru_maxrss - residentBefore;
+  int blocks = Text.arena.blockCount;
+  start = benchmarkClock();
+  editorClose();
+  double closing = benchmarkClock() - start;
+  unlink(filename);
+
+  printf("opening and closing a file of %d lines (%s)\n", BENCHMARK_LOAD_LINES, mapped ? "mapped" : "read");
+  printf("  first screen %8.3f s\n", firstScreen);
+  printf("  open         %8.3f s (%5.0f ns/line)  %d arena blocks, peak resident grew by %.1f MB\n",
+    opening, opening * 1e9 / BENCHMARK_LOAD_LINES, blocks, resident / 1024.0);
+  printf("  close        %8.3f s\n", closing);
+}
+
+// -----------------------------------------------------------------------------
+// writes a file of log lines and opens it, then replaces it with a copy that has one line in the middle changed, and times reloading
+// it against opening it from scratch
+void benchmarkReload() {
+  char filename[] = "/tmp/myEditorReloadXXXXXX";
+  if (!benchmarkLogFile(filename)) return;
+  double start = benchmarkClock();
+  benchmarkFirstScreen(filename);
+  editorIndexAll();
+  double opening = benchmarkClock() - start;
+  bool mapped = (Text.map.base != NULL);
+
+  char changed[sizeof(filename) + 4];
+  snprintf(changed, sizeof(changed), "%s.new", filename);
+  FILE *in = fopen(filename, "r"), *out = fopen(changed, "w");
+  char *line = NULL;
+  size_t capacity = 0;
+  for (int n = 0; getline(&line, &capacity, in) != -1; n++) fputs(n == BENCHMARK_LOAD_LINES / 2 ? "a changed line\n" : line, out);
+  free(line);
+  fclose(in);
+  fclose(out);
+  rename(changed, filename);
+
+  Text.cursorYPosition = Text.rowOffset = BENCHMARK_LOAD_LINES / 4;
+  start = benchmarkClock();
+  editorReload();
+  double reloading = benchmarkClock() - start;
+  bool ok = (Text.totalRows == BENCHMARK_LOAD_LINES && Text.cursorYPosition == BENCHMARK_LOAD_LINES / 4 &&
+             strcmp(editorRowText(editorRowAt(BENCHMARK_LOAD_LINES / 2)), "a changed line") == 0);
+  editorClose();
+  unlink(filename);
+
+  printf("reloading a file of %d lines (%s) after one line of it changed\n", BENCHMARK_LOAD_LINES, mapped ? "mapped" : "read");
+  printf("  open %8.3f s  reload %8.3f s  %s  %s\n", opening, reloading, Text.statusMessage, ok ? "" : "FAILED");
+}
+
+// -----------------------------------------------------------------------------
+// compresses a file of log lines with gzip and with zstd, then times decompressing each on its own against opening it, which 
+// decompresses it on a thread of its own while the rows are made
+void benchmarkCompressed() {
+  char filename[] = "/tmp/myEditorCompressedXXXXXX";
+  if (!benchmarkLogFile(filename)) return;
+  int fd = open(filename, O_RDONLY);
+  struct stat info;
+  fstat(fd, &info);
+  char *text = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  printf("opening a compressed file of %d lines, %.1f MB decompressed\n", BENCHMARK_LOAD_LINES, info.st_size / 1e6);
+
+  for (int format = COMPRESSION_GZIP; format <= COMPRESSION_ZSTD; format++) {
+    char compressed[sizeof(filename) + 4];
+    snprintf(compressed, sizeof(compressed), "%s%s", filename, format == COMPRESSION_GZIP ? ".gz" : ".zst");
+    codec stream;
+    if (!codecStart(&stream, format, true)) {
+      printf("  %-4s  %s\n", format == COMPRESSION_GZIP ? "gzip" : "zstd", stream.error);
+      continue;
+    }
+    size_t size = 0;
+    fd = open(compressed, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    double start = benchmarkClock();
+    bool ok = codecCompress(&stream, fd, text, info.st_size, true, &size);
+    double compressing = benchmarkClock() - start;
+    codecEnd(&stream);
+    close(fd);
+
+    codecStart(&stream, format, false);  // decompressing alone, to nowhere - as fast as opening it could go
+    fd = open(compressed, O_RDONLY);
+    int nowhere = open("/dev/null", O_WRONLY);
+    char *data = malloc(CODEC_BUFFER_SIZE);
+    bool ended = false;
+    ssize_t bytesRead;
+    start = benchmarkClock();
+    while (ok && (bytesRead = read(fd, data, CODEC_BUFFER_SIZE)) > 0) ok = codecDecompress(&stream, nowhere, data, bytesRead, &ended);
+    double decompressing = benchmarkClock() - start;
+    free(data);
+    close(nowhere);
+    close(fd);
+    codecEnd(&stream);
+
+    start = benchmarkClock();
+    const char *error = editorOpen(compressed);
+    double opening = benchmarkClock() - start;
+    ok = ok && ended && Text.totalRows == BENCHMARK_LOAD_LINES && error == NULL;
+    editorClose();
+    unlink(compressed);
+    printf("  %-4s  %5.1f MB  compress %6.3f s  decompress %6.3f s (%4.0f MB/s)  open %6.3f s (%4.0f MB/s)  %s\n",
+      format == COMPRESSION_GZIP ? "gzip" : "zstd", size / 1e6, compressing, decompressing, info.st_size / 1e6 / decompressing, opening,
+      info.st_size / 1e6 / opening, ok ? "" : "FAILED");
+  }
+  munmap(text, info.st_size);
+  unlink(filename);
+}
+
+// -----------------------------------------------------------------------------
+// draws a screen of the text from position top - returns false if a row doesn't hold the line benchmarkLogFile() wrote there
+bool benchmarkPagerScreen(int64_t top) {
+  bool ok = true;
+  for (int64_t j = top; j < top + BENCHMARK_SCREEN_ROWS && j < Text.totalRows; j++) {
+    char expected[128];
+    int i = (int)j;
+    snprintf(expected, sizeof(expected), "2026-01-01T00:00:%02d.%03dZ INFO [worker-%d] request %d took %dms", i % 60, i % 1000, i % 16, i, i % 997);
+    textRow *row = editorRowAt(j);
+    ok = ok && strcmp(row->display, expected) == 0;
+  }
+  return ok;
+}
+
+// -----------------------------------------------------------------------------
+// writes a file of log lines and opens it with --pager and a small budget, then times paging down through all of it and back up, and
+// going to lines picked at random - the window must stay in its budget the whole time
+void benchmarkPager() {
+  char filename[] = "/tmp/myEditorPagerXXXXXX";
+  if (!benchmarkLogFile(filename)) return;
+
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  long residentBefore = usage.ru_maxrss;
+  Text.screenRows = BENCHMARK_SCREEN_ROWS;
+  Text.pager.budget = BENCHMARK_PAGER_BUDGET;
+  double start = benchmarkClock();
+  editorPagerOpen(filename);
+  bool ok = benchmarkPagerScreen(0);
+  double firstScreen = benchmarkClock() - start;
+  editorIndexAll();
+  double indexing = benchmarkClock() - start - firstScreen;
+
+  ok = ok && Text.totalRows == BENCHMARK_LOAD_LINES;
+  size_t most = 0;
+  int64_t pages = 0;
+  start = benchmarkClock();
+  for (int64_t top = 0; top < Text.totalRows; top += BENCHMARK_SCREEN_ROWS, pages++) {
+    ok = benchmarkPagerScreen(top) && ok;
+    if (Text.pager.used > most) most = Text.pager.used;
+  }
+  double down = benchmarkClock() - start;
+  start = benchmarkClock();
+  for (int64_t top = Text.totalRows - BENCHMARK_SCREEN_ROWS; top >= 0; top -= BENCHMARK_SCREEN_ROWS) {
+    ok = benchmarkPagerScreen(top) && ok;
+    if (Text.pager.used > most) most = Text.pager.used;
+  }
+  double up = benchmarkClock() - start;
+  srand(1);
+  start = benchmarkClock();
+  for (int j = 0; j < BENCHMARK_GOTOS; j++) {
+    int64_t line = rand() % BENCHMARK_LOAD_LINES;
+    ok = benchmarkPagerScreen(line > BENCHMARK_SCREEN_ROWS / 2 ? line - BENCHMARK_SCREEN_ROWS / 2 : 0) && ok;
+    if (Text.pager.used > most) most = Text.pager.used;
+  }
+  double gotos = benchmarkClock() - start;
+  size_t indexBytes = Text.pager.checkpointCapacity * sizeof(int64_t);
+  getrusage(RUSAGE_SELF, &usage);
+  long resident = usage.ru_maxrss - residentBefore;
+  editorClose();
+  unlink(filename);
+
+  double mb = 1024.0 * 1024.0;
+  printf("paging through a file of %d lines with --pager=%d\n", BENCHMARK_LOAD_LINES, BENCHMARK_PAGER_BUDGET >> 20);
+  printf("  first screen %8.3f s  index %8.3f s  line index %.1f KB\n", firstScreen, indexing, indexBytes / 1024.0);
+  printf("  page down    %8.3f s (%5.1f us/page)\n", down, down * 1e6 / pages);
+  printf("  page up      %8.3f s (%5.1f us/page)\n", up, up * 1e6 / pages);
+  printf("  go to line   %8.3f s (%5.1f us/go)\n", gotos, gotos * 1e6 / BENCHMARK_GOTOS);
+  printf("  window at most %.1f MB, peak resident grew by %.1f MB  %s\n", most / mb, resident / 1024.0, ok && most <= BENCHMARK_PAGER_BUDGET ? "" : "FAILED");
+}
+
+// -----------------------------------------------------------------------------
+// opens a sparse 10 GB file in the hex view and times drawing the first screen, going to offsets picked at random and drawing the 
+// screen there, and saving bytes changed all over it - then reads the bytes back to check they were written
+void benchmarkHex() {
+  char filename[] = "/tmp/myEditorHexXXXXXX";
+  int fd = mkstemp(filename);
+  if (fd == -1 || ftruncate(fd, BENCHMARK_HEX_SIZE) == -1) {
+    perror("hex benchmark file");
+    if (fd != -1) unlink(filename);
+    return;
+  }
+  close(fd);
+  Text.screenRows = BENCHMARK_SCREEN_ROWS;
+  Text.screenColumns = 80;
+
+  double start = benchmarkClock();
+  bool ok = editorHexOpen(filename);
+  struct abuf ab = ABUF_INIT;
+  for (int y = 0; ok && y < Text.screenRows; y++) editorDrawRow(&ab, y);
+  double firstScreen = benchmarkClock() - start;
+  abFree(&ab);
+
+  srand(1);
+  start = benchmarkClock();
+  for (int j = 0; ok && j < BENCHMARK_GOTOS; j++) {
+    Text.hex.cursor = ((int64_t)rand() << 20 ^ rand()) % BENCHMARK_HEX_SIZE;
+    Text.rowOffset = Text.hex.cursor / HEX_ROW_BYTES;
+    struct abuf screen = ABUF_INIT;
+    for (int y = 0; y < Text.screenRows; y++) editorDrawRow(&screen, y);
+    abFree(&screen);
+  }
+  double gotos = benchmarkClock() - start;
+
+  int64_t offsets[BENCHMARK_HEX_EDITS];
+  for (int j = 0; ok && j < BENCHMARK_HEX_EDITS; j++) {
+    offsets[j] = (j % 2 && j > 0) ? offsets[j - 1] + 1 : ((int64_t)rand() << 20 ^ rand()) % (BENCHMARK_HEX_SIZE - 1);
+    hexSetByte(offsets[j], (byte)(j | 1));
+  }
+  start = benchmarkClock();
+  if (ok) hexSave();
+  double saving = benchmarkClock() - start;
+  char message[sizeof(Text.statusMessage)];
+  strcpy(message, Text.statusMessage);
+  fd = open(filename, O_RDONLY);
+  for (int j = 0; ok && j < BENCHMARK_HEX_EDITS; j++) {  // a later change to the same byte wins
+    byte value = 0;
+    int last = j;
+    for (int k = j + 1; k < BENCHMARK_HEX_EDITS; k++) if (offsets[k] == offsets[j]) last = k;
+    ok = pread(fd, &value, 1, offsets[j]) == 1 && value == (byte)(last | 1);
+  }
+  close(fd);
+  editorClose();
+  unlink(filename);
+
+  printf("a %lld GB sparse file in the hex view\n", BENCHMARK_HEX_SIZE >> 30);
+  printf("  open and first screen %8.3f ms\n", firstScreen * 1e3);
+  printf("  go to offset          %8.1f us/go\n", gotos * 1e6 / BENCHMARK_GOTOS);
+  printf("  save %d changes     %8.3f ms  %s  %s\n", BENCHMARK_HEX_EDITS, saving * 1e3, message, ok ? "" : "FAILED");
+}
+
+// -----------------------------------------------------------------------------
+// fills the text with lines of highlighted C for the redraw benchmark, with the cursor at the start of it
+void benchmarkRedrawText() {
+  char *code[] = { "int main(int argc, char *argv[]) {", "  /* count the arguments */", "  for (int i = 0; i < argc; i++) {",
+                   "    printf(\"%d: %s\\n\", i, argv[i]);  // one per line", "  }", "  return 42;", "}", "" };
+  int codeLines = sizeof(code) / sizeof(code[0]);
+  editorClose();
+  Text.syntax = &syntaxDatabase[0];
+  for (int j = 0; j < BENCHMARK_REDRAW_LINES; j++) editorInsertRow(j, code[j % codeLines], strlen(code[j % codeLines]));
+  Text.cursorXPosition = Text.cursorYPosition = Text.rowOffset = Text.columnOffset = 0;
+  Text.statusMessage[0] = '\0';
+}
+
+#define REDRAW_EVERY_LINE 0  // how much benchmarkRedrawKeys() lets the drawing know about what the terminal shows - nothing,
+#define REDRAW_CHANGED    1  // the lines on it but not how far the text scrolled,
+#define REDRAW_SCROLLED   2  // or both
+
+// -----------------------------------------------------------------------------
+// presses keys on the redraw benchmark's text, drawing the screen after each one, and returns the bytes that would be written to the
+// terminal. Sets *same to whether the lines kept from frame to frame are, at the end, what drawing the screen afresh gives.
+int64_t benchmarkRedrawKeys(int *keys, int count, int how, double *seconds, bool *same) {
+  benchmarkRedrawText();
+  editorFrameReset();
+  int64_t bytes = 0;
+  double start = benchmarkClock();
+  for (int i = 0; i < count; i++) {
+    if (keys[i] == '\r') editorInsertNewline();
+    else if (keys[i] == ARROW_UP || keys[i] == ARROW_DOWN) editorMoveCursor(keys[i]);
+    else editorInsertChar(keys[i]);
+    if (how == REDRAW_EVERY_LINE) editorFrameReset();  // nothing on the terminal is known, so every line is sent
+    if (how == REDRAW_CHANGED) {  // the frame is taken to show the text where it is now, so lines that scrolled are drawn again
+      editorScroll();
+      Text.frame.rowOffset = Text.rowOffset;
+    }
+    struct abuf ab = ABUF_INIT;
+    editorRenderScreen(&ab);
+    bytes += ab.len;
+    abFree(&ab);
+  }
+  *seconds = benchmarkClock() - start;
+
+  screenLine *kept = Text.frame.lines;
+  Text.frame.lines = NULL;
+  struct abuf ab = ABUF_INIT;
+  editorRenderScreen(&ab);
+  abFree(&ab);
+  *same = true;
+  for (int y = 0; y < Text.screenRows + 2; y++) {
+    screenLine *fresh = &Text.frame.lines[y];
+    *same = *same && kept[y].known && kept[y].drawn.len == fresh->drawn.len &&
+            (fresh->drawn.len == 0 || memcmp(kept[y].drawn.b, fresh->drawn.b, fresh->drawn.len) == 0);
+    abFree(&kept[y].drawn);
+  }
+  free(kept);
+  editorFrameReset();
+  editorClose();
+  Text.syntax = NULL;
+  return bytes;
+}
+
+// -----------------------------------------------------------------------------
+// types into a screen of highlighted C, and then holds down the arrow keys to go down through it and back up, drawing the screen
+// after every key - sending every line of it to the terminal, the way the screen used to be drawn, then only the lines that changed,
+// and then also letting the terminal scroll - and counts the bytes that would be written to the terminal
+void benchmarkRedraw() {
+  char *typed = "count = count + 1;\r";  // \r is the Enter key, which moves the lines under the cursor down
+  int typedLength = strlen(typed);
+  int typing[BENCHMARK_CODE_KEYS], arrows[2 * BENCHMARK_CODE_KEYS];
+  for (int i = 0; i < BENCHMARK_CODE_KEYS; i++) {
+    typing[i] = typed[i % typedLength];
+    arrows[i] = ARROW_DOWN;
+    arrows[BENCHMARK_CODE_KEYS + i] = ARROW_UP;
+  }
+  Text.screenRows = BENCHMARK_SCREEN_ROWS;
+  Text.screenColumns = BENCHMARK_SCREEN_COLUMNS;
+
+  printf("on a %dx%d screen of highlighted C, drawing the screen after every key: typing %d keys of C with Enter every %d, then\n"
+    "holding down the arrow keys to go %d lines down and back up\n",
+    BENCHMARK_SCREEN_COLUMNS, BENCHMARK_SCREEN_ROWS, BENCHMARK_CODE_KEYS, typedLength, BENCHMARK_CODE_KEYS);
+  char *names[] = { "every line", "changed lines", "and scrolling" };
+  for (int how = REDRAW_EVERY_LINE; how <= REDRAW_SCROLLED; how++) {
+    double typingSeconds, arrowSeconds;
+    bool typingSame, arrowSame;
+    int64_t typingBytes = benchmarkRedrawKeys(typing, BENCHMARK_CODE_KEYS, how, &typingSeconds, &typingSame);
+    int64_t arrowBytes = benchmarkRedrawKeys(arrows, 2 * BENCHMARK_CODE_KEYS, how, &arrowSeconds, &arrowSame);
+    printf("  %-14s typing %6.0f bytes/key %7.3f ms   arrows %6.0f bytes/key %7.3f ms  %s\n", names[how],
+      (double)typingBytes / BENCHMARK_CODE_KEYS, typingSeconds * 1e3, (double)arrowBytes / (2 * BENCHMARK_CODE_KEYS), arrowSeconds * 1e3,
+      typingSame && arrowSame ? "" : "FAILED: the kept lines are not what the screen shows");
+  }
+}
+
+// -----------------------------------------------------------------------------
+// times drawing a screen of dense highlighted C with editorRefreshScreen(), its output going to /dev/null - every line of it, as if
+// the terminal showed nothing, and then only what changed while the cursor moves along a line - and prints the frames per second
+void benchmarkFrames() {
+  char *code = "if (x == 1) { y = \"s\"; } /* c */ int z = 42; ";  // a color change every few characters
+  int codeLength = strlen(code);
+  char line[BENCHMARK_SCREEN_COLUMNS];
+  for (int j = 0; j < BENCHMARK_SCREEN_COLUMNS; j++) line[j] = code[j % codeLength];
+  editorClose();
+  Text.syntax = &syntaxDatabase[0];
+  for (int j = 0; j < 2 * BENCHMARK_SCREEN_ROWS; j++) editorInsertRow(j, line, BENCHMARK_SCREEN_COLUMNS - 1);
+  Text.screenRows = BENCHMARK_SCREEN_ROWS;
+  Text.screenColumns = BENCHMARK_SCREEN_COLUMNS;
+  Text.cursorXPosition = Text.cursorYPosition = Text.rowOffset = Text.columnOffset = 0;
+  Text.statusMessage[0] = '\0';
+
+  fflush(stdout);
+  int terminal = dup(STDOUT_FILENO),
+      null = open("/dev/null", O_WRONLY);
+  dup2(null, STDOUT_FILENO);
+  double start = benchmarkClock();
+  for (int i = 0; i < BENCHMARK_FRAMES; i++) {
+    editorFrameReset();
+    editorRefreshScreen();
+  }
+  double everyLine = benchmarkClock() - start;
+  start = benchmarkClock();
+  for (int i = 0; i < BENCHMARK_FRAMES; i++) {
+    Text.cursorXPosition = i % (BENCHMARK_SCREEN_COLUMNS - 1);
+    editorRefreshScreen();
+  }
+  double changed = benchmarkClock() - start;
+  dup2(terminal, STDOUT_FILENO);
+  close(terminal);
+  close(null);
+  editorFrameReset();
+  editorClose();
+  Text.syntax = NULL;
+
+  printf("drawing a %dx%d screen of dense highlighted C %d times\n", BENCHMARK_SCREEN_COLUMNS, BENCHMARK_SCREEN_ROWS, BENCHMARK_FRAMES);
+  printf("  every line:    %8.0f frames/s  (%6.1f us/frame)\n", BENCHMARK_FRAMES / everyLine, everyLine * 1e6 / BENCHMARK_FRAMES);
+  printf("  changed lines: %8.0f frames/s  (%6.1f us/frame)\n", BENCHMARK_FRAMES / changed, changed * 1e6 / BENCHMARK_FRAMES);
+}
+
+// -----------------------------------------------------------------------------
+// copies the lines the terminal shows now into one string, for the burst benchmark to compare how two ways of drawing ended up
+char *benchmarkFrameCopy() {
+  struct abuf copy = ABUF_INIT;
+  for (int y = 0; y < Text.frame.rows + 2; y++) abAppend(&copy, Text.frame.lines[y].drawn.b, Text.frame.lines[y].drawn.len);
+  abAppend(&copy, "", 1);
+  return copy.b;
+}
+
+// -----------------------------------------------------------------------------
+// replays a burst of keys typed into a screen of highlighted C, all of them waiting to be read, through the main loop - first
+// drawing a frame after every key, the way the main loop used to, then only when editorFrameDue() says to - and counts the frames
+// and the bytes written to the terminal, which is /dev/null. The keys come down a pipe that takes the place of standard input.
+void benchmarkBurst() {
+  char *typed = "count = count + 1;\r";  // \r is the Enter key
+  int typedLength = strlen(typed);
+  char keys[BENCHMARK_BURST_KEYS];
+  for (int i = 0; i < BENCHMARK_BURST_KEYS; i++) keys[i] = typed[i % typedLength];
+  Text.screenRows = BENCHMARK_SCREEN_ROWS;
+  Text.screenColumns = BENCHMARK_SCREEN_COLUMNS;
+  int input[2];
+  if (pipe(input) == -1) {
+    perror("pipe");
+    return;
+  }
+  fflush(stdout);
+  int terminal = dup(STDOUT_FILENO),
+      keyboard = dup(STDIN_FILENO),
+      null = open("/dev/null", O_WRONLY);
+  dup2(null, STDOUT_FILENO);
+  dup2(input[0], STDIN_FILENO);
+
+  int frames[2];
+  int64_t bytes[2];
+  double seconds[2];
+  char *screens[2];
+  for (int coalesce = 0; coalesce < 2; coalesce++) {
+    benchmarkRedrawText();
+    editorFrameReset();
+    editorRefreshScreen();  // the screen before the burst
+    write(input[1], keys, BENCHMARK_BURST_KEYS);
+    frames[coalesce] = 0;
+    bytes[coalesce] = 0;
+    double start = benchmarkClock();
+    while (keyWaiting()) {
+      if (coalesce) do editorProcessKeypress(); while (!editorFrameDue());
+      else editorProcessKeypress();
+      editorRefreshScreen();
+      frames[coalesce]++;
+      bytes[coalesce] += Text.frame.output.len;
+    }
+    seconds[coalesce] = benchmarkClock() - start;
+    screens[coalesce] = benchmarkFrameCopy();
+  }
+  bool same = !strcmp(screens[0], screens[1]);
+
+  dup2(terminal, STDOUT_FILENO);
+  dup2(keyboard, STDIN_FILENO);
+  close(terminal);
+  close(keyboard);
+  close(null);
+  close(input[0]);
+  close(input[1]);
+  free(screens[0]);
+  free(screens[1]);
+  editorFrameReset();
+  editorClose();
+  Text.syntax = NULL;
+
+  printf("a burst of %d keys of C, Enter every %d, waiting to be read on a %dx%d screen of highlighted C\n",
+    BENCHMARK_BURST_KEYS, typedLength, BENCHMARK_SCREEN_COLUMNS, BENCHMARK_SCREEN_ROWS);
+  printf("  a frame per key: %5d frames %9lld bytes %8.3f ms\n", frames[0], (long long)bytes[0], seconds[0] * 1e3);
+  printf("  coalesced:       %5d frames %9lld bytes %8.3f ms  %s\n", frames[1], (long long)bytes[1], seconds[1] * 1e3,
+    same ? "" : "FAILED: the screen ended up different");
+}
+
+// -----------------------------------------------------------------------------
+// prints how fast one way of finding the lines of a file went
+void benchmarkIndexReport(const char *name, double seconds, size_t bytes, int64_t lines) {
+  printf("  %-18s %8.3f s  %6.2f GB/s  %7.1f M lines/s  (%lld lines)\n",
+    name, seconds, bytes / seconds / (1 << 30), lines / seconds / 1e6, (long long)lines);
+}
+
+// -----------------------------------------------------------------------------
+// times finding the lines of a file of log lines the old way, with getline(), then each way of finding its newlines in memory
+void benchmarkIndex() {
+  char filename[] = "/tmp/myEditorBenchmarkXXXXXX";
+  if (!benchmarkLogFile(filename)) return;
+
+  FILE *fp = fopen(filename, "r");
+  char *line = NULL;
+  size_t lineCapacity = 0;
+  int64_t lines = 0;
+  double start = benchmarkClock();
+  while (getline(&line, &lineCapacity, fp) != -1) lines++;
+  double reading = benchmarkClock() - start;
+  free(line);
+
+  struct stat info;
+  fstat(fileno(fp), &info);
+  size_t size = info.st_size;
+  char *text = malloc(size);
+  rewind(fp);
+  size = fread(text, 1, size, fp);
+  fclose(fp);
+  unlink(filename);
+
+  printf("finding the lines of a %.1f MB file of %d lines\n", size / (1024.0 * 1024.0), BENCHMARK_LOAD_LINES);
+  benchmarkIndexReport("getline", reading, size, lines);
+
+  struct {
+    const char *name;
+    void (*scan)(const char *, size_t, size_t, newlineIndex *);
+    bool usable;
+  } scanners[] = {
+    { "memchr", scanNewlinesScalar, true },
+#if defined(__x86_64__) || defined(__i386__)
+    { "SSE2", scanNewlinesSSE2, __builtin_cpu_supports("sse2") },
+    { "AVX2", scanNewlinesAVX2, __builtin_cpu_supports("avx2") },
+#endif
+    { "threads", indexNewlines, true },
+  };
+  for (unsigned int j = 0; j < sizeof(scanners) / sizeof(scanners[0]); j++) {
+    if (!scanners[j].usable) continue;
+    newlineIndex newlines = { NULL, 0, 0 };
+    start = benchmarkClock();
+    scanners[j].scan(text, 0, size, &newlines);
+    double scanning = benchmarkClock() - start;
+    char name[32];
+    if (scanners[j].scan == indexNewlines) snprintf(name, sizeof(name), "%d threads", newlineThreads());
+    else snprintf(name, sizeof(name), "%s", scanners[j].name);
+    benchmarkIndexReport(name, scanning, size, newlines.count);
+    if (newlines.count != lines) printf("  FAILED: %s found %lld newlines, not %lld\n", name, (long long)newlines.count, (long long)lines);
+    free(newlines.offsets);
+  }
+  free(text);
+}
+
+// -----------------------------------------------------------------------------
+// fills line with short line n of the stress test file - a null terminated line of STRESS_LINE_LENGTH bytes, newline included
+void stressLine(char *line, int64_t n) {
+  int length = snprintf(line, STRESS_LINE_LENGTH, "line %012lld ", (long long)n);
+  memset(&line[length], '.', STRESS_LINE_LENGTH - 1 - length);
+  line[STRESS_LINE_LENGTH - 1] = '\n';
+  line[STRESS_LINE_LENGTH] = '\0';
+}
+
+// -----------------------------------------------------------------------------
+// reads the bytes at offset of a file and checks they are the expected string
+bool stressCheck(int fd, int64_t offset, const char *expected) {
+  char found[STRESS_LINE_LENGTH + 1];
+  size_t length = strlen(expected);
+  return pread(fd, found, length, offset) == (ssize_t)length && !memcmp(found, expected, length);
+}
+
+// -----------------------------------------------------------------------------
+// types BENCHMARK_KEYS characters into a file spread over its lines, without the journal and then with it, to show what journaling 
+// an edit costs the keystroke - then how long writing the whole journal and syncing it takes the journal thread
+void benchmarkJournal() {
+  char filename[] = "/tmp/myEditorJournalXXXXXX";
+  int fd = mkstemp(filename);
+  if (fd == -1) {
+    perror("mkstemp");
+    return;
+  }
+  FILE *fp = fdopen(fd, "w");
+  for (int n = 1; n <= BENCHMARK_JOURNAL_LINES; n++) fprintf(fp, "line %d of the journal benchmark\n", n);
+  fclose(fp);
+  editorOpen(filename);
+
+  double timed[2];
+  for (int journaled = -1; journaled < 2; journaled++) {  // the first time round is only to make the rows, so both timings edit made rows
+    Text.journal.on = (journaled == 1);
+    double start = benchmarkClock();
+    for (int i = 0; i < BENCHMARK_KEYS; i++) {
+      int64_t at = (int64_t)i * 7919 % BENCHMARK_JOURNAL_LINES;  // a different row each key, so each one has its position worked out
+      editorRowInsertChar(editorRowAt(at), 0, 'a' + i % 26);
+    }
+    if (journaled >= 0) timed[journaled] = benchmarkClock() - start;
+  }
+  size_t records = Text.journal.pendingLength;
+  double start = benchmarkClock();
+  journalCommit(true);
+  journalDrain();
+  double syncing = benchmarkClock() - start;
+  struct stat info;
+  bool ok = (Text.journal.fd != -1 && fstat(Text.journal.fd, &info) == 0 && (size_t)info.st_size == records);
+
+  journalDiscard();
+  Text.journal.on = false;
+  editorClose();
+  unlink(filename);
+
+  printf("typing %d characters across a file of %d lines, then writing the journal and syncing it\n", BENCHMARK_KEYS, BENCHMARK_JOURNAL_LINES);
+  printf("  no journal %8.3f s (%5.0f ns/key)  journaled %8.3f s (%5.0f ns/key)  journal %.1f KB written and synced in %.3f s  %s\n",
+    timed[0], timed[0] * 1e9 / BENCHMARK_KEYS, timed[1], timed[1] * 1e9 / BENCHMARK_KEYS, records / 1024.0, syncing, ok ? "" : "FAILED");
+}
+
+// -----------------------------------------------------------------------------
+// times saving a text of size bytes in place, in place followed by fdatasync(), and atomically (see editorSaveAtomic())
+void benchmarkSaveSize(size_t size) {
+  char filename[] = "/tmp/myEditorBenchmarkXXXXXX";
+  int fd = mkstemp(filename);
+  if (fd == -1) {
+    perror("mkstemp");
+    return;
+  }
+  close(fd);
+
+  char *chunk = malloc(OPEN_READ_SIZE);  // a megabyte of lines, appended to the text over and over
+  for (int j = 0; j < OPEN_READ_SIZE; j++) chunk[j] = (j % BENCHMARK_SAVE_LINE == BENCHMARK_SAVE_LINE - 1) ? '\n' : 'a' + j % 26;
+  for (size_t done = 0; done < size; done += OPEN_READ_SIZE)
+    editorAppendRows(chunk, size - done < OPEN_READ_SIZE ? size - done : OPEN_READ_SIZE, true, ORIGINAL_BUFFER);
+  free(chunk);
+  size_t len = 0, atomicLen = 0;  // a save that fails early leaves them as they were
+
+  double start = benchmarkClock();
+  bool ok = editorSaveInPlace(filename, editorWriteRows, &len);
+  double inPlace = benchmarkClock() - start;
+  fd = open(filename, O_RDONLY);
+  start = benchmarkClock();
+  ok = ok && fd != -1 && fdatasync(fd) == 0;  // what it costs to make the in-place save reach the disk
+  double syncing = benchmarkClock() - start;
+  if (fd != -1) close(fd);
+  start = benchmarkClock();
+  ok = ok && editorSaveAtomic(filename, editorWriteRows, &atomicLen) && atomicLen == len;
+  double atomic = benchmarkClock() - start;
+
+  struct stat info;
+  ok = ok && stat(filename, &info) == 0 && (size_t)info.st_size == len;
+  unlink(filename);
+  editorClose();
+
+  printf("  %7.1f MB  in place %8.3f s  + fdatasync %8.3f s  atomic %8.3f s  %s\n", len / (1024.0 * 1024.0), inPlace, 
+    inPlace + syncing, atomic, ok ? "" : "FAILED");
+}
+
+// -----------------------------------------------------------------------------
+// types a character into the next to last line of a small file with \n or \r\n line ends and saves it, then reads the file back to
+// check it holds the text - \n lines are saved by rewriting just the tail, \r\n lines by writing the whole file with \n line ends
+void benchmarkSaveTail(bool crlf) {
+  char filename[] = "/tmp/myEditorBenchmarkXXXXXX";
+  int fd = mkstemp(filename);
+  if (fd == -1) {
+    perror("mkstemp");
+    return;
+  }
+  FILE *fp = fdopen(fd, "w");
+  for (int n = 0; n < BENCHMARK_TAIL_LINES; n++) fprintf(fp, "line %03d%s\n", n, crlf ? "\r" : "");
+  fclose(fp);
+
+  editorOpen(filename);
+  editorRowInsertChar(editorRowAt(BENCHMARK_TAIL_LINES - 2), 2, 'X');
+  double start = benchmarkClock();
+  editorSave();
+  editorSaveWait();
+  double saving = benchmarkClock() - start;
+  bool ok = !Text.modified && Text.save.tailFrom == (crlf ? -1 : (BENCHMARK_TAIL_LINES - 2) * 9);
+  editorClose();
+
+  char expected[BENCHMARK_TAIL_LINES * 10], found[sizeof(expected)];
+  size_t length = 0;
+  for (int n = 0; n < BENCHMARK_TAIL_LINES; n++)
+    length += sprintf(&expected[length], n == BENCHMARK_TAIL_LINES - 2 ? "liXne %03d\n" : "line %03d\n", n);
+  fd = open(filename, O_RDONLY);
+  ok = ok && fd != -1 && read(fd, found, sizeof(found)) == (ssize_t)length && !memcmp(found, expected, length);
+  if (fd != -1) close(fd);
+  unlink(filename);
+
+  printf("  %-4s lines  one edit near the end saved in %.6f s, %s  %s\n", crlf ? "CRLF" : "LF", saving,
+    crlf ? "whole file written" : "only the tail rewritten", ok ? "" : "FAILED");
+}
+
+// -----------------------------------------------------------------------------
+// times saving texts of 1 MB, 100 MB and 1 GB each way editorSave() can
+void benchmarkSave() {
+  printf("saving one edit near the end of a file of %d lines\n", BENCHMARK_TAIL_LINES);
+  benchmarkSaveTail(false);
+  benchmarkSaveTail(true);
+  printf("saving in place, in place with fdatasync(), and atomically (temp file, fdatasync(), rename(), fsync() of the directory)\n");
+  benchmarkSaveSize(1 << 20);
+  benchmarkSaveSize(100 << 20);
+  benchmarkSaveSize(1 << 30);
+}
+
+// -----------------------------------------------------------------------------
+// writes a STRESS_FILE_SIZE file whose first line is longer than 2 GB, opens it, types past the 2 GB mark of that line, deletes a row
+// and inserts one, then saves it and reads the file back to check the edits landed where they should. Also reports how much the
+// peak resident memory grew while saving, which would be the size of the file if saving made a copy of the text.
+void benchmarkStress() {
+  char filename[] = "/tmp/myEditorStressXXXXXX";
+  int fd = mkstemp(filename);
+  if (fd == -1) {
+    perror("mkstemp");
+    return;
+  }
+  int64_t lines = (STRESS_FILE_SIZE - STRESS_LONG_LINE - 1) / STRESS_LINE_LENGTH;  // the quantity of short lines after the long one
+  if (lines < 2) lines = 2;
+  char line[STRESS_LINE_LENGTH + 1];
+
+  double start = benchmarkClock();
+  FILE *fp = fdopen(fd, "w");
+  size_t chunkLength = 26 << 15;  // a whole number of alphabets, so the chunks join up into one long alphabet
+  char *chunk = malloc(chunkLength);
+  for (size_t j = 0; j < chunkLength; j++) chunk[j] = 'a' + j % 26;
+  for (int64_t done = 0; done < STRESS_LONG_LINE; done += chunkLength)
+    fwrite(chunk, 1, STRESS_LONG_LINE - done < (int64_t)chunkLength ? (size_t)(STRESS_LONG_LINE - done) : chunkLength, fp);
+  fputc('\n', fp);
+  free(chunk);
+  for (int64_t n = 1; n <= lines; n++) {
+    stressLine(line, n);
+    fwrite(line, 1, STRESS_LINE_LENGTH, fp);
+  }
+  if (fclose(fp) != 0) {
+    perror("writing the stress test file");
+    unlink(filename);
+    return;
+  }
+  double writing = benchmarkClock() - start;
+
+  double firstScreen = benchmarkFirstScreen(filename);
+  start = benchmarkClock();
+  editorIndexAll();
+  double opening = firstScreen + benchmarkClock() - start;
+  bool ok = (Text.totalRows == lines + 1 && editorRowAt(0)->length == STRESS_LONG_LINE);
+
+  start = benchmarkClock();
+  textRow *row = editorRowAt(0);
+  editorRowInsertChar(row, row->length, 'X');  // type two characters at the end of the long line and backspace over one
+  editorRowInsertChar(row, row->length, 'Y');
+  editorRowDelChar(row, row->length - 1);
+  editorDelRow(1);  // delete the first short line
+  int64_t middle = Text.totalRows / 2;
+  stressLine(line, 0);  // and put a line 0 in the middle
+  editorInsertRow(middle, line, STRESS_LINE_LENGTH - 1);
+  double editing = benchmarkClock() - start;
+
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  long residentBefore = usage.ru_maxrss;
+  start = benchmarkClock();
+  editorSave();
+  editorSaveWait();
+  double saving = benchmarkClock() - start;
+  getrusage(RUSAGE_SELF, &usage);
+  ok = ok && !Text.modified;
+  editorClose();
+
+  fd = open(filename, O_RDONLY);
+  struct stat info;
+  int64_t size = STRESS_LONG_LINE + 2 + lines * STRESS_LINE_LENGTH;  // the long line, the X and its newline, and the same quantity of short lines
+  ok = ok && fd != -1 && fstat(fd, &info) == 0 && info.st_size == size;
+  int64_t past = (1LL << 31) + 5;
+  char expected[2] = { 'a' + past % 26, '\0' };
+  ok = ok && stressCheck(fd, past, expected) && stressCheck(fd, STRESS_LONG_LINE, "X\n");
+  stressLine(line, 2);
+  ok = ok && stressCheck(fd, STRESS_LONG_LINE + 2, line);  // line 1 is gone
+  stressLine(line, 0);
+  ok = ok && stressCheck(fd, STRESS_LONG_LINE + 2 + (middle - 1) * STRESS_LINE_LENGTH, line);
+  stressLine(line, middle + 1);
+  ok = ok && stressCheck(fd, STRESS_LONG_LINE + 2 + middle * STRESS_LINE_LENGTH, line);
+  stressLine(line, lines);
+  ok = ok && stressCheck(fd, size - STRESS_LINE_LENGTH, line);
+  if (fd != -1) close(fd);
+  unlink(filename);
+
+  printf("writing, opening, editing and saving a %.2f GB file of %lld lines, the first one %lld bytes long\n",
+    (double)size / (1 << 30), (long long)lines + 1, (long long)STRESS_LONG_LINE);
+  printf("  write %8.3f s\n  open  %8.3f s (first screen after %.3f s)\n  edit  %8.3f s\n", writing, opening, firstScreen, editing);
+  printf("  save  %8.3f s  peak resident grew by %.1f MB while saving (peak %.1f MB)\n",
+    saving, (usage.ru_maxrss - residentBefore) / 1024.0, usage.ru_maxrss / 1024.0);
+  printf("  %s\n", ok ? "saved file checks out" : "FAILED: the saved file is not what was expected");
+}
+
+typedef struct benchmark {
+  char *name;  // the name given after --benchmark on the command line
+  void (*run)();  // the function that runs the benchmark and prints its results
+  bool inAll;  // false for benchmarks too big to run as part of "all"
+} benchmark;
+
+benchmark benchmarks[] = {
+  { "typing", benchmarkTyping, true },
+  { "keystroke", benchmarkKeystroke, true },
+  { "load", benchmarkLoad, true },
+  { "index", benchmarkIndex, true },
+  { "journal", benchmarkJournal, true },
+  { "reload", benchmarkReload, true },
+  { "compressed", benchmarkCompressed, true },
+  { "pager", benchmarkPager, true },
+  { "hex", benchmarkHex, true },
+  { "redraw", benchmarkRedraw, true },
+  { "frames", benchmarkFrames, true },
+  { "burst", benchmarkBurst, true },
+  { "save", benchmarkSave, false },
+  { "stress", benchmarkStress, false },
+};
+
+#define BENCHMARK_ENTRIES (sizeof(benchmarks) / sizeof(benchmarks[0]))
+
+// -----------------------------------------------------------------------------
+// runs the named benchmark (or all of them for "all") without touching the terminal - returns the program's exit code
+int editorBenchmark(char *name) {
+  int found = 0;
+  for (unsigned int j = 0; j < BENCHMARK_ENTRIES; j++) {
+    if ((!strcmp(name, "all") && benchmarks[j].inAll) || !strcmp(name, benchmarks[j].name)) {
+      benchmarks[j].run();
+      found = 1;
+    }
+  }
+  if (found) return 0;
+
+  fprintf(stderr, "unknown benchmark: %s - choose one of: all", name);
+  for (unsigned int j = 0; j < BENCHMARK_ENTRIES; j++) fprintf(stderr, ", %s", benchmarks[j].name);
+  fprintf(stderr, "\n");
+  return 1;
+}
+
 /*** init ***/
 // 8888888 888b    888 8888888 88888888888 
 //   888   8888b   888   888       888     
@@ -1350,8 +6174,40 @@ void initEditor() {
   Text.rowOffset = 0;  // we'll be scrolled to the top of the file by default
   Text.columnOffset = 0;  // we'll be scrolled to the left of the file by default
   Text.totalRows = 0;
-  Text.row = NULL;
+  Text.rows.original = NULL;
+  Text.rows.addBlocks = NULL;
+  Text.rows.originalRows = 0;
+  Text.rows.originalCapacity = 0;
+  Text.rows.addRows = 0;
+  Text.rows.root = NULL;
+  Text.arena.blocks = NULL;
+  Text.arena.blockCount = 0;
+  Text.arena.ownedRows = NULL;
+  Text.arena.ownedCount = 0;
+  Text.arena.ownedCapacity = 0;
+  Text.arena.used = 0;
+  Text.arena.size = 0;
+  Text.arena.open = false;
+  Text.map.base = NULL;
+  Text.map.size = 0;
+  Text.map.indexed = 0;
+  Text.map.lineStart = NULL;
+  Text.map.lineCapacity = 0;
+  Text.map.rowBlocks = NULL;
+  Text.map.blockCount = 0;
+  Text.atomicSave = false;
+  Text.compression = COMPRESSION_NONE;
   Text.modified = false;
+  Text.dirtyFrom = INT64_MAX;
+  Text.savedKnown = false;
+  Text.reload.changedFrom = INT64_MAX;
+  Text.prompting = false;
+  Text.pager.on = false;
+  Text.pager.fd = -1;
+  Text.pager.budget = PAGER_BUDGET;
+  Text.hex.on = false;
+  Text.hex.fd = -1;
+  Text.journal.on = true;
   Text.filename = NULL;
   Text.statusMessage[0] = '\0';
   Text.statusMessage_time = 0;
@@ -1364,18 +6220,87 @@ void initEditor() {
 // -----------------------------------------------------------------------------
 int main(int argc, char *argv[])
 {
+  pthread_mutex_init(&Text.save.lock, NULL);
+  pthread_mutex_lock(&Text.save.lock);  // the main thread holds the save lock except while it waits (see editorReadKey())
+  pthread_mutex_init(&Text.journal.lock, NULL);
+  pthread_cond_init(&Text.journal.change, NULL);
+  Text.journal.fd = -1;
+  Text.follow.fd = -1;
+  Text.follow.fileWatch = -1;
+  Text.stream.fd = -1;
+  editorCatchMappingFaults();
+
+  if (argc >= 3 && !strcmp(argv[1], "--benchmark")) {  // benchmarks run without putting the terminal into raw mode
+    return editorBenchmark(argv[2]);
+  }
+  if (argc >= 3 && !strcmp(argv[1], "--memory")) {  // so is the memory report
+    return editorMemoryReport(argv[2]);
+  }
+
+  bool atomic = false,  // save by renaming a new file over the file, not over the file itself - --in-place, the default, is still accepted
+       journaling = true,  // keep every edit in a journal next to the file until it is saved
+       follow = false,  // add the lines written to the file to the end of the text as they are written, like tail -F
+       pager = false,  // view the file read-only, with only the rows around the screen in memory - --pager=MB sets how much memory
+       hex = false;  // view and overwrite the file's bytes
+  size_t pagerBudget = PAGER_BUDGET;
+  while (argc >= 2 && (!strcmp(argv[1], "--atomic") || !strcmp(argv[1], "--in-place") || !strcmp(argv[1], "--no-journal") ||
+                       !strcmp(argv[1], "--follow") || !strcmp(argv[1], "--pager") || !strncmp(argv[1], "--pager=", 8) || !strcmp(argv[1], "--hex"))) {
+    if (!strcmp(argv[1], "--atomic")) atomic = true;
+    else if (!strcmp(argv[1], "--in-place")) atomic = false;
+    else if (!strcmp(argv[1], "--hex")) hex = true;
+    else if (!strcmp(argv[1], "--follow")) follow = true;
+    else if (!strncmp(argv[1], "--pager", 7)) {
+      pager = true;
+      if (argv[1][7] == '=' && atoll(&argv[1][8]) > 0) pagerBudget = (size_t)atoll(&argv[1][8]) << 20;
+    }
+    else journaling = false;
+    argc--;
+    argv++;
+  }
+
+  int stream = -1;  // "-" reads the text from standard input, a pipe or a file - the keys come from the terminal instead
+  if (argc >= 2 && !strcmp(argv[1], "-")) {
+    if (!isatty(STDIN_FILENO)) {  // otherwise nothing was piped in, and the terminal is where the keys come from anyway
+      int tty = open("/dev/tty", O_RDWR);
+      if (tty == -1 || (stream = dup(STDIN_FILENO)) == -1 || dup2(tty, STDIN_FILENO) == -1) die("/dev/tty");
+      close(tty);
+    }
+    argc--;
+    argv++;
+  }
+
   enableRawMode();
   initEditor();
-  if (argc >= 2) {
-    editorOpen(argv[1]);
+  Text.atomicSave = atomic;
+  Text.journal.on = journaling;
+  Text.follow.wanted = follow;
+  Text.pager.budget = pagerBudget;
+  if (argc >= 2 && hex && !editorHexOpen(argv[1]))
+    editorSetStatusMessage("--hex needs a plain file that can be mapped - opened it as text instead");
+  if (argc >= 2 && pager && !Text.hex.on && !editorPagerOpen(argv[1]))
+    editorSetStatusMessage("--pager needs a plain, uncompressed file - opened it to edit instead");
+  if (argc >= 2 && !Text.pager.on && !Text.hex.on) {
+    const char *error = editorOpen(argv[1]);
+    if (error) editorSetStatusMessage("Can't decompress all of the file! %s", error);
+  }
+  if (stream != -1) editorStreamStart(stream);
+
+  if (Text.statusMessage[0] == '\0' && Text.hex.on)
+    editorSetStatusMessage("HELP: Ctrl-S = save | Ctrl-Q = quit | Ctrl-G = go to offset | 0-9 a-f = edit");
+  if (Text.statusMessage[0] == '\0' && Text.pager.on)
+    editorSetStatusMessage("HELP: Ctrl-Q = quit | Ctrl-F = find | Ctrl-G = go to line | Ctrl-T = memory");
+  if (Text.statusMessage[0] == '\0')  // unless opening the file had something to say
+    editorSetStatusMessage("HELP: Ctrl-S = save | Ctrl-Q = quit | Ctrl-F = find | Ctrl-T = memory");
+  if (argc >= 2) editorJournalRecover();  // after the help, so what it has to say is seen
+  if (argc >= 2 && follow && !Text.pager.on && !Text.hex.on) {
+    editorFollowStart();
+    if (Text.follow.on) Text.cursorYPosition = Text.totalRows > 0 ? Text.totalRows - 1 : 0;  // start at the end, where the new lines go
   }
-
-  editorSetStatusMessage("HELP: Ctrl-S = save | Ctrl-Q = quit | Ctrl-F = find");
   
   while (1) 
   {
     editorRefreshScreen();
-    editorProcessKeypress();
+    do editorProcessKeypress(); while (!editorFrameDue());  // the keys already typed are handled before the screen is drawn again
   }
 
   return 0;
@@ -32,12 +32,19 @@ the text color back to normal.
 #include <stdarg.h>     // needed for va_list, va_start(), and va_end()
 #include <stdlib.h>     // Needed for exit(), atexit(), realloc(), free(), malloc()
 #include <string.h>     // Needed for memcpy(), strlen(), strup(), memmove(), strerror(), strstr(), memset(), strchr(), strcmp(), strncmp()
+#include <pthread.h>    // Needed for pthread_t, pthread_create(), pthread_join()
+#include <stdint.h>     // Needed for uint32_t
 #include <sys/ioctl.h>  // Needed for struct winsize, ioctl(), TIOCGWINSZ 
+#include <sys/stat.h>   // Needed for struct stat, fstat()
+#include <sys/uio.h>    // Needed for struct iovec, writev()
 #include <sys/types.h>  // Needed for ssize_t
 #include <termios.h>    // Needed for struct termios, tcsetattr(), TCSAFLUSH, tcgetattr(), BRKINT, ICRNL, INPCK, ISTRIP, 
                         // IXON, OPOST, CS8, ECHO, ICANON, IEXTEN, ISIG, VMIN, VTIME
 #include <time.h>       // Needed for time_t, time()
 #include <unistd.h>     // Needed for read(), STDIN_FILENO, write(), STDOUT_FILENO, ftruncate(), close()
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>  // Needed for __m128i, __m256i, _mm_cmpeq_epi8(), _mm_movemask_epi8() and their 256-bit versions
+#endif
 
 /*** defines ***/
 
@@ -88,7 +95,8 @@ struct editorSyntax {
 };
 
 typedef struct erow {  // the typedef lets us refer to the type as "erow" instead of "struct erow"
-  int index;
+  struct epiece *owner;  // the piece of the piece table that currently holds this row - used to work out the row's position in the file
+  int slot;  // index of the row in its piece table buffer - never changes once the row is created
   int size;  // the quantity of elements in the *chars array
   int rsize;  // the quantity of elements in the *render array
   char *chars;  // pointer to a dynamically allocated array that holds all the characters in a single row of text as read from a file
@@ -97,6 +105,44 @@ typedef struct erow {  // the typedef lets us refer to the type as "erow" instea
   int hl_open_comment;  // variable type/name should be BOOLEAN hasUnclosedMultilineComment 
 } erow;  // erow stands for "editor row" - it stores a line of text as a pointer to the dynamically-allocated character data and a length
 
+enum editorRowSource {  // the buffers a piece can take its rows from
+  ORIG_BUF = 0,  // rows read from the file by editorAppendRows() - only ever added to at the end, and never reordered
+  ADD_BUF        // rows created while editing - append-only, rows are never moved once added
+};
+
+typedef struct epiece {  // epiece stands for "editor piece" - a run of consecutive rows from one of the piece table buffers
+  struct epiece *left;
+  struct epiece *right;
+  struct epiece *parent;  // lets a row walk up to the root to work out its own position in the file
+  int priority;  // random treap priority - a piece always has a higher priority than its children, which keeps the tree balanced
+  int source;  // ORIG_BUF or ADD_BUF
+  int start;  // slot of the first row of the run in its buffer
+  int count;  // the quantity of rows in the run
+  int subrows;  // the quantity of rows in this piece plus all the pieces below it in the tree
+} epiece;
+
+#define OPEN_READ_SIZE  (1 << 20)  // editorOpen() reads a file a megabyte at a time
+#define SAVE_IOVECS     1024  // editorSave() hands the kernel this many pieces of the file per writev() - the usual IOV_MAX
+#define ADD_BLOCK_ROWS  512  // rows per block of the add buffer - blocks are never reallocated, so row pointers stay valid
+#define PIECE_MAX_ROWS  512  // the most rows a piece may hold - cutting a piece in two never has to repoint more than half this many rows
+#define NL_THREAD_SIZE  (4 << 20)  // a buffer at least this long is split into chunks that are searched for newlines on several threads
+#define NL_MAX_THREADS  16  // the most threads that search for newlines at once
+
+typedef struct enewlines {  // the offsets of the newlines found in a buffer, in order
+  size_t *offsets;
+  size_t count;  // the quantity of newlines found
+  size_t cap;  // the quantity of offsets there is room for
+} enewlines;
+
+struct editorPieceTable {  // the file as a balanced tree of pieces, so finding, inserting and deleting a row are all O(log n)
+  erow *orig;  // the original buffer - one row for each line of the file
+  erow **add_blocks;  // the add buffer - fixed size blocks of rows created by editorInsertRow()
+  int orig_rows;  // the quantity of rows in the original buffer
+  int orig_cap;  // the quantity of rows the original buffer has room for
+  int add_rows;  // the quantity of rows in the add buffer
+  epiece *root;  // the pieces in file order - an in-order walk of the tree visits every row of the file from top to bottom
+};
+
 struct editorConfig {  // global editor state
   int cx, cy;  // cx - horizontal index into the chars field of erow (cursor location???)
   int rx;  //horizontal index into the render field of erow - if there are no tab son the current line, rx will be the same as cx 
@@ -105,7 +151,8 @@ struct editorConfig {  // global editor state
   int screenrows;  // qty of rows on the screen - window size
   int screencols;  // qty of columns on the screen - window size
   int numrows;  // the number of rows (lines) of text being displayed/stored by the editor
-  erow *row;  // Hold a single row of test, both as read from a file, and as displayed on the screen
+  struct editorPieceTable pt;  // Holds every row of text, both as read from a file, and as displayed on the screen
+  enewlines nl;  // the newlines editorAppendRows() found last - kept while a file is read, so it isn't allocated again for every read
   int dirty;  // dirty flag - We call a text buffer “dirty” if it has been modified since opening or saving the file - used to keep track of whether the text loaded in our editor differs from what’s in the file
   char *filename;  // Name of the file being edited
   char statusmsg[80];  // holds an 80 character message to the user displayed on the status bar.
@@ -312,6 +359,271 @@ int getWindowSize(int *rows, int *cols)
   }
 }
 
+/*** piece table ***/
+// 8888888b.  8888888 8888888888  .d8888b.  8888888888       88888888888        d8888 888888b.   888      8888888888 
+// 888   Y88b   888   888        d88P  Y88b 888                  888           d88888 888  "88b  888      888        
+// 888    888   888   888        888    888 888                  888          d88P888 888  .88P  888      888        
+// 888   d88P   888   8888888    888        8888888              888         d88P 888 8888888K.  888      8888888    
+// 8888888P"    888   888        888        888                  888        d88P  888 888  "Y88b 888      888        
+// 888          888   888        888    888 888                  888       d88P   888 888    888 888      888        
+// 888          888   888        Y88b  d88P 888                  888      d8888888888 888   d88P 888      888        
+// 888        8888888 8888888888  "Y8888P"  8888888888           888     d88P     888 8888888P"  88888888 8888888888 
+
+// -----------------------------------------------------------------------------
+// returns a pointer to the row stored in the given slot of one of the piece table buffers
+erow *editorBufRow(int source, int slot) {
+  if (source == ORIG_BUF) return &E.pt.orig[slot];
+  return &E.pt.add_blocks[slot / ADD_BLOCK_ROWS][slot % ADD_BLOCK_ROWS];
+}
+
+// -----------------------------------------------------------------------------
+// the quantity of rows in a subtree - an empty subtree (NULL) holds no rows
+int pieceRows(epiece *p) {
+  return p ? p->subrows : 0;
+}
+
+// -----------------------------------------------------------------------------
+// points each row of a piece at the piece, so the row can find its own position in the text
+void pieceClaimRows(epiece *p) {
+  for (int j = 0; j < p->count; j++)
+    editorBufRow(p->source, p->start + j)->owner = p;
+}
+
+// -----------------------------------------------------------------------------
+// returns the next treap priority - a xorshift with its own state, so making pieces leaves rand() alone
+int pieceRandom() {
+  static uint32_t state = 2463534242u;
+  state ^= state << 13;
+  state ^= state >> 17;
+  state ^= state << 5;
+  return (int)(state >> 1);  // never negative
+}
+
+// -----------------------------------------------------------------------------
+// allocates a new piece holding count rows of a buffer starting at start
+epiece *pieceNew(int source, int start, int count) {
+  epiece *p = malloc(sizeof(epiece));
+  p->left = p->right = p->parent = NULL;
+  p->priority = pieceRandom();
+  p->source = source;
+  p->start = start;
+  p->count = count;
+  p->subrows = count;
+  return p;
+}
+
+// -----------------------------------------------------------------------------
+// recalculates subrows after the children of a piece change, and points the children back at it
+void pieceUpdate(epiece *p) {
+  p->subrows = pieceRows(p->left) + p->count + pieceRows(p->right);
+  if (p->left) p->left->parent = p;
+  if (p->right) p->right->parent = p;
+}
+
+// -----------------------------------------------------------------------------
+// joins two trees into one - every row of a comes before every row of b
+epiece *pieceMerge(epiece *a, epiece *b) {
+  if (a == NULL) return b;
+  if (b == NULL) return a;
+  if (a->priority > b->priority) {  // a stays on top, b is merged into its right subtree
+    a->right = pieceMerge(a->right, b);
+    pieceUpdate(a);
+    return a;
+  }
+  b->left = pieceMerge(a, b->left);  // b stays on top, a is merged into its left subtree
+  pieceUpdate(b);
+  return b;
+}
+
+// -----------------------------------------------------------------------------
+// splits a tree in two - *left gets the first at rows, *right gets the rest
+void pieceSplit(epiece *p, int at, epiece **left, epiece **right) {
+  if (p == NULL) {
+    *left = *right = NULL;
+    return;
+  }
+
+  int left_rows = pieceRows(p->left);
+  if (at <= left_rows) {  // the split is somewhere in the left subtree
+    pieceSplit(p->left, at, left, &p->left);
+    pieceUpdate(p);
+    *right = p;
+  } else if (at >= left_rows + p->count) {  // the split is somewhere in the right subtree
+    pieceSplit(p->right, at - left_rows - p->count, &p->right, right);
+    pieceUpdate(p);
+    *left = p;
+  } else {  // the split falls inside this piece, so it has to be cut in two
+    int k = at - left_rows;  // the quantity of rows that go to the left half
+    epiece *q = pieceNew(p->source, p->start, k);
+    q->priority = p->priority;  // keep the same priority so both halves stay above their children
+    if (k <= p->count - k) {  // q takes the left half - only the smaller half of the rows (at most PIECE_MAX_ROWS / 2) has to be pointed at a new piece
+      q->left = p->left;
+      p->left = NULL;
+      p->start += k;
+      p->count -= k;
+      *left = q;
+      *right = p;
+    } else {  // q takes the right half
+      q->start = p->start + k;
+      q->count = p->count - k;
+      q->right = p->right;
+      p->right = NULL;
+      p->count = k;
+      *left = p;
+      *right = q;
+    }
+    pieceClaimRows(q);
+    pieceUpdate(q);
+    pieceUpdate(p);
+  }
+}
+
+// -----------------------------------------------------------------------------
+// splits the whole text at row at - the two halves get no parent so they can be used as roots
+void ptSplit(int at, epiece **left, epiece **right) {
+  pieceSplit(E.pt.root, at, left, right);
+  if (*left) (*left)->parent = NULL;
+  if (*right) (*right)->parent = NULL;
+  E.pt.root = NULL;
+}
+
+// -----------------------------------------------------------------------------
+// joins three trees back together and makes the result the text
+void ptJoin(epiece *left, epiece *middle, epiece *right) {
+  E.pt.root = pieceMerge(pieceMerge(left, middle), right);
+  if (E.pt.root) E.pt.root->parent = NULL;
+}
+
+// -----------------------------------------------------------------------------
+// places the row in the given slot of a buffer at position at in the text
+void ptInsert(int at, int source, int slot) {
+  epiece *left, *right;
+  ptSplit(at, &left, &right);
+
+  epiece *last = left;  // the piece holding the row just before the insertion point
+  while (last && last->right) last = last->right;
+
+  if (last && last->source == source && last->start + last->count == slot &&  // the new row directly follows the last piece in its buffer and
+      last->count < PIECE_MAX_ROWS) {                                         // the piece still has room, so 
+    last->count++;                                                            // just make that piece one row longer instead of adding a new one
+    for (epiece *p = last; p; p = p->parent) p->subrows++;
+    editorBufRow(source, slot)->owner = last;
+    ptJoin(left, NULL, right);
+  } else {
+    epiece *p = pieceNew(source, slot, 1);
+    editorBufRow(source, slot)->owner = p;
+    ptJoin(left, p, right);
+  }
+}
+
+// -----------------------------------------------------------------------------
+// takes the row at position at out of the text - the caller is responsible for the memory owned by the row
+void ptRemove(int at) {
+  epiece *left, *middle, *right;
+  ptSplit(at, &left, &right);
+  E.pt.root = right;
+  ptSplit(1, &middle, &right);  // middle is now a single piece holding just the removed row
+  free(middle);
+  ptJoin(left, NULL, right);
+}
+
+// -----------------------------------------------------------------------------
+// adds count rows of a buffer starting at start to the end of the file, in pieces as long as they are allowed to be
+void ptAppend(int source, int start, int count) {
+  while (count > 0) {
+    int n = count < PIECE_MAX_ROWS ? count : PIECE_MAX_ROWS;
+    epiece *p = pieceNew(source, start, n);
+    pieceClaimRows(p);
+    ptJoin(E.pt.root, p, NULL);
+    start += n;
+    count -= n;
+  }
+}
+
+// -----------------------------------------------------------------------------
+// returns the row at position at in the text - O(log n) in the quantity of pieces
+erow *editorRowAt(int at) {
+  epiece *p = E.pt.root;
+  while (p) {
+    int left_rows = pieceRows(p->left);
+    if (at < left_rows) {
+      p = p->left;
+    } else if (at < left_rows + p->count) {
+      return editorBufRow(p->source, p->start + at - left_rows);
+    } else {
+      at -= left_rows + p->count;
+      p = p->right;
+    }
+  }
+  return NULL;
+}
+
+// -----------------------------------------------------------------------------
+// returns the position of a row in the text - walks up from the row's piece to the root, adding up every row that comes before it
+int editorRowIdx(erow *row) {
+  epiece *p = row->owner;
+  int at = pieceRows(p->left) + (row->slot - p->start);
+  while (p->parent) {
+    if (p == p->parent->right) at += pieceRows(p->parent->left) + p->parent->count;
+    p = p->parent;
+  }
+  return at;
+}
+
+// -----------------------------------------------------------------------------
+// returns the first piece of the text, or NULL if there is no text
+epiece *pieceFirst() {
+  epiece *p = E.pt.root;
+  while (p && p->left) p = p->left;
+  return p;
+}
+
+// -----------------------------------------------------------------------------
+// returns the piece that comes after p in the text, or NULL if p is the last one
+epiece *pieceNext(epiece *p) {
+  if (p->right) {
+    p = p->right;
+    while (p->left) p = p->left;
+    return p;
+  }
+  while (p->parent && p == p->parent->right) p = p->parent;
+  return p->parent;
+}
+
+// -----------------------------------------------------------------------------
+// adds an empty row to the end of the add buffer and returns its slot
+int addBufNewRow() {
+  if (E.pt.add_rows % ADD_BLOCK_ROWS == 0) {  // the last block is full (or there are no blocks yet), so allocate a new one
+    int blocks = E.pt.add_rows / ADD_BLOCK_ROWS;
+    E.pt.add_blocks = realloc(E.pt.add_blocks, sizeof(erow *) * (blocks + 1));
+    E.pt.add_blocks[blocks] = malloc(sizeof(erow) * ADD_BLOCK_ROWS);
+  }
+  int slot = E.pt.add_rows++;
+  editorBufRow(ADD_BUF, slot)->slot = slot;
+  return slot;
+}
+
+// -----------------------------------------------------------------------------
+// makes sure the original buffer has room for rows rows without being reallocated - used to size it up front from an estimate of 
+// how many lines a file has
+void origBufReserve(int rows) {
+  if (rows <= E.pt.orig_cap) return;
+  E.pt.orig_cap = rows;
+  E.pt.orig = realloc(E.pt.orig, sizeof(erow) * rows);
+}
+
+// -----------------------------------------------------------------------------
+// adds an empty row to the end of the original buffer and returns its slot - only used by editorAppendRows()
+int origBufNewRow() {
+  if (E.pt.orig_rows == E.pt.orig_cap) {  // double the capacity whenever the buffer is full
+    E.pt.orig_cap = E.pt.orig_cap ? E.pt.orig_cap * 2 : 1024;
+    E.pt.orig = realloc(E.pt.orig, sizeof(erow) * E.pt.orig_cap);
+  }
+  int slot = E.pt.orig_rows++;
+  editorBufRow(ORIG_BUF, slot)->slot = slot;
+  return slot;
+}
+
 
 // 888    888 8888888 .d8888b.  888    888 888      8888888 .d8888b.  888    888 88888888888 
 // 888    888   888  d88P  Y88b 888    888 888        888  d88P  Y88b 888    888     888     
@@ -335,11 +647,13 @@ int is_separator(int c) {  // this function should be type Boolean
 
 // -----------------------------------------------------------------------------
 // Might not need int prev_sep - maybe just use function? OR maybe keep track of what type of char the prev char was - not just separartor, but number, or other too???
-void editorUpdateSyntax(erow *row) {
+// in_comment says whether the row starts inside a multi-line comment - returns true when the row's hl_open_comment changed, which means
+// the row after it has to be highlighted again too
+int editorHighlightRow(erow *row, int in_comment) {
   row->hl = realloc(row->hl, row->rsize);  // First we realloc() the needed memory, since this might be a new row or the row might be bigger than the last time we highlighted it.
   memset(row->hl, HL_NORMAL, row->rsize);  // use memset() to set all characters to HL_NORMAL by default
 
-  if (E.syntax == NULL) return;
+  if (E.syntax == NULL) return 0;
 
   char **keywords = E.syntax->keywords;  // declare an array of strings (pointer to a pointer) and point it at the keywords array in the E.syntax struct
 
@@ -356,7 +670,6 @@ void editorUpdateSyntax(erow *row) {
   int prev_sep = 1;  // previous_separator - keeps track of whether the previous character was a separator so it can be used to recognize and highlight numbers properly. 
                      // We initialize prev_sep to 1 (meaning true) because we consider the beginning of the line to be a separator.
   int in_string = 0;  // keep track of whether we are currently inside a string
-  int in_comment = (row->index > 0 && E.row[row->index - 1].hl_open_comment);  // initialize in_comment to true if the previous row has an unclosed multi-line comment
 
   int i = 0;
   while (i < row->size) {  // loop through the characters
@@ -461,10 +774,36 @@ If we’re not currently in a multi-line comment, then we use strncmp() with mcs
   // end of row processing
   int changed = (row->hl_open_comment != in_comment);  // if the value of hl_open_comment changed
   row->hl_open_comment = in_comment;  // set the value of the current row’s hl_open_comment to whatever state in_comment got left in after processing the entire row - tells us whether the row ended as an unclosed multi-line comment or not.
-  if (changed && row->index + 1 < E.numrows)  // if the value of hl_open_comment changed and this not the last line of the file/text
-    editorUpdateSyntax(&E.row[row->index + 1]);  // recursive call to editorUpdateSyntax with next row as arguement - this will update the syntax of every row after this one until the end of the file if this line ended in an open line comment
+  return changed;
 }  // rework this without the continue and remove the second incrementation of i
 
+// -----------------------------------------------------------------------------
+// highlights a row, then the rows after it for as long as a multi-line comment left open or closed by the row changes them
+void editorUpdateSyntax(erow *row) {
+  int idx = editorRowIdx(row);  // the position of the row in the file - needed to find the rows before and after it
+  int in_comment = (idx > 0 && editorRowAt(idx - 1)->hl_open_comment);  // initialize in_comment to true if the previous row has an unclosed multi-line comment
+  if (editorHighlightRow(row, in_comment) && idx + 1 < E.numrows)  // if the value of hl_open_comment changed and this not the last line of the file/text
+    editorUpdateSyntax(editorRowAt(idx + 1));  // recursive call to editorUpdateSyntax with next row as arguement - this will update the syntax of every row after this one until the end of the file if this line ended in an open line comment
+}
+
+// -----------------------------------------------------------------------------
+// highlights every row from position from to the end of the file in a single pass - the multi-line comment state is carried from one
+// row to the next instead of each row looking up the row above it and re-highlighting the row below it
+void editorHighlightRows(int from) {
+  if (from >= E.numrows) return;
+
+  int in_comment = (from > 0 && editorRowAt(from - 1)->hl_open_comment);
+  erow *row = editorRowAt(from);
+  epiece *run = row->owner;
+  for (int k = row->slot - run->start; run; run = pieceNext(run), k = 0) {
+    for (; k < run->count; k++) {
+      row = editorBufRow(run->source, run->start + k);
+      editorHighlightRow(row, in_comment);
+      in_comment = row->hl_open_comment;
+    }
+  }
+}
+
 // -----------------------------------------------------------------------------
 //
 int editorSyntaxToColor(int hl) {
@@ -500,9 +839,10 @@ void editorSelectSyntaxHighlight() {
           (!is_ext && strstr(E.filename, s->filematch[i]))) { 
         E.syntax = s;
 
-        int filerow;
-        for (filerow = 0; filerow < E.numrows; filerow++) {
-          editorUpdateSyntax(&E.row[filerow]);
+        for (epiece *p = pieceFirst(); p; p = pieceNext(p)) {  // walk the pieces in file order rather than looking up each row
+          for (int k = 0; k < p->count; k++) {
+            editorUpdateSyntax(editorBufRow(p->source, p->start + k));
+          }
         }
 
         return;
@@ -553,7 +893,7 @@ int editorRowRxToCx(erow *row, int rx) {
 
 // -----------------------------------------------------------------------------
 // uses the chars string of an erow to fill in the contents of the render string - copy each character from chars to render
-void editorUpdateRow(erow *row) {
+void editorUpdateRender(erow *row) {
   int tabs = 0;
   int j;
   for (j = 0; j < row->size; j++)
@@ -573,34 +913,182 @@ void editorUpdateRow(erow *row) {
   }
   row->render[idx] = '\0';
   row->rsize = idx;
+}
 
+// -----------------------------------------------------------------------------
+// brings the render and the highlighting of a row up to date with its chars
+void editorUpdateRow(erow *row) {
+  editorUpdateRender(row);
   editorUpdateSyntax(row);
 }
 
 // -----------------------------------------------------------------------------
-// allocates memory space for a new erow, make space at any position in the E.row array, then copies the given string to it 
+// copies the given string into a row that has just been taken from one of the piece table buffers
+void editorInitRow(erow *row, char *s, size_t len) {
+  row->size = len;
+  row->chars = malloc(len + 1);
+  memcpy(row->chars, s, len);
+  row->chars[len] = '\0';
+
+  row->rsize = 0;
+  row->render = NULL;
+  row->hl = NULL;
+  row->hl_open_comment = 0;  // should be FALSE
+}
+
+// -----------------------------------------------------------------------------
+// allocates memory space for a new erow at the end of the add buffer, places it at any position in the file, then copies the given string to it 
 void editorInsertRow(int at, char *s, size_t len) {
   if (at < 0 || at > E.numrows) return;  // validate at index is within range
 
-  E.row = realloc(E.row, sizeof(erow) * (E.numrows + 1));  // allocate memory for a new row
-  memmove(&E.row[at + 1], &E.row[at], sizeof(erow) * (E.numrows - at)); // shift all rows after the index at down by one to make room for new row at at
-  for (int j = at + 1; j <= E.numrows; j++) E.row[j].index++;  // update the idx of each row after the inserted row whenever a row is inserted into a file
+  int slot = addBufNewRow();  // rows are never moved once created, so no other row has to be touched
+  erow *row = editorBufRow(ADD_BUF, slot);
+  editorInitRow(row, s, len);
+  ptInsert(at, ADD_BUF, slot);
+  editorUpdateRow(row);
 
-  E.row[at].index = at;  // initialize idx to the row’s index in the file at the time it is inserted
+  E.numrows++;
+  E.dirty++;  // why not just set it to true? - and then set to false when save file
+}
 
-  E.row[at].size = len;
-  E.row[at].chars = malloc(len + 1);
-  memcpy(E.row[at].chars, s, len);
-  E.row[at].chars[len] = '\0';
+// -----------------------------------------------------------------------------
+// makes room in a newline index for at least extra more offsets, doubling its capacity as many times as that takes
+void nlReserve(enewlines *nl, size_t extra) {
+  if (nl->count + extra <= nl->cap) return;
+  while (nl->count + extra > nl->cap) nl->cap = nl->cap ? nl->cap * 2 : 1024;
+  nl->offsets = realloc(nl->offsets, sizeof(size_t) * nl->cap);
+}
 
-  E.row[at].rsize = 0;
-  E.row[at].render = NULL;
-  E.row[at].hl = NULL;
-  E.row[at].hl_open_comment = 0;  // should be FALSE
-  editorUpdateRow(&E.row[at]);
+// -----------------------------------------------------------------------------
+// adds a newline for each bit set in mask, the result of comparing the bytes at buf[at] onwards with '\n' - bit n is buf[at + n]
+void nlAddMask(enewlines *nl, unsigned int mask, size_t at) {
+  if (mask == 0) return;  // most blocks of bytes have no newline in them
+  nlReserve(nl, 32);
+  while (mask) {
+    nl->offsets[nl->count++] = at + __builtin_ctz(mask);
+    mask &= mask - 1;  // clear the lowest bit set
+  }
+}
 
-  E.numrows++;
-  E.dirty++;  // why not just set it to true? - and then set to false when save file
+// -----------------------------------------------------------------------------
+// adds the offset of every newline in buf[from] to buf[to - 1] to nl, one memchr() at a time - works everywhere
+void nlScanScalar(const char *buf, size_t from, size_t to, enewlines *nl) {
+  const char *p = &buf[from];
+  while ((p = memchr(p, '\n', &buf[to] - p)) != NULL) {
+    nlReserve(nl, 1);
+    nl->offsets[nl->count++] = p - buf;
+    p++;
+  }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+// -----------------------------------------------------------------------------
+// nlScanScalar(), comparing 16 bytes at a time with SSE2 and turning the result into a bitmask with movemask
+__attribute__((target("sse2")))
+void nlScanSSE2(const char *buf, size_t from, size_t to, enewlines *nl) {
+  __m128i newline = _mm_set1_epi8('\n');
+  size_t i = from;
+  for (; i + 16 <= to; i += 16)
+    nlAddMask(nl, _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)&buf[i]), newline)), i);
+  nlScanScalar(buf, i, to, nl);  // the last few bytes
+}
+
+// -----------------------------------------------------------------------------
+// nlScanScalar(), comparing 32 bytes at a time with AVX2 - only called when the CPU has it
+__attribute__((target("avx2")))
+void nlScanAVX2(const char *buf, size_t from, size_t to, enewlines *nl) {
+  __m256i newline = _mm256_set1_epi8('\n');
+  size_t i = from;
+  for (; i + 32 <= to; i += 32)
+    nlAddMask(nl, (unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)&buf[i]), newline)), i);
+  nlScanScalar(buf, i, to, nl);
+}
+#endif
+
+// -----------------------------------------------------------------------------
+// adds the offset of every newline in buf[from] to buf[to - 1] to nl, with the widest compare the CPU has
+void nlScan(const char *buf, size_t from, size_t to, enewlines *nl) {
+#if defined(__x86_64__) || defined(__i386__)
+  if (__builtin_cpu_supports("avx2")) nlScanAVX2(buf, from, to, nl);
+  else if (__builtin_cpu_supports("sse2")) nlScanSSE2(buf, from, to, nl);
+  else nlScanScalar(buf, from, to, nl);
+#else
+  nlScanScalar(buf, from, to, nl);
+#endif
+}
+
+typedef struct enlchunk {  // one thread's share of the text editorIndexNewlines() searches
+  const char *buf;
+  size_t from, to;
+  enewlines found;  // merged into the caller's index once every thread is done
+} enlchunk;
+
+// -----------------------------------------------------------------------------
+// the function each of editorIndexNewlines()'s threads runs
+void *nlChunkScan(void *arg) {
+  enlchunk *chunk = arg;
+  nlScan(chunk->buf, chunk->from, chunk->to, &chunk->found);
+  return NULL;
+}
+
+// -----------------------------------------------------------------------------
+// adds the offset of every newline in buf[0] to buf[len - 1] to nl, in order. A long buffer is cut into one chunk per CPU, the chunks
+// are searched at the same time, and then their offsets are copied into nl one after another.
+void editorIndexNewlines(const char *buf, size_t len, enewlines *nl) {
+  long threads = sysconf(_SC_NPROCESSORS_ONLN);
+  if (threads > NL_MAX_THREADS) threads = NL_MAX_THREADS;
+  if (len < NL_THREAD_SIZE || threads < 2) {
+    nlScan(buf, 0, len, nl);
+    return;
+  }
+
+  enlchunk chunks[NL_MAX_THREADS];
+  pthread_t workers[NL_MAX_THREADS];
+  int started[NL_MAX_THREADS];
+  int t;
+  for (t = 0; t < threads; t++) {
+    chunks[t] = (enlchunk){ buf, len * t / threads, len * (t + 1) / threads, { NULL, 0, 0 } };
+    started[t] = (pthread_create(&workers[t], NULL, nlChunkScan, &chunks[t]) == 0);
+    if (!started[t]) nlChunkScan(&chunks[t]);  // no thread to be had - search the chunk here instead
+  }
+  for (t = 0; t < threads; t++) {
+    if (started[t]) pthread_join(workers[t], NULL);
+    nlReserve(nl, chunks[t].found.count);
+    if (chunks[t].found.count) memcpy(&nl->offsets[nl->count], chunks[t].found.offsets, sizeof(size_t) * chunks[t].found.count);
+    nl->count += chunks[t].found.count;
+    free(chunks[t].found.offsets);
+  }
+}
+
+// -----------------------------------------------------------------------------
+// appends every line of buf to the end of the file in one call - the rows go into the original buffer and are highlighted together 
+// in a single pass at the end. Returns the quantity of bytes used: a last line with no newline after it is left for the next call, 
+// unless at_eof says no more text is coming.
+size_t editorAppendRows(char *buf, size_t len, int at_eof) {
+  int first = E.numrows;
+  int start = E.pt.orig_rows;
+  size_t used = 0;
+  E.nl.count = 0;
+  editorIndexNewlines(buf, len, &E.nl);  // find every line end first, then make the rows
+  size_t i;
+  for (i = 0; i <= E.nl.count && used < len; i++) {
+    if (i == E.nl.count && !at_eof) break;  // the last line has no newline after it yet
+    size_t end = (i < E.nl.count) ? E.nl.offsets[i] : len;
+    size_t linelen = end - used;
+    while (linelen > 0 && buf[used + linelen - 1] == '\r') linelen--;
+
+    int slot = origBufNewRow();
+    erow *row = editorBufRow(ORIG_BUF, slot);
+    editorInitRow(row, &buf[used], linelen);
+    editorUpdateRender(row);
+    used = (i < E.nl.count) ? end + 1 : len;
+  }
+
+  int count = E.pt.orig_rows - start;
+  ptAppend(ORIG_BUF, start, count);
+  E.numrows += count;
+  editorHighlightRows(first);
+  return used;
 }
 
 // -----------------------------------------------------------------------------
@@ -615,9 +1103,8 @@ void editorFreeRow(erow *row) {
 // editorDelRow() looks a lot like editorRowDelChar(), because in both cases we are deleting a single element from an array of elements by its index.
 void editorDelRow(int at) {
   if (at < 0 || at >= E.numrows) return;  // validate at index
-  editorFreeRow(&E.row[at]);  // free the memory owned by the row using editorFreeRow()
-  memmove(&E.row[at], &E.row[at + 1], sizeof(erow) * (E.numrows - at - 1));  // use memmove() to overwrite the deleted row struct with the rest of the rows that come after it
-  for (int j = at; j <= E.numrows - 1; j++) E.row[j].index--;  // update the index of each row after the deleted row whenever a row is deleted from a file
+  editorFreeRow(editorRowAt(at));  // free the memory owned by the row using editorFreeRow()
+  ptRemove(at);  // take the row out of the piece table - its slot in the buffer is simply never used again
   E.numrows--;  
   E.dirty++;
 }
@@ -674,7 +1161,7 @@ void editorInsertChar(int c) {
   if (E.cy == E.numrows) {    // if the cursor is located on the very last line of the editor text (the cursor is on the tilde line after the end of the file, so we need to append a new row)
     editorInsertRow(E.numrows, "", 0);  // allocate memory space for a new row - the new character will be inserted on a new row 
   }
-  editorRowInsertChar(&E.row[E.cy], E.cx, c);  // insert the character (c) into the specific row of the row array
+  editorRowInsertChar(editorRowAt(E.cy), E.cx, c);  // insert the character (c) into the specific row of the row array
   E.cx++;  // move the cursor forward so that the next character the user inserts will go after the character just inserted
 }
 
@@ -684,9 +1171,8 @@ void editorInsertNewline() {
   if (E.cx == 0) {  // if the cursor is at the beginning of a line
     editorInsertRow(E.cy, "", 0);  // insert a new blank row before the line the cursor is on
   } else {  // Otherwise, we have to split the line we’re on into two rows
-    erow *row = &E.row[E.cy];  // assign a new pointer to the address of the first character of the text that will be moved down a row
+    erow *row = editorRowAt(E.cy);  // assign a new pointer to the address of the first character of the text that will be moved down a row
     editorInsertRow(E.cy + 1, &row->chars[E.cx], row->size - E.cx); // insert the text pointed to by row into a new line - calls editorUpdateRow()
-    row = &E.row[E.cy]; // reset row to the line that was truncated, because editorInsertRow() may have invalidated the pointer
     row->size = E.cx;  // set the size equal to the x coordinate
     row->chars[row->size] = '\0'; // add a null character to terminate the string in row->chars
     editorUpdateRow(row);  // update the row that was truncated
@@ -702,13 +1188,14 @@ void editorDelChar() {
   if (E.cx == 0 && E.cy == 0) return;  //do nothing if the cursor is at the beginning of the first line
 
   // Otherwise, we get the erow the cursor is on, and if there is a character to the left of the cursor, we delete it and move the cursor one to the left
-  erow *row = &E.row[E.cy];
+  erow *row = editorRowAt(E.cy);
   if (E.cx > 0) {
     editorRowDelChar(row, E.cx - 1);
     E.cx--;
   } else {  // if (E.cx == 0) - if the cursor is at the beginning of the line of text, append the entire line to the previous line and reduce the size of
-    E.cx = E.row[E.cy - 1].size;  // move the x coordniate of the cursor to the end of the previous row (while staying in the same row)
-    editorRowAppendString(&E.row[E.cy - 1], row->chars, row->size);  // Append the contents of the line the cursor is on to the contents of the line above it
+    erow *prev = editorRowAt(E.cy - 1);
+    E.cx = prev->size;  // move the x coordniate of the cursor to the end of the previous row (while staying in the same row)
+    editorRowAppendString(prev, row->chars, row->size);  // Append the contents of the line the cursor is on to the contents of the line above it
     editorDelRow(E.cy);  // delete the row the cursor is on
     E.cy--;  // move the cursor up one row to the position where the two lines were joined
   }
@@ -725,24 +1212,60 @@ void editorDelChar() {
 // 888        8888888 88888888 8888888888      8888888 d88P         "Y88888P"  
                                                                                                                                                        
 // -----------------------------------------------------------------------------
-//
-char *editorRowsToString(int *buflen) {
-  int totlen = 0;
-  int j;
-  for (j = 0; j < E.numrows; j++)  // add up the lengths of each row of text, adding 1 to each one for the newline character we’ll add to the end of each line
-    totlen += E.row[j].size + 1;
-  *buflen = totlen;  // save the total length into buflen, to tell the caller how long the string is
-
-  char *buf = malloc(totlen);  // allocate the required memory for the string
-  char *p = buf;  // set p to point at the same address as buf - this is so we increase the address p is pointing to as we copy characters while leaving buf point to the beginning address
-  for (j = 0; j < E.numrows; j++) {  // loop through the rows
-    memcpy(p, E.row[j].chars, E.row[j].size);  // memcpy() the contents of each row to the end of the buffer
-    p += E.row[j].size;  // advance the address being pointed at by the p pointer by the qty of characters added to the string
-    *p = '\n';  // append a new line character after each row
-    p++;  // advance the address being pointed at by the pointer by one to account for the newline character
+// the quantity of bytes the file takes up on disk - the size of each row plus 1 for its newline
+size_t editorFileSize() {
+  size_t totlen = 0;
+  epiece *run;
+  int k;
+  for (run = pieceFirst(); run; run = pieceNext(run))
+    for (k = 0; k < run->count; k++)
+      totlen += editorBufRow(run->source, run->start + k)->size + 1;
+  return totlen;
+}
+
+// -----------------------------------------------------------------------------
+// writes all iovcnt parts of iov to fd with writev(), starting the next writev() part way through a part that a partial write cut 
+// short - returns 0 on success and -1 on an error, with errno set
+int editorWritevAll(int fd, struct iovec *iov, int iovcnt) {
+  while (iovcnt > 0) {
+    ssize_t written = writev(fd, iov, iovcnt);
+    if (written == -1) {
+      if (errno == EINTR) continue;
+      return -1;
+    }
+    while (iovcnt > 0 && (size_t)written >= iov->iov_len) {  // skip the parts written in full
+      written -= iov->iov_len;
+      iov++;
+      iovcnt--;
+    }
+    if (iovcnt > 0) {
+      iov->iov_base = (char *)iov->iov_base + written;
+      iov->iov_len -= written;
+    }
   }
+  return 0;
+}
 
-  return buf; // return the string - we expect the caller to free the memory
+// -----------------------------------------------------------------------------
+// writes every row to fd with a newline after each one. The iovecs point straight at the rows, SAVE_IOVECS at a time, so no copy of 
+// the file is ever made - returns 0 on success and -1 on an error, with errno set
+int editorWriteRows(int fd) {
+  struct iovec iov[SAVE_IOVECS];
+  int iovcnt = 0;
+  epiece *run;
+  int k;
+  for (run = pieceFirst(); run; run = pieceNext(run)) {  // loop through the rows, run by run in file order
+    for (k = 0; k < run->count; k++) {
+      erow *row = editorBufRow(run->source, run->start + k);
+      if (iovcnt + 2 > SAVE_IOVECS) {
+        if (editorWritevAll(fd, iov, iovcnt) == -1) return -1;
+        iovcnt = 0;
+      }
+      iov[iovcnt++] = (struct iovec){ row->chars, row->size };
+      iov[iovcnt++] = (struct iovec){ "\n", 1 };  // a newline after each row
+    }
+  }
+  return editorWritevAll(fd, iov, iovcnt);
 }
 
 // -----------------------------------------------------------------------------
@@ -756,16 +1279,33 @@ void editorOpen(char *filename) {
   FILE *fp = fopen(filename, "r");
   if (!fp) die("fopen");
 
-  char *line = NULL;
-  size_t linecap = 0;
-  ssize_t linelen;
-  while ((linelen = getline(&line, &linecap, fp)) != -1) {
-    while (linelen > 0 && (line[linelen - 1] == '\n' || 
-                           line[linelen - 1] == '\r'))
-      linelen--;
-    editorInsertRow(E.numrows, line, linelen);
+  size_t bufcap = OPEN_READ_SIZE;
+  char *buf = malloc(bufcap);
+  size_t buflen = 0;  // bytes in buf - whole lines are taken out after every read, so this is the start of an unfinished line
+  size_t nread;
+  int estimated = 0;
+  while ((nread = fread(&buf[buflen], 1, bufcap - buflen, fp)) > 0) {
+    buflen += nread;
+    struct stat st;
+    if (!estimated && fstat(fileno(fp), &st) == 0 && (size_t)st.st_size > buflen) {  // size the original buffer from the length of the lines in the first read
+      size_t lines = 1;
+      for (char *p = buf; (p = memchr(p, '\n', &buf[buflen] - p)) != NULL; p++) lines++;
+      origBufReserve(E.numrows + (int)((double)st.st_size / buflen * lines * 1.1));  // 10% spare, in case the rest of the lines are shorter
+    }
+    estimated = 1;
+
+    size_t used = editorAppendRows(buf, buflen, 0);
+    memmove(buf, &buf[used], buflen - used);
+    buflen -= used;
+    if (buflen == bufcap) {  // a line longer than the buffer
+      bufcap *= 2;
+      buf = realloc(buf, bufcap);
+    }
   }
-  free(line);
+  editorAppendRows(buf, buflen, 1);
+  free(E.nl.offsets);
+  E.nl = (enewlines){ NULL, 0, 0 };
+  free(buf);
   fclose(fp);
   E.dirty = 0;  // reset the dirty flag
 }
@@ -782,24 +1322,23 @@ void editorSave() {
     editorSelectSyntaxHighlight();
   }
 
-  int len;
-  char *buf = editorRowsToString(&len);  // converts the contents of rows array into one continuos string
+  size_t len = editorFileSize();
 
   int fd = open(E.filename, O_RDWR | O_CREAT, 0644);  // create a new file if it doesn’t already exist (O_CREAT), and we want to open it for reading and writing (O_RDWR) - 0644 is the standard permissions you usually want for text files
   if (fd != -1) {
     if (ftruncate(fd, len) != -1) {  // sets the file’s size to the specified length
-      if (write(fd, buf, len) == len) {  // write the contents of buf to the file referenced by fd
+      if (editorWriteRows(fd) == 0) {  // stream the rows to the file referenced by fd
         close(fd);
-        free(buf);
         E.dirty = 0;
-        editorSetStatusMessage("%d bytes written to disk", len);
+        editorSetStatusMessage("%zu bytes written to disk", len);
         return;
       }
     }
+    int saved_errno = errno;
     close(fd);
+    errno = saved_errno;
   }
 
-  free(buf);
   editorSetStatusMessage("Can't save! I/O error: %s", strerror(errno));
 }
 
@@ -823,7 +1362,8 @@ void editorFindCallback(char *query, int key) {
   static char *saved_hl = NULL;  // dynamically allocated array which points to NULL when there is nothing to restore
 
   if (saved_hl) {  // if there is something to restore
-    memcpy(E.row[saved_hl_line].hl, saved_hl, E.row[saved_hl_line].rsize);  // memcpy it to the saved line’s hl
+    erow *saved_row = editorRowAt(saved_hl_line);
+    memcpy(saved_row->hl, saved_hl, saved_row->rsize);  // memcpy it to the saved line’s hl
     free(saved_hl);  // deallocate saved_hl
     saved_hl = NULL;  // set it back to NULL - so we won't have a dangling pointer
   }
@@ -850,7 +1390,7 @@ void editorFindCallback(char *query, int key) {
     if (current == -1) current = E.numrows - 1;  // if beginning of the text is reached, wrap around to the last row
     else if (current == E.numrows) current = 0;  // if the end of the text is reached, wrap around to the first row
 
-    erow *row = &E.row[current];  // set a pointer to the address of E.row[i]
+    erow *row = editorRowAt(current);  // set a pointer to the row at position current
     char *match = strstr(row->render, query);  // searches the row structure pointed to by row->render for the first occurence of query
     if (match) {  // a match is found
       last_match = current;
@@ -942,7 +1482,7 @@ void abFree(struct abuf *ab)
 void editorScroll() {
   E.rx = 0;
   if (E.cy < E.numrows) {
-    E.rx = editorRowCxToRx(&E.row[E.cy], E.cx);
+    E.rx = editorRowCxToRx(editorRowAt(E.cy), E.cx);
   }
 
   if (E.cy < E.rowoff) {
@@ -984,11 +1524,12 @@ void editorDrawRows(struct abuf *ab) {
         abAppend(ab, "~", 1);
       }
     } else {
-      int len = E.row[filerow].rsize - E.coloff;
+      erow *row = editorRowAt(filerow);
+      int len = row->rsize - E.coloff;
       if (len < 0) len = 0;
       if (len > E.screencols) len = E.screencols;
-      char *c = &E.row[filerow].render[E.coloff];
-      unsigned char *hl = &E.row[filerow].hl[E.coloff];  // a pointer, hl, to the slice of the hl array that corresponds to the slice of render that we are printing
+      char *c = &row->render[E.coloff];
+      unsigned char *hl = &row->hl[E.coloff];  // a pointer, hl, to the slice of the hl array that corresponds to the slice of render that we are printing
       int current_color = -1;
       int j;
       for (j = 0; j < len; j++) {  // for every character 
@@ -1177,7 +1718,7 @@ char *editorPrompt(char *prompt, void (*callback)(char *, int)) {  // The prompt
 
 // -----------------------------------------------------------------------------
 void editorMoveCursor(int key) {
-  erow *row = (E.cy >= E.numrows) ? NULL : &E.row[E.cy];
+  erow *row = (E.cy >= E.numrows) ? NULL : editorRowAt(E.cy);
 
   switch (key) {
     case ARROW_LEFT:
@@ -1185,7 +1726,7 @@ void editorMoveCursor(int key) {
         E.cx--;
       } else if (E.cy > 0) {
         E.cy--;
-        E.cx = E.row[E.cy].size;
+        E.cx = editorRowAt(E.cy)->size;
       }
       break;
     case ARROW_RIGHT:
@@ -1208,7 +1749,7 @@ void editorMoveCursor(int key) {
       break;
   }
 
-  row = (E.cy >= E.numrows) ? NULL : &E.row[E.cy];
+  row = (E.cy >= E.numrows) ? NULL : editorRowAt(E.cy);
   int rowlen = row ? row->size : 0;
   if (E.cx > rowlen) {
     E.cx = rowlen;
@@ -1249,7 +1790,7 @@ void editorProcessKeypress() {
 
     case END_KEY:
       if (E.cy < E.numrows)
-        E.cx = E.row[E.cy].size;
+        E.cx = editorRowAt(E.cy)->size;
       break;
 
     case CTRL_KEY('f'):
@@ -1317,7 +1858,13 @@ void initEditor() {
   E.rowoff = 0;  // we'll be scrolled to the top of the file by default
   E.coloff = 0;  // we'll be scrolled to the left of the file by default
   E.numrows = 0;
-  E.row = NULL;
+  E.pt.orig = NULL;
+  E.pt.add_blocks = NULL;
+  E.pt.orig_rows = 0;
+  E.pt.orig_cap = 0;
+  E.pt.add_rows = 0;
+  E.pt.root = NULL;
+  E.nl = (enewlines){ NULL, 0, 0 };
   E.dirty = 0;
   E.filename = NULL;
   E.statusmsg[0] = '\0';